@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 #include "io/image_types.hpp"
 
@@ -18,10 +20,27 @@ struct BlockGrid {
 BlockGrid make_grid(int width, int height, int block_size);
 
 // Tile image into padded blocks (raster order), output size = padded_w * padded_h.
-std::vector<int32_t> tile_to_blocks(const Image& img, const BlockGrid& g);
+// `offset` is subtracted from every sample (fused level shift); padding stays 0.
+std::vector<int32_t> tile_to_blocks(const Image& img, const BlockGrid& g, int32_t offset = 0);
+
+// Same, reading straight from an external 8/16-bit buffer (no intermediate Image).
+std::vector<int32_t> tile_to_blocks(const PixelView& src, const BlockGrid& g, int32_t offset = 0);
+
+// Same, into a caller-owned buffer (reuses its capacity).
+void tile_to_blocks(const Image& img, const BlockGrid& g, int32_t offset, std::vector<int32_t>& padded);
+void tile_to_blocks(const PixelView& src, const BlockGrid& g, int32_t offset, std::vector<int32_t>& padded);
 
 // Reconstruct image from padded blocks (crop back to width x height in img).
 void untile_from_blocks(Image& img, const BlockGrid& g, const std::vector<int32_t>& padded);
 
+// Marker of find_flat_blocks for a block that is not uniform.
+inline constexpr int32_t kNotFlat = INT32_MIN;
+
+// Uniform blocks of a padded buffer (block_size^2 consecutive samples each): flat[b] is
+// the sample value of block b if all its samples are equal and fit int16, kNotFlat
+// otherwise. One pass of compares, no transform. Returns the number of uniform blocks;
+// `flat` is left empty when there are none.
+size_t find_flat_blocks(const std::vector<int32_t>& padded, int block_size, std::vector<int32_t>& flat);
+
 } // namespace mcodec
 
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+
+namespace mcodec {
+
+// Status lines of the CLIs (Wrote:, --stats JSON, ...) go to stdout, or to stderr
+// once stdout carries the tool's output (--out -).
+void set_status_to_stderr(bool to_stderr);
+std::ostream& status_out();
+
+// --stats: JSON to status_out() ("--stats" alone) or to the given file.
+void emit_stats(const std::string& dest, const std::string& json);
+
+// --trace: collects spans from construction to the end of the scope, then writes
+// Chrome trace-event JSON (chrome://tracing or ui.perfetto.dev), so every return
+// and error path of a tool ends the trace. An empty path does nothing.
+class CliTrace {
+public:
+    explicit CliTrace(std::string path);
+    ~CliTrace();
+    CliTrace(const CliTrace&) = delete;
+    CliTrace& operator=(const CliTrace&) = delete;
+private:
+    std::string path_;
+};
+
+} // namespace mcodec
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "util/mem_track.hpp"
+
+namespace mcodec {
+
+// Per-call encoder instrumentation (filled by the encode_to_mcodec stats overloads).
+struct EncodeStats {
+    // wall time per stage, milliseconds
+    double tile_ms = 0.0;      // level shift + tiling
+    double dct_ms = 0.0;
+    double quantize_ms = 0.0;
+    double zigzag_ms = 0.0;
+    double rle_ms = 0.0;       // zero RLE + symbol packing
+    double huffman_ms = 0.0;   // frequencies + table + bit packing
+    double bitstream_ms = 0.0; // header + table section + payload
+    double total_ms = 0.0;
+
+    uint64_t blocks = 0;
+    uint64_t skipped_blocks = 0;   // uniform blocks coded by their sample value (no DCT)
+    uint64_t nonzero_coeffs = 0;   // quantized coefficients != 0
+    uint64_t rle_pairs = 0;
+    uint64_t symbols = 0;
+    uint32_t used_symbols = 0;     // distinct Huffman symbols
+    uint32_t max_code_len = 0;
+    uint64_t table_bytes = 0;      // Huffman table section
+    uint64_t payload_bytes = 0;    // Huffman coded bits
+    uint64_t output_bytes = 0;     // whole .mcodec
+
+    // heap per stage (filled only when mem_tracked, i.e. the tool links the mem hook)
+    bool mem_tracked = false;
+    MemUsage tile_mem, dct_mem, quantize_mem, zigzag_mem, rle_mem, huffman_mem, bitstream_mem;
+    uint64_t peak_live_bytes = 0;  // whole call, all stages
+};
+
+// Per-call decoder instrumentation.
+struct DecodeStats {
+    double parse_ms = 0.0;       // header + table section
+    double huffman_ms = 0.0;     // table rebuild + symbol decode
+    double rle_ms = 0.0;         // symbol unpacking + zero RLE expansion
+    double zigzag_ms = 0.0;
+    double dequantize_ms = 0.0;
+    double idct_ms = 0.0;
+    double untile_ms = 0.0;      // untiling + inverse level shift
+    double total_ms = 0.0;
+
+    uint64_t blocks = 0;
+    uint64_t skipped_blocks = 0; // decoded without dequantizer and IDCT
+    uint64_t nonzero_coeffs = 0;
+    uint64_t rle_pairs = 0;
+    uint64_t symbols = 0;
+    uint32_t used_symbols = 0;
+    uint32_t max_code_len = 0;
+    uint64_t table_bytes = 0;
+    uint64_t payload_bytes = 0;
+    uint64_t input_bytes = 0;
+    uint32_t layers = 0;         // quality layers decoded (1 for single-layer streams)
+
+    bool mem_tracked = false;
+    MemUsage parse_mem, huffman_mem, rle_mem, zigzag_mem, dequantize_mem, idct_mem, untile_mem;
+    uint64_t peak_live_bytes = 0;
+};
+
+// Single-line JSON objects (used by the CLIs' --stats).
+std::string to_json(const EncodeStats& s);
+std::string to_json(const DecodeStats& s);
+
+// Lap timer for filling the *_ms fields: lap_ms() returns the time since the previous lap.
+class StageClock {
+public:
+    StageClock() : start_(Clock::now()), last_(start_) {}
+    double lap_ms() {
+        const auto now = Clock::now();
+        const double ms = std::chrono::duration<double, std::milli>(now - last_).count();
+        last_ = now;
+        return ms;
+    }
+    double total_ms() const {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start_).count();
+    }
+private:
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start_;
+    Clock::time_point last_;
+};
+
+} // namespace mcodec
@@ -2,12 +2,74 @@
 
 #include <vector>
 #include <cstdint>
+#include <memory>
+#include "codec/codec_stats.hpp"
+#include "codec/encoder.hpp"
 #include "io/image_types.hpp"
 
 namespace mcodec {
 
 // Decode .mcodec bytes to image.
 Image decode_from_mcodec(const std::vector<uint8_t>& bytes);
+// Same, and fill per-stage timings / symbol and size counters.
+Image decode_from_mcodec(const std::vector<uint8_t>& bytes, DecodeStats& stats);
+
+// Decode a slice of a SeriesEncoder series (kFlagTableRef) with the series table file
+// `tables` (read_series_tables); streams with their own table decode as usual.
+Image decode_from_mcodec(const std::vector<uint8_t>& bytes, const SeriesTables& tables);
+
+// Decode only the first `max_layers` layers of a layered stream (all when <= 0).
+// Gives the image of the stream encoded at that layer's quality; single-layer streams
+// decode as usual. A layered stream cut right after any layer also decodes (up to it).
+Image decode_from_mcodec(const std::vector<uint8_t>& bytes, int max_layers);
+
+// Layer of a stream: quality after decoding it and its byte range in the file.
+// A single-layer stream has one layer covering the whole payload.
+struct LayerInfo {
+    int quality = 0;
+    size_t begin = 0;
+    size_t end = 0;
+};
+std::vector<LayerInfo> mcodec_layers(const std::vector<uint8_t>& bytes);
+
+// Standalone stream with the first `layers` layers (index and header rewritten, payload
+// prefix copied), e.g. to store or send only the preview tier.
+std::vector<uint8_t> truncate_layers(const std::vector<uint8_t>& bytes, int layers);
+
+// Decode straight to 8-bit display pixels through a window/level LUT (see
+// preprocess/window_level.hpp): the IDCT output is cropped, un-shifted, clamped and
+// mapped in one pass, without the int32 image of decode_from_mcodec. Same pixels as
+// apply_window(decode_from_mcodec(bytes), window).
+DisplayImage decode_display_from_mcodec(const std::vector<uint8_t>& bytes, const DisplayWindow& window);
+
+// Entropy decode only (Huffman + RLE): header fields and the quantized coefficients
+// in zigzag order. No dequantization, IDCT or untiling.
+QuantizedScan decode_quantized_scan(const std::vector<uint8_t>& bytes);
+
+// Reusable decoder: keeps the symbol, RLE, coefficient and block buffers and the
+// Huffman tree between calls, and decodes into `out` reusing its pixel buffer, so
+// decoding same-sized frames does no heap allocation. One session per thread.
+class DecoderSession {
+public:
+    DecoderSession();
+    ~DecoderSession();
+    DecoderSession(DecoderSession&&) noexcept;
+    DecoderSession& operator=(DecoderSession&&) noexcept;
+
+    void decode(const std::vector<uint8_t>& bytes, Image& out);
+    void decode(const std::vector<uint8_t>& bytes, Image& out, DecodeStats& stats);
+    // Display decode; the window LUT is kept while format and window stay the same.
+    void decode_display(const std::vector<uint8_t>& bytes, const DisplayWindow& window, DisplayImage& out);
+    // decode_quantized_scan into `out`, reusing the capacity of its scan vectors.
+    void decode_quantized_scan(const std::vector<uint8_t>& bytes, QuantizedScan& out);
+    // Series table file for kFlagTableRef streams (see SeriesEncoder); a table shared by
+    // consecutive slices is built once.
+    void set_series_tables(SeriesTables tables);
+
+    struct Buffers;
+private:
+    std::unique_ptr<Buffers> buf_;
+};
 
 } // namespace mcodec
 
@@ -2,12 +2,108 @@
 
 #include <vector>
 #include <cstdint>
+#include <memory>
+#include "block/tiling.hpp"
+#include "codec/codec_stats.hpp"
+#include "entropy/bitstream.hpp"
 #include "io/image_types.hpp"
 
 namespace mcodec {
 
 // Encode image to .mcodec bytes (minimal baseline: optional RLE on int32 stream).
 std::vector<uint8_t> encode_to_mcodec(const Image& im, int quality);
+// Same, and fill per-stage timings / symbol and size counters.
+std::vector<uint8_t> encode_to_mcodec(const Image& im, int quality, EncodeStats& stats);
+
+// Encode straight from a caller-owned 8/16-bit buffer (e.g. dicom_pixel_view()):
+// samples go from the buffer into the tiler with no intermediate Image copy.
+// Throws std::runtime_error if bits_allocated / bits_stored / is_signed disagree with type.
+std::vector<uint8_t> encode_to_mcodec(const PixelView& src, int quality);
+std::vector<uint8_t> encode_to_mcodec(const PixelView& src, int quality, EncodeStats& stats);
+
+// Quality-independent front end (level shift, tiling, DCT). Computing it once and
+// calling encode_from_front_end per quality gives the same bytes as encode_to_mcodec.
+struct EncoderFrontEnd {
+    Image meta;                    // header fields, pixels empty
+    BlockGrid grid;
+    bool level_shift_applied = false;
+    std::vector<float> coeffs;     // DCT coefficients, block after block (zero for skip blocks)
+    std::vector<int32_t> flat;     // find_flat_blocks of the tiles: skip blocks (empty: none)
+};
+
+EncoderFrontEnd encode_front_end(const Image& im);
+std::vector<uint8_t> encode_from_front_end(const EncoderFrontEnd& fe, int quality);
+
+// Quantized coefficients in zigzag scan order (block after block), i.e. what the
+// entropy coder sees. decode_quantized_scan (codec/decoder.hpp) produces it from a
+// stream; encode_quantized_scan entropy-codes it back (used by transcode_mcodec).
+struct QuantizedScan {
+    Image meta;                    // header fields, pixels empty
+    BlockGrid grid;
+    bool level_shift_applied = false;
+    int quality = 50;              // quantizer step = quant_step_from_quality(quality)
+    std::vector<int16_t> scan;
+    std::vector<int32_t> flat;     // skip blocks' sample values, else kNotFlat (empty: none)
+};
+
+std::vector<uint8_t> encode_quantized_scan(const QuantizedScan& s);
+
+// Quality-layered (SNR-scalable) stream, one layer per entry of `qualities` (strictly
+// increasing, at most kMaxLayers). Decoding the first k+1 layers gives exactly the image
+// of encode_to_mcodec(im, qualities[k]), so one file serves a preview and the full tier;
+// layer offsets are in the header (see format/mcodec_format.hpp).
+std::vector<uint8_t> encode_layered_mcodec(const Image& im, const std::vector<int>& qualities);
+
+// Reusable encoder for batch / service use. The session keeps every intermediate
+// buffer (tiles, coefficients, scan, RLE symbols, Huffman working memory) and `out`
+// keeps its capacity, so once a frame size has been seen, encoding frames of that
+// size does no heap allocation. Output is identical to encode_to_mcodec.
+// One session per thread.
+class EncoderSession {
+public:
+    EncoderSession();
+    ~EncoderSession();
+    EncoderSession(EncoderSession&&) noexcept;
+    EncoderSession& operator=(EncoderSession&&) noexcept;
+
+    void encode(const Image& im, int quality, std::vector<uint8_t>& out);
+    void encode(const Image& im, int quality, std::vector<uint8_t>& out, EncodeStats& stats);
+    void encode(const PixelView& src, int quality, std::vector<uint8_t>& out);
+    void encode(const PixelView& src, int quality, std::vector<uint8_t>& out, EncodeStats& stats);
+    // encode_quantized_scan
+    void encode(const QuantizedScan& s, std::vector<uint8_t>& out);
+
+    struct Buffers;
+private:
+    std::unique_ptr<Buffers> buf_;
+};
+
+// Series / multi-frame encoder with shared Huffman tables. Neighbouring slices have
+// nearly the same coefficient statistics, so instead of building and storing a table
+// per slice, the encoder keeps a running table and codes a slice with it while the
+// estimated code-length penalty stays below `max_penalty` (0.01 = 1% of the slice) or
+// below the bytes a new table would cost; otherwise it adds a table built from the recent
+// slices' counts. Symbols new to the table are escaped (kHuffEscapeSymbol). Slices come
+// out as kFlagTableRef streams naming their table; tables() is the series table file
+// (write_series_tables), which DecoderSession::set_series_tables or
+// decode_from_mcodec(bytes, tables) need to decode them.
+// Slices must be encoded in order; one encoder per series.
+class SeriesEncoder {
+public:
+    explicit SeriesEncoder(int quality, double max_penalty = 0.01);
+    ~SeriesEncoder();
+
+    void encode(const Image& im, std::vector<uint8_t>& out);
+    void encode(const PixelView& src, std::vector<uint8_t>& out);
+
+    const SeriesTables& tables() const;
+    size_t slices() const;
+    size_t reused() const; // slices coded with an earlier slice's table
+
+    struct State;
+private:
+    std::unique_ptr<State> st_;
+};
 
 } // namespace mcodec
 
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "format/mcodec_format.hpp"
+#include "io/image_types.hpp"
+
+namespace mcodec {
+
+// Lossless predictive engine (LOCO-I / JPEG-LS class), the alternative to the DCT path
+// for studies that must be stored losslessly. Each sample is predicted from its left,
+// upper and upper-left neighbours by the median edge detector and corrected by the bias
+// of its gradient context (365 contexts); the residual is Golomb-Rice coded with the
+// context's parameter, and flat areas switch to run-length coding. The stream carries
+// kFlagPredictive and decodes with decode_from_mcodec / DecoderSession like any other.
+// Samples must fit bits_stored (1..16 bits).
+std::vector<uint8_t> encode_lossless_mcodec(const Image& im);
+std::vector<uint8_t> encode_lossless_mcodec(const PixelView& src);
+
+// Near-lossless variant (T.87 NEAR): residuals are quantized with step 2 * near + 1 and
+// prediction runs on reconstructed samples, so every decoded sample is guaranteed to be
+// within +-near of the original (an L-infinity bound, unlike a quality setting).
+// near = 0 is encode_lossless_mcodec; the limit is min(255, (2^bits_stored - 1) / 2).
+std::vector<uint8_t> encode_near_lossless_mcodec(const Image& im, int near);
+std::vector<uint8_t> encode_near_lossless_mcodec(const PixelView& src, int near);
+
+// Payload decoder behind decode_from_mcodec for kFlagPredictive streams: `payload` is
+// everything after the header; `out` gets the header fields and the samples.
+void decode_predictive_payload(const MCodecHeader& hdr, const uint8_t* payload, size_t size, Image& out);
+
+} // namespace mcodec
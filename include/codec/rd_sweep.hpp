@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "io/image_types.hpp"
+#include "metrics/metrics.hpp"
+
+namespace mcodec {
+
+// One point of a rate-distortion curve.
+struct RdPoint {
+    int quality = 0;
+    uint64_t compressed_bytes = 0;
+    double bpp = 0.0;
+    ImageMetrics metrics;   // histogram only with RdSweepOptions::histogram
+    double encode_ms = 0.0; // back end only (front end is shared)
+    double decode_ms = 0.0;
+    Image recon;            // only with RdSweepOptions::keep_recon
+};
+
+struct RdSweepOptions {
+    bool ssim = true;        // SSIM and MS-SSIM
+    bool histogram = false;  // |err| histogram (error maps)
+    bool keep_recon = false; // keep decoded images in RdPoint::recon
+    unsigned threads = 0;    // qualities in parallel; 0 = all cores, 1 = sequential
+};
+
+// Encode `im` at every quality and measure the decoded result, in memory.
+// Level shift, tiling and the DCT run once; each quality only requantizes,
+// entropy-codes and decodes, and the qualities run in parallel.
+// Points come back in the order of `qualities`.
+std::vector<RdPoint> rd_sweep(const Image& im, const std::vector<int>& qualities,
+                              const RdSweepOptions& opt = {});
+
+// Bjontegaard delta rate (%) of `test` against `ref`, each given as (bpp, psnr) pairs:
+// log-rate is fitted as a cubic in PSNR and averaged over the overlapping PSNR range.
+// Negative = fewer bits at equal quality. Non-finite PSNR points are ignored.
+// Throws if a curve has fewer than 4 usable points or the curves do not overlap.
+double bd_rate(const std::vector<std::pair<double, double>>& ref,
+               const std::vector<std::pair<double, double>>& test);
+
+} // namespace mcodec
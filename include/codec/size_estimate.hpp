@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "codec/encoder.hpp"
+#include "io/image_types.hpp"
+
+namespace mcodec {
+
+// Size of encode_to_mcodec(im, quality) without producing the stream, for capacity
+// planning and rate control. Transform, quantizer and symbol counting run fused per
+// block; only Huffman code lengths are built, and the size is summed from them (no
+// bit packing, table serialization or output buffer).
+//
+// The pixel overloads use a single-precision DCT, several times faster than the
+// encoder's, so a coefficient sitting on a rounding boundary may quantize one step
+// apart: the result is typically within 0.1% of the real size. The EncoderFrontEnd
+// overload starts from the encoder's own coefficients and is exact.
+uint64_t estimate_mcodec_size(const Image& im, int quality);
+uint64_t estimate_mcodec_size(const PixelView& src, int quality);
+uint64_t estimate_mcodec_size(const EncoderFrontEnd& fe, int quality);
+
+} // namespace mcodec
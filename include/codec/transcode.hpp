@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "codec/decoder.hpp"
+#include "codec/encoder.hpp"
+
+namespace mcodec {
+
+// Re-encode a .mcodec stream at another quality without going through pixels:
+// entropy decode -> dequantize (old step) -> requantize (new step) -> entropy encode.
+// IDCT/DCT, tiling and level shift are skipped, so there is no pixel rounding or
+// clipping between the two quantizers. The same quality returns the input unchanged;
+// a higher quality only makes the stream larger (the lost precision does not come back).
+std::vector<uint8_t> transcode_mcodec(const std::vector<uint8_t>& bytes, int quality);
+
+// Reusable transcoder for batch / service use: keeps the decoder's and encoder's buffers
+// and the coefficient scan between calls and writes into `out` reusing its capacity, so
+// transcoding frames of a size already seen does no heap allocation. Output is
+// identical to transcode_mcodec.
+class TranscodeSession {
+public:
+    void transcode(const std::vector<uint8_t>& bytes, int quality, std::vector<uint8_t>& out);
+private:
+    DecoderSession dec_;
+    EncoderSession enc_;
+    QuantizedScan scan_;
+};
+
+} // namespace mcodec
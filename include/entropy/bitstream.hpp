@@ -5,6 +5,7 @@
 #include <vector>
 #include <stdexcept>
 #include <cstring>
+#include <utility>
 
 #include "format/mcodec_format.hpp"
 #include "io/image_types.hpp"
@@ -13,6 +14,11 @@ namespace mcodec {
 
 class ByteWriter {
 public:
+    ByteWriter() = default;
+    // Write into `reuse` (cleared first), keeping its capacity; get it back with release().
+    explicit ByteWriter(std::vector<uint8_t>&& reuse) : buf_(std::move(reuse)) { buf_.clear(); }
+
+    void reserve(size_t n) { buf_.reserve(n); }
     void write_u8(uint8_t v) { buf_.push_back(v); }
     void write_u16_le(uint16_t v) {
         buf_.push_back(static_cast<uint8_t>(v & 0xFF));
@@ -27,17 +33,23 @@ public:
         buf_.insert(buf_.end(), b, b + n);
     }
     const std::vector<uint8_t>& bytes() const { return buf_; }
+    std::vector<uint8_t> release() { return std::move(buf_); }
 private:
     std::vector<uint8_t> buf_;
 };
 
 class ByteReader {
 public:
-    explicit ByteReader(std::vector<uint8_t> data) : buf_(std::move(data)) {}
+    explicit ByteReader(std::vector<uint8_t> data)
+        : own_(std::move(data)), data_(own_.data()), size_(own_.size()) {}
+    // Non-owning: `data` must outlive the reader.
+    ByteReader(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+    ByteReader(const ByteReader&) = delete;
+    ByteReader& operator=(const ByteReader&) = delete;
 
     uint8_t read_u8() {
         need(1);
-        return buf_[pos_++];
+        return data_[pos_++];
     }
     uint16_t read_u16_le() {
         uint16_t lo = read_u8();
@@ -51,16 +63,19 @@ public:
     }
     void read_bytes(void* out, size_t n) {
         need(n);
-        std::memcpy(out, buf_.data() + pos_, n);
+        std::memcpy(out, data_ + pos_, n);
         pos_ += n;
     }
-    bool eof() const { return pos_ >= buf_.size(); }
-    size_t remaining() const { return buf_.size() - pos_; }
+    bool eof() const { return pos_ >= size_; }
+    size_t remaining() const { return size_ - pos_; }
+    size_t position() const { return pos_; }
 private:
     void need(size_t n) {
-        if (pos_ + n > buf_.size()) throw std::runtime_error("bitstream: premature EOF");
+        if (pos_ + n > size_) throw std::runtime_error("bitstream: premature EOF");
     }
-    std::vector<uint8_t> buf_;
+    std::vector<uint8_t> own_;
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
     size_t pos_ = 0;
 };
 
@@ -71,9 +86,32 @@ void write_bitstream_header(ByteWriter& w,
                             const Image& im,
                             uint8_t flags,
                             uint16_t block_size = 8,
-                            uint16_t quality = 50);
+                            uint16_t quality = 50,
+                            uint16_t header_bytes = kMCodecHeaderBytes);
 MCodecHeader read_bitstream_header(const std::vector<uint8_t>& bytes);
 
+// One entry of a layered stream's index; offsets are relative to the payload start.
+struct LayerEntry {
+    uint16_t quality;
+    uint32_t begin;
+    uint32_t end;
+};
+
+// Layer index of a validated header into `out` (cleared first). A single-layer stream
+// gives one entry spanning the whole payload.
+void read_layer_index(const std::vector<uint8_t>& bytes, const MCodecHeader& hdr, std::vector<LayerEntry>& out);
+
+// Huffman tables of a series table file (.mtab, see format/mcodec_format.hpp), each a list
+// of (symbol, code length) in table section order.
+struct SeriesTables {
+    std::vector<std::vector<std::pair<uint32_t, uint8_t>>> tables;
+};
+
+std::vector<uint8_t> write_series_tables(const SeriesTables& t);
+SeriesTables read_series_tables(const std::vector<uint8_t>& bytes);
+// FNV-1a over the table's entries; a kFlagTableRef stream stores it to catch a wrong .mtab.
+uint32_t series_table_hash(const std::vector<std::pair<uint32_t, uint8_t>>& table);
+
 void write_payload(ByteWriter& w, const uint8_t* data, size_t bytes);
 void read_payload(ByteReader& r, uint8_t* data, size_t bytes);
 
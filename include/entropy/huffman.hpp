@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <utility>
 #include <vector>
@@ -23,6 +24,11 @@ struct HuffTable {
 class BitWriter;
 class BitReader;
 
+// Escape of fixed-table (series) coding: a symbol without a code in the table is written
+// as this symbol's code followed by the symbol itself in 32 bits, MSB first. Packed RLE
+// symbols never take this value (run 0xFFFF).
+inline constexpr uint32_t kHuffEscapeSymbol = 0xFFFF0000u;
+
 // Build sparse (symbol,freq) list from a symbol stream.
 void build_symbol_frequencies(const std::vector<uint32_t>& symbols,
                               std::vector<std::pair<uint32_t, uint32_t>>& sym_freq);
@@ -40,4 +46,102 @@ void huff_decode(const std::vector<uint8_t>& bits,
                  size_t symbol_count,
                  std::vector<uint32_t>& out);
 
+// Reusable encoder: same code lengths and bits as huff_encode(), but symbols are
+// counted in an open-addressing table and codes are kept per distinct symbol (no
+// table indexed by symbol value). All working memory is kept between build() calls,
+// so coding streams of similar size does not allocate.
+class HuffmanEncoder {
+public:
+    // Count `symbols` (non-empty) and build the canonical code.
+    void build(const std::vector<uint32_t>& symbols);
+    // Lengths only (size estimation): reset_counts(), count() every symbol (in any
+    // order, `n` at a time), then build_lengths(). code_lengths() and payload_bytes()
+    // are then the same as after build() on those symbols; write_payload() is not available.
+    void reset_counts();
+    void count(uint32_t symbol, uint32_t n = 1);
+    void build_lengths();
+    // Fixed table (series coding): count `symbols` and code them with `table`, a
+    // code_lengths() list from an earlier build, instead of building their own code.
+    // Symbols without a code go through kHuffEscapeSymbol if `table` has it; otherwise
+    // the call returns false, and write_payload() is not available. The counts are kept
+    // either way (frequencies(), entropy_bits()).
+    bool build_from_table(const std::vector<uint32_t>& symbols,
+                          const std::vector<std::pair<uint32_t, uint8_t>>& table);
+    // (symbol, count) of the symbols counted last, count > 0, in no particular order.
+    void frequencies(std::vector<std::pair<uint32_t, uint32_t>>& out) const;
+    // Symbols of the last build_from_table() that have no code in the table (escaped).
+    uint64_t escaped() const { return escaped_; }
+    // Shannon bound sum(f * log2(n / f)) of the symbols counted last, in bits: no
+    // code built from these counts is shorter.
+    double entropy_bits() const;
+    // (symbol, code length) per used symbol, sorted by (length, symbol) as in the
+    // .mcodec table section.
+    const std::vector<std::pair<uint32_t, uint8_t>>& code_lengths() const { return lengths_; }
+    // Packed size of the symbols passed to build().
+    size_t payload_bytes() const { return static_cast<size_t>((payload_bits_ + 7) / 8); }
+    // Append the packed bits (MSB-first, zero-padded to a byte) to `out`.
+    void write_payload(std::vector<uint8_t>& out) const;
+
+private:
+    struct HeapNode {
+        uint32_t freq;
+        uint32_t symbol; // leaf symbol, or smallest symbol in the subtree (tie-break)
+        int left;        // index into nodes_, -1 for a leaf
+        int right;       // leaf: index of the distinct symbol
+    };
+    struct LenEntry {
+        uint32_t symbol;
+        uint32_t slot;   // index of the distinct symbol
+        uint8_t len;
+    };
+
+    uint32_t slot_of(uint32_t symbol);
+    void build_code();
+    void write_escaped(std::vector<uint8_t>& out) const;
+
+    std::vector<uint32_t> hash_keys_;
+    std::vector<uint32_t> hash_slots_;   // slot + 1, 0 = empty
+    uint32_t hash_shift_ = 0;
+    std::vector<uint32_t> distinct_;     // symbol per slot
+    std::vector<uint32_t> freq_;         // count per slot
+    std::vector<uint32_t> sym_slot_;     // slot per input symbol
+    std::vector<HeapNode> heap_;
+    std::vector<HeapNode> nodes_;
+    std::vector<std::pair<int, uint8_t>> stack_;
+    std::vector<LenEntry> lens_;
+    std::vector<uint32_t> code_;         // per slot
+    std::vector<uint8_t> code_len_;      // per slot
+    std::vector<std::pair<uint32_t, uint8_t>> lengths_;
+    uint64_t payload_bits_ = 0;
+    // build_from_table(): slots >= coded_slots_ are escaped through escape_slot_
+    size_t coded_slots_ = 0;
+    uint32_t escape_slot_ = 0;
+    uint64_t escaped_ = 0;
+};
+
+// Reusable decoder for a table section's (symbol, code length) entries.
+// Codes up to kLutBits long are resolved with one table lookup; longer (rare)
+// codes fall back to walking the decode tree.
+class HuffmanDecoder {
+public:
+    void build(const std::vector<std::pair<uint32_t, uint8_t>>& entries);
+    // Decode `symbol_count` symbols from bits[0, size) into `out` (resized). With `escapes`
+    // (fixed-table streams), kHuffEscapeSymbol is followed by the 32-bit symbol it stands for.
+    void decode(const uint8_t* bits, size_t size, size_t symbol_count, std::vector<uint32_t>& out,
+                bool escapes = false) const;
+
+private:
+    template <bool Escapes>
+    void decode_symbols(const uint8_t* bits, size_t size, size_t symbol_count, std::vector<uint32_t>& out) const;
+
+    static constexpr int kLutBits = 11;
+    struct LutEntry {
+        uint32_t symbol;
+        uint8_t len; // 0: code longer than kLutBits (or no code), walk the tree
+    };
+    std::vector<std::pair<uint32_t, uint8_t>> sorted_;
+    std::vector<HuffTable::Node> nodes_;
+    std::vector<LutEntry> lut_;
+};
+
 } // namespace mcodec
\ No newline at end of file
@@ -1,8 +1,11 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 
+#include "block/tiling.hpp"
+
 namespace mcodec {
 
 struct RlePair {
@@ -10,18 +13,38 @@ struct RlePair {
     uint16_t run; // number of following zeros
 };
 
+// Run of a skipped block (kFlagSkipBlocks): the pair {sample value, kSkipRun} stands for a
+// whole uniform block, which has no coefficients in the stream. Zero runs never get here.
+inline constexpr uint16_t kSkipRun = 0xFFFE;
+
 // Encode a sequence of int16_t (single block or concatenated blocks) with zero RLE.
 // Assumes AC coefficients dominate zeros; DC is stored as (value, run=0).
 void rle_encode_zeros(const std::vector<int16_t>& seq_in,
                       int block_size,
                       std::vector<RlePair>& rle_out);
 
+// Same, coding each block with flat[b] != kNotFlat (find_flat_blocks) as one skip pair
+// instead of its coefficients. An empty `flat` skips nothing.
+void rle_encode_zeros(const std::vector<int16_t>& seq_in,
+                      int block_size,
+                      const std::vector<int32_t>& flat,
+                      std::vector<RlePair>& rle_out);
+
 // Decode RLE back to int16_t sequence (length must be block_size*block_size*k).
 void rle_decode_zeros(const std::vector<RlePair>& rle_in,
                       int block_size,
                       size_t total_coeffs,
                       std::vector<int16_t>& seq_out);
 
+// Same, also accepting skip pairs at block starts: a skipped block decodes to zero
+// coefficients and flat[b] = its sample value (kNotFlat for the others; `flat` is left
+// empty when no block was skipped).
+void rle_decode_zeros(const std::vector<RlePair>& rle_in,
+                      int block_size,
+                      size_t total_coeffs,
+                      std::vector<int16_t>& seq_out,
+                      std::vector<int32_t>& flat);
+
 // Pack RLE pairs into 32-bit symbols: (run << 16) | uint16_t(value)
 void pack_rle_symbols(const std::vector<RlePair>& pairs,
     std::vector<uint32_t>& symbols);
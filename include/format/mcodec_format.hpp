@@ -9,6 +9,49 @@ namespace mcodec {
 // Struct padding/alignment is compiler-dependent. Always serialize field-by-field.
 inline constexpr uint16_t kMCodecHeaderBytes = 32; // fixed on-disk header size for v1
 
+// Header flag bits (MCodecHeader::flags).
+inline constexpr uint8_t kFlagLevelShift = 0x01; // samples were level-shifted before tiling
+inline constexpr uint8_t kFlagLayered    = 0x02; // quality layers, layer index after the fixed header
+inline constexpr uint8_t kFlagPredictive = 0x04; // (near-)lossless predictive engine instead of the DCT path
+inline constexpr uint8_t kFlagTableRef   = 0x08; // Huffman table kept in a series table file, not in the stream
+inline constexpr uint8_t kFlagSkipBlocks = 0x10; // uniform blocks coded by their sample value, no coefficients
+
+// Layered streams (kFlagLayered): header_bytes = kMCodecHeaderBytes + 4 + 8 * layer_count,
+// and the fixed header is followed by the layer index
+//   u16 layer_count, u16 reserved
+//   per layer: u16 quality, u16 reserved, u32 end (offset of the layer's end from the payload start)
+// Layers are stored back to back, each one a table section + Huffman payload like a
+// single-layer payload. Layer 0 codes the quantized scan at its quality; layer k codes the
+// scan at its quality minus the scan of layers 0..k-1 requantized to that step.
+// `quality` in the fixed header is the last layer's quality.
+inline constexpr int kMaxLayers = 16;
+
+// Series streams (kFlagTableRef, SeriesEncoder in codec/encoder.hpp): the table section is
+//   u32 symbol_count, u32 table_id, u32 table_hash
+// and the code is table `table_id` of the series table file, whose series_table_hash
+// must equal table_hash. Slices with similar statistics share one table, so its bytes
+// are stored once per series instead of once per slice. A symbol the table has no code
+// for is coded as kHuffEscapeSymbol (entropy/huffman.hpp) followed by the symbol in 32 bits.
+//
+// Series table file (.mtab), little-endian:
+//   magic "MTAB", u16 version (1), u16 reserved, u32 table_count
+//   per table: u32 used_symbol_count, used_symbol_count * (u32 symbol, u8 code length)
+// i.e. each table is a table section without its symbol_count.
+
+// Skip blocks (kFlagSkipBlocks): a block whose level-shifted samples are all equal is
+// coded as the single RLE pair {value = sample, run = kSkipRun (entropy/rle.hpp)} in
+// place of its DC and AC pairs; it decodes to that sample exactly, without dequantizer
+// or IDCT, and its coefficients in the scan are zero. Set only when some block is
+// skipped, so other streams are unchanged. In layered streams the skip pairs are in
+// layer 0; later layers code the (zero) residual of those blocks as usual.
+
+// Predictive streams (kFlagPredictive, codec/predictive.hpp): block_size and quality are 0
+// and the payload is
+//   u16 near (max |error|; 0 = lossless), u16 reserved
+//   Golomb-Rice coded residuals, MSB first, zero-padded to a byte
+// Samples are coded as unsigned values in [0, 2^bits_stored); signed images are offset by
+// 2^(bits_stored-1) first.
+
 // .mcodec file layout:
 // [Header][payload...]
 //
@@ -24,7 +67,7 @@ struct MCodecHeader {
     uint16_t bits_allocated;  // 8 / 16
     uint16_t bits_stored;     // e.g. 12
     uint8_t  is_signed;       // 0/1
-    uint8_t  flags;           // reserved for future
+    uint8_t  flags;           // kFlag* bits
 
     uint16_t block_size;      // 8 or 16
     uint16_t quality;         // quantization quality
@@ -26,6 +26,33 @@ struct Image {
     bool empty() const { return pixels.empty(); }
 };
 
+// Non-owning view of caller-owned grayscale samples (e.g. DCMTK's PixelData
+// buffer), row-major with no row padding. S16 data may also be passed as the
+// raw 16-bit pattern (e.g. from findAndGetUint16Array).
+struct PixelView {
+    const void* data = nullptr;
+    PixelType type = PixelType::U16; // element type of data
+    int width = 0;
+    int height = 0;
+    int bits_stored = 0;
+    int bits_allocated = 0;           // 8 for U8, 16 for U16/S16
+    bool is_signed = false;
+};
+
+// VOI window in stored sample values (DICOM WindowCenter / WindowWidth when the
+// rescale is identity); width >= 1.
+struct DisplayWindow {
+    double center = 0.0;
+    double width = 1.0;
+};
+
+// 8-bit display pixels after windowing, row-major.
+struct DisplayImage {
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> pixels;
+};
+
 } // namespace mcodec
 
 
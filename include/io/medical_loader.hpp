@@ -1,16 +1,53 @@
 #pragma once
 
+#include <memory>
 #include <string>
+#include <vector>
 #include "io/image_types.hpp"
 
+class DcmDataset; // DCMTK
+
 namespace mcodec {
 
 // Minimal loader:
 // - PGM (P5) 8/16-bit supported
 // - DICOM (DCMTK) supported for uncompressed grayscale 16-bit (common CT/MR)
+//   (multi-frame files: first frame only, see DicomFrameReader for the rest)
 // - Others (PNG/TIFF) are placeholders for now
+// "-" reads the image from stdin (see load_medical_bytes).
 Image load_medical(const std::string& path);
 
+// Same, from an in-memory file: PGM if it starts with "P5", else DICOM (first frame).
+// `name` only labels error messages.
+Image load_medical_bytes(const std::vector<uint8_t>& bytes, const std::string& name);
+
+// Frame-by-frame reader for uncompressed (multi-frame) DICOM files.
+// PixelData stays on disk; read_frame() fetches only that frame's bytes via
+// DCMTK partial value access, so at most one frame is widened to int32.
+// Not thread-safe: use one reader per thread.
+class DicomFrameReader {
+public:
+    explicit DicomFrameReader(const std::string& path);
+    ~DicomFrameReader();
+    DicomFrameReader(const DicomFrameReader&) = delete;
+    DicomFrameReader& operator=(const DicomFrameReader&) = delete;
+
+    int frame_count() const;
+    Image read_frame(int index); // 0-based
+    // View of frame `index` in the reader's buffer; valid until the next call.
+    PixelView frame_view(int index);
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+// NumberOfFrames of a DICOM file (1 if absent); reads the header only.
+int dicom_frame_count(const std::string& path);
+
+// Zero-copy view of the (first frame of the) PixelData of an in-memory dataset.
+// Points into DCMTK's own buffer: valid while `ds` is alive and unmodified.
+PixelView dicom_pixel_view(DcmDataset* ds);
+
 } // namespace mcodec
 
 
@@ -1,13 +1,18 @@
 #pragma once
 
+#include <iosfwd>
 #include <string>
 #include "io/image_types.hpp"
 
 namespace mcodec {
 
 // Minimal saver:
-// - PGM (P5) 8/16-bit
+// - PGM (P5) 8/16-bit; "-" writes to stdout
 void save_pgm(const std::string& path, const Image& im);
+void save_pgm(std::ostream& os, const Image& im);
+// - 8-bit PGM of windowed display pixels
+void save_pgm(const std::string& path, const DisplayImage& im);
+void save_pgm(std::ostream& os, const DisplayImage& im);
 
 } // namespace mcodec
 
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace mcodec {
+
+// One DICOM image file of a series folder, with the keys used to order slices.
+struct SeriesEntry {
+    std::string path;
+    std::string series_uid;         // SeriesInstanceUID ("" if missing)
+    int instance_number = 0;        // InstanceNumber (0 if missing)
+    double position[3] = {0, 0, 0}; // ImagePositionPatient
+    bool has_position = false;
+};
+
+struct SeriesIndex {
+    std::string dir;
+    std::vector<SeriesEntry> entries; // sorted by (series_uid, instance_number, position z, path)
+};
+
+// Index a DICOM series folder:
+// - each file is parsed only up to PixelData (pixel bytes are never read)
+// - files are parsed in parallel; non-DICOM / non-image files are skipped
+// - the index is cached per folder in memory, so a repeated call only stats the
+//   files and re-parses those whose size or modification time changed
+// - with kSeriesIndexCacheEnv set, the cache is also kept on disk for later
+//   processes, one file per folder in a cache directory (never in the folder)
+SeriesIndex index_dicom_series(const std::string& dir);
+
+// Environment variable enabling the on-disk index: unset, empty or "0" keeps it off,
+// "1" uses $XDG_CACHE_HOME/mcodec (~/.cache/mcodec; %LOCALAPPDATA%\mcodec on Windows),
+// any other value is the cache directory to use.
+inline constexpr const char* kSeriesIndexCacheEnv = "MCODEC_SERIES_INDEX_CACHE";
+
+} // namespace mcodec
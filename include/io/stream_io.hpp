@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mcodec {
+
+// "-" names stdin (for inputs) or stdout (for outputs) in the CLIs.
+inline bool is_stdio_path(const std::string& path) { return path == "-"; }
+
+// stdin / stdout carry binary data; on Windows they start in text mode (CRLF
+// translation). No-op elsewhere.
+void set_stdio_binary();
+
+// Whole file, or all of stdin for "-", read in fixed-size chunks. Never seeks, so
+// pipes, FIFOs and process substitution work.
+std::vector<uint8_t> read_input(const std::string& path);
+
+// Write `bytes` to a file, or to stdout for "-" (binary mode, flushed).
+void write_output(const std::string& path, const uint8_t* data, size_t n);
+inline void write_output(const std::string& path, const std::vector<uint8_t>& bytes) {
+    write_output(path, bytes.data(), bytes.size());
+}
+
+} // namespace mcodec
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "io/image_types.hpp"
+
+namespace mcodec {
+
+// Quality metrics of a reconstruction against its reference.
+//
+// Samples are compared in the unsigned B-bit domain used by evaluate
+// (B = ref.bits_stored, MAX = 2^B - 1; signed data is offset by 2^(B-1)).
+// One pass maps both images and accumulates MSE / max error / histogram;
+// SSIM and MS-SSIM add a separable-filter pass. Both passes split rows
+// across threads and reduce in a fixed order, so results do not depend
+// on the thread count.
+struct MetricsOptions {
+    bool histogram = true;
+    bool ssim = true;
+    bool ms_ssim = true;
+    unsigned threads = 0; // 0 = all cores
+};
+
+struct ImageMetrics {
+    double mse = 0.0;
+    double rmse = 0.0;
+    double psnr = 0.0;                     // +inf when identical
+    uint32_t max_abs_error = 0;
+    std::vector<uint64_t> error_histogram; // [e] = #pixels with |err| == e, size max_abs_error + 1
+    double ssim = 0.0;                     // Gaussian 11x11, sigma 1.5, K1 0.01, K2 0.03
+    double ms_ssim = 0.0;                  // 5 scales (fewer on small images, weights renormalized)
+};
+
+ImageMetrics compute_metrics(const Image& ref, const Image& rec, const MetricsOptions& opt = {});
+
+// Percentile of |err| from the histogram in O(bins): the value at rank
+// floor(p * (n - 1)) of the sorted errors (same pick as nth_element), p in [0,1].
+uint32_t error_percentile(const std::vector<uint64_t>& histogram, double p);
+
+// 8-bit error map: min(|err|, scale) * 255 / scale, rounded, via a (scale + 1)-entry
+// lookup table (no per-pixel floating point). Same domain mapping as compute_metrics.
+Image scaled_error_map(const Image& ref, const Image& rec, uint32_t scale, unsigned threads = 0);
+
+} // namespace mcodec
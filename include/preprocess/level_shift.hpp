@@ -10,6 +10,9 @@ namespace mcodec {
 void apply_level_shift(Image& im);
 void inverse_level_shift(Image& im);
 
+// Offset subtracted by apply_level_shift: 2^(B-1) for unsigned images, 0 for signed.
+int32_t level_shift_offset(int bits_stored, bool is_signed);
+
 } // namespace mcodec
 
 
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "io/image_types.hpp"
+
+namespace mcodec {
+
+// Window/level to 8-bit display values, DICOM linear VOI function (PS3.3 C.11.2.1.2.1).
+//
+// The LUT has 2^bits_stored entries indexed by the sample as an unsigned value:
+// lut[v + 2^(bits_stored-1)] for signed images, lut[v] otherwise. Samples outside the
+// bits_stored range are clamped to it first, as save_pgm does.
+void make_window_lut(int bits_stored, bool is_signed, const DisplayWindow& window, std::vector<uint8_t>& lut);
+
+// Reference path: window an already decoded image (`lut` from make_window_lut for its format).
+void apply_window(const Image& im, const std::vector<uint8_t>& lut, DisplayImage& out);
+DisplayImage apply_window(const Image& im, const DisplayWindow& window);
+
+} // namespace mcodec
@@ -21,6 +21,10 @@ void dequantize(const std::vector<int16_t>& qcoeff_in,
                 int quality,
                 std::vector<float>& coeff_out);
 
+// In-place change of step: same result as dequantize(from_quality) followed by
+// quantize(to_quality), without the float buffer. Works on any coefficient order.
+void requantize(std::vector<int16_t>& qcoeff, int from_quality, int to_quality);
+
 } // namespace mcodec
 
 
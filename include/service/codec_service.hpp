@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "io/image_types.hpp"
+
+namespace mcodec {
+
+// Long-running codec daemon (mcodecd) on a UNIX domain socket.
+//
+// Each request is a fixed 32-byte header followed by its payload; the reply is a
+// fixed 40-byte header followed by the result. Payloads travel inline over the
+// socket or, for large buffers, as a shared-memory file descriptor (memfd on Linux,
+// shm_open elsewhere) passed with SCM_RIGHTS, and the reply uses the same mode.
+// Workers keep warm EncoderSession / DecoderSession / TranscodeSession objects, so
+// a request pays neither process startup nor buffer allocation. POSIX only:
+// elsewhere the functions below throw.
+enum class ServiceOp : uint8_t {
+    Encode = 1,    // raw samples -> .mcodec
+    Decode = 2,    // .mcodec -> raw samples
+    Transcode = 3, // .mcodec -> .mcodec at another quality
+    Stats = 4,     // latency histograms as JSON
+};
+
+struct ServiceOptions {
+    std::string socket_path;
+    unsigned max_connections = 64; // further clients wait in the listen backlog
+};
+
+// Bind `socket_path` (an existing socket file is replaced) and serve, one thread per
+// connection, until stop_codec_service() is called; open connections are closed and
+// the socket file removed before returning. Throws if the socket cannot be set up.
+void run_codec_service(const ServiceOptions& opt);
+
+// Ask run_codec_service to return; safe to call from a signal handler.
+void stop_codec_service();
+
+// Per-op request latency (count, mean, p50/p90/p99 as power-of-two bucket bounds, max,
+// and the buckets themselves) as JSON; this is what ServiceOp::Stats returns.
+std::string codec_service_stats_json();
+
+// Blocking client for one connection; requests on one client are sequential.
+class ServiceClient {
+public:
+    explicit ServiceClient(const std::string& socket_path);
+    ~ServiceClient();
+    ServiceClient(const ServiceClient&) = delete;
+    ServiceClient& operator=(const ServiceClient&) = delete;
+
+    std::vector<uint8_t> encode(const PixelView& src, int quality);
+    Image decode(const std::vector<uint8_t>& bytes);
+    std::vector<uint8_t> transcode(const std::vector<uint8_t>& bytes, int quality);
+    std::string stats_json();
+
+    // Server-side time of the last request (receive to reply), microseconds.
+    double last_server_us() const { return last_server_us_; }
+
+    // Payloads of at least this many bytes go through a shared-memory fd.
+    static constexpr size_t kFdPassBytes = 64 * 1024;
+
+private:
+    int fd_ = -1;
+    double last_server_us_ = 0.0;
+};
+
+} // namespace mcodec
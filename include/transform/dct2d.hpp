@@ -12,10 +12,18 @@ void dct2d_blocks(const std::vector<int32_t>& blocks_in,
                   int block_size,
                   std::vector<float>& coeff_out);
 
+// One block of dct2d_blocks (same arithmetic): block_size^2 values from block_in to
+// coeff_out, for callers that transform only some of the blocks.
+void dct2d_block(const int32_t* block_in, int block_size, float* coeff_out);
+
 void idct2d_blocks(const std::vector<float>& coeff_in,
                    int block_size,
                    std::vector<int32_t>& blocks_out);
 
+// One block of idct2d_blocks (same arithmetic), for callers that consume the output
+// block by block: block_size^2 values from coeff_in to block_out.
+void idct2d_block(const float* coeff_in, int block_size, int32_t* block_out);
+
 } // namespace mcodec
 
 
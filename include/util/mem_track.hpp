@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Per-stage heap accounting.
+//
+// The library only tags regions of code (MemScope); the counting itself is done by
+// the global operator new/delete hook in src/util/mem_hook.cpp, which the CLI tools
+// link in. Without the hook every counter stays zero and mem_tracking_active() is false.
+//
+// Counters are per thread: an allocation is charged to the tag that is current on
+// the allocating thread, and its release is credited back to the same tag.
+
+namespace mcodec {
+
+enum class MemTag : uint8_t {
+    Other = 0,
+    // encoder
+    Tile,
+    Dct,
+    Quantize,
+    Zigzag,
+    Rle,        // zero RLE + symbol packing
+    Huffman,    // frequencies, table, bit packing
+    Bitstream,
+    // decoder (also uses Huffman, Rle, Zigzag)
+    Parse,
+    Dequantize,
+    Idct,
+    Untile,
+    Count
+};
+
+constexpr size_t kMemTagCount = static_cast<size_t>(MemTag::Count);
+
+struct MemUsage {
+    uint64_t alloc_bytes = 0;     // bytes requested
+    uint64_t allocs = 0;          // number of allocations
+    uint64_t peak_live_bytes = 0; // high-water mark of this tag's live bytes
+};
+
+// True once the operator new hook has seen an allocation.
+bool mem_tracking_active();
+
+// Tag allocations made by this thread until the scope ends (restores the previous tag).
+class MemScope {
+public:
+    explicit MemScope(MemTag tag);
+    ~MemScope();
+    MemScope(const MemScope&) = delete;
+    MemScope& operator=(const MemScope&) = delete;
+private:
+    uint8_t prev_;
+};
+
+// Measurement window over this thread's counters: usage() and peak_live_bytes()
+// report what happened since construction (peaks relative to the live bytes then).
+class MemWindow {
+public:
+    MemWindow();
+    MemUsage usage(MemTag tag) const;
+    uint64_t peak_live_bytes() const; // all tags together
+private:
+    uint64_t alloc_bytes_[kMemTagCount];
+    uint64_t allocs_[kMemTagCount];
+    int64_t live_[kMemTagCount];
+    int64_t total_live_;
+};
+
+namespace mem_detail {
+// Called by the operator new/delete hook only.
+uint8_t current_tag();
+void on_alloc(size_t bytes, uint8_t tag);
+void on_free(size_t bytes, uint8_t tag);
+} // namespace mem_detail
+
+} // namespace mcodec
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mcodec {
+
+// Number of worker threads to use when the caller passes 0.
+inline unsigned default_thread_count() {
+    const unsigned hw = std::thread::hardware_concurrency();
+    return hw == 0 ? 1u : hw;
+}
+
+// Run fn(i) for every i in [0, n) on up to `threads` workers (0 = all cores).
+// Items are handed out dynamically, so uneven per-item cost is fine.
+// The first exception thrown by fn is rethrown on the calling thread.
+template <typename Fn>
+void parallel_for(size_t n, Fn&& fn, unsigned threads = 0) {
+    if (n == 0) return;
+    if (threads == 0) threads = default_thread_count();
+    const size_t workers = std::min<size_t>(threads, n);
+    if (workers <= 1) {
+        for (size_t i = 0; i < n; ++i) fn(i);
+        return;
+    }
+
+    std::atomic<size_t> next{0};
+    std::exception_ptr first_error;
+    std::mutex error_mutex;
+
+    auto worker = [&]() {
+        while (true) {
+            const size_t i = next.fetch_add(1, std::memory_order_relaxed);
+            if (i >= n) return;
+            try {
+                fn(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!first_error) first_error = std::current_exception();
+                next.store(n, std::memory_order_relaxed); // stop handing out work
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(workers - 1);
+    for (size_t t = 1; t < workers; ++t) pool.emplace_back(worker);
+    worker();
+    for (auto& th : pool) th.join();
+
+    if (first_error) std::rethrow_exception(first_error);
+}
+
+} // namespace mcodec
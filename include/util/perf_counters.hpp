@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace mcodec {
+
+// Hardware counters measured over a start()/stop() window.
+enum class PerfEvent : int {
+    Cycles = 0,
+    Instructions,
+    BranchMisses,
+    L1dMisses,   // L1 data cache read misses
+    LlcMisses,   // last-level cache misses
+    Count
+};
+
+constexpr size_t kPerfEventCount = static_cast<size_t>(PerfEvent::Count);
+
+const char* perf_event_name(PerfEvent e);
+
+struct PerfSample {
+    uint64_t value[kPerfEventCount] = {};
+    bool valid[kPerfEventCount] = {}; // false: event not supported / not opened
+
+    bool has(PerfEvent e) const { return valid[static_cast<size_t>(e)]; }
+    uint64_t get(PerfEvent e) const { return value[static_cast<size_t>(e)]; }
+};
+
+// Per-thread user-space counters of the calling thread (Linux perf_event_open).
+// Events the kernel/CPU does not provide are skipped individually; on other
+// platforms, or when perf_event_paranoid forbids access, available() is false
+// and stop() returns an all-invalid sample.
+class PerfCounters {
+public:
+    PerfCounters();
+    ~PerfCounters();
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool available() const;
+    const std::string& error() const { return error_; } // why nothing could be opened
+
+    void start();
+    PerfSample stop(); // counts since start(), scaled if the kernel multiplexed them
+
+private:
+    int fd_[kPerfEventCount];
+    std::string error_;
+};
+
+} // namespace mcodec
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+
+namespace mcodec {
+
+// Peak resident set size of this process so far, in bytes (0 if unsupported).
+uint64_t peak_rss_bytes();
+
+} // namespace mcodec
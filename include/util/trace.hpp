@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Lightweight scoped trace spans, exported as Chrome / Perfetto trace-event JSON.
+//
+//   MCODEC_TRACE_SCOPE("dct2d");   // records [enter, exit) of the enclosing scope
+//
+// Built with MCODEC_ENABLE_TRACE (CMake option MCODEC_TRACE), a span costs two
+// clock reads and a store into a per-thread ring buffer, and only while tracing
+// is started. Without it the macro expands to nothing.
+
+namespace mcodec {
+
+// True if spans were compiled in.
+bool trace_compiled_in();
+
+// Start collecting spans (clears previously collected ones).
+void trace_start();
+void trace_stop();
+bool trace_enabled();
+
+// Write all collected spans as {"traceEvents":[...]} JSON.
+// Call after worker threads have finished (rings are read without locking).
+void write_chrome_trace(const std::string& path);
+
+namespace trace_detail {
+extern std::atomic<bool> g_enabled;
+int64_t now_ns();
+void record(const char* name, int64_t begin_ns, int64_t end_ns);
+} // namespace trace_detail
+
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name)
+        : name_(trace_detail::g_enabled.load(std::memory_order_relaxed) ? name : nullptr),
+          begin_(name_ ? trace_detail::now_ns() : 0) {}
+    ~TraceSpan() {
+        if (name_) trace_detail::record(name_, begin_, trace_detail::now_ns());
+    }
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+private:
+    const char* name_; // must be a string literal (stored by pointer)
+    int64_t begin_;
+};
+
+} // namespace mcodec
+
+#if defined(MCODEC_ENABLE_TRACE)
+#define MCODEC_TRACE_CONCAT_(a, b) a##b
+#define MCODEC_TRACE_CONCAT(a, b) MCODEC_TRACE_CONCAT_(a, b)
+#define MCODEC_TRACE_SCOPE(name) \
+    ::mcodec::TraceSpan MCODEC_TRACE_CONCAT(mcodec_trace_span_, __LINE__)(name)
+#else
+#define MCODEC_TRACE_SCOPE(name) ((void)0)
+#endif
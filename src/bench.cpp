@@ -0,0 +1,603 @@
+// Per-stage microbenchmarks: times every codec stage in isolation plus full encode/decode.
+// With --baseline it doubles as the perf-regression runner: every stage is measured
+// --repeat times (median / MAD) and compared against a stored baseline, and the
+// compressed size + PSNR at q25/50/75 must match the baseline exactly.
+#include "cli/cli_parser.hpp"
+#include "io/medical_loader.hpp"
+#include "preprocess/level_shift.hpp"
+#include "block/tiling.hpp"
+#include "block/zigzag.hpp"
+#include "transform/dct2d.hpp"
+#include "quant/quantizer.hpp"
+#include "entropy/rle.hpp"
+#include "entropy/huffman.hpp"
+#include "codec/encoder.hpp"
+#include "codec/decoder.hpp"
+#include "codec/predictive.hpp"
+#include "codec/size_estimate.hpp"
+#include "metrics/metrics.hpp"
+#include "util/mem_track.hpp"
+#include "util/perf_counters.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchConfig {
+    int quality = 50;
+    int min_iters = 3;
+    double min_ms = 200.0; // keep repeating a stage until this much time has passed
+    mcodec::PerfCounters* perf = nullptr; // --perf: hardware counters around each stage
+};
+
+struct StageResult {
+    std::string name;
+    double ns_per_op = 0.0;
+    double ns_per_block = 0.0;
+    double mb_per_s = 0.0;      // raw image bytes / time
+    double allocs_per_op = 0.0;
+    double bytes_per_op = 0.0;  // heap bytes requested per op
+    double mad_ns = 0.0;        // median absolute deviation of ns_per_op over --repeat runs
+    int iters = 0;
+    size_t blocks = 0;
+    mcodec::PerfSample perf;    // totals over all `iters` (--perf only)
+};
+
+// Keep a result the compiler could otherwise prove unused (and drop the stage computing it).
+template <typename T>
+inline void do_not_optimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static const void* volatile escape;
+    escape = &value;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+// Heap requests on this thread since `win` (all tags); zero unless mem_hook.cpp is linked.
+mcodec::MemUsage heap_usage(const mcodec::MemWindow& win) {
+    mcodec::MemUsage total;
+    for (size_t t = 0; t < mcodec::kMemTagCount; ++t) {
+        const mcodec::MemUsage u = win.usage(static_cast<mcodec::MemTag>(t));
+        total.alloc_bytes += u.alloc_bytes;
+        total.allocs += u.allocs;
+    }
+    return total;
+}
+
+// Run fn repeatedly (>= min_iters and >= min_ms) and report per-op averages.
+template <typename Fn>
+StageResult measure(const std::string& name, size_t blocks, size_t raw_bytes,
+                    const BenchConfig& cfg, Fn&& fn) {
+    fn(); // warm-up (caches, lazily built tables)
+
+    const mcodec::MemWindow mem_window;
+    if (cfg.perf) cfg.perf->start();
+    const auto t0 = Clock::now();
+    int iters = 0;
+    double elapsed_ms = 0.0;
+    while (iters < cfg.min_iters || elapsed_ms < cfg.min_ms) {
+        fn();
+        ++iters;
+        elapsed_ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    }
+    const mcodec::PerfSample perf = cfg.perf ? cfg.perf->stop() : mcodec::PerfSample{};
+    const mcodec::MemUsage heap = heap_usage(mem_window);
+
+    StageResult r;
+    r.name = name;
+    r.ns_per_op = elapsed_ms * 1e6 / iters;
+    r.ns_per_block = blocks ? r.ns_per_op / static_cast<double>(blocks) : 0.0;
+    r.mb_per_s = r.ns_per_op > 0 ? (static_cast<double>(raw_bytes) / 1e6) / (r.ns_per_op * 1e-9) : 0.0;
+    r.allocs_per_op = static_cast<double>(heap.allocs) / iters;
+    r.bytes_per_op = static_cast<double>(heap.alloc_bytes) / iters;
+    r.iters = iters;
+    r.blocks = blocks;
+    r.perf = perf;
+    return r;
+}
+
+// Deterministic synthetic slice: smooth body-like disc, flat background, mild noise.
+mcodec::Image make_synthetic(int width, int height, int bits) {
+    mcodec::Image im;
+    im.width = width;
+    im.height = height;
+    im.channels = 1;
+    im.bits_stored = bits;
+    im.bits_allocated = bits <= 8 ? 8 : 16;
+    im.is_signed = false;
+    im.type = bits <= 8 ? mcodec::PixelType::U8 : mcodec::PixelType::U16;
+    im.pixels.resize(static_cast<size_t>(width) * height);
+
+    const int32_t maxv = (1 << bits) - 1;
+    uint32_t lcg = 12345u;
+    const double cx = width * 0.5, cy = height * 0.5;
+    const double r2 = (0.4 * width) * (0.4 * width);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            const double dx = x - cx, dy = y - cy;
+            int32_t v = 0;
+            if (dx * dx + dy * dy < r2) {
+                lcg = lcg * 1664525u + 1013904223u;
+                const int32_t noise = static_cast<int32_t>((lcg >> 24) & 0x0F) - 8;
+                v = static_cast<int32_t>(maxv * (0.35 + 0.25 * (x + y) / static_cast<double>(width + height))) + noise;
+            }
+            if (v < 0) v = 0;
+            if (v > maxv) v = maxv;
+            im.pixels[static_cast<size_t>(y) * width + x] = v;
+        }
+    }
+    return im;
+}
+
+std::vector<StageResult> bench_image(const mcodec::Image& src, const BenchConfig& cfg) {
+    using namespace mcodec;
+    const int N = 8;
+    const int q = cfg.quality;
+    const size_t raw_bytes = static_cast<size_t>(src.width) * src.height * (src.bits_allocated / 8);
+
+    // Prepare every stage's input once with the real pipeline.
+    const BlockGrid grid = make_grid(src.width, src.height, N);
+    const size_t blocks_n = static_cast<size_t>(grid.blocks_x) * grid.blocks_y;
+    const int32_t offset = level_shift_offset(src.bits_stored, src.is_signed);
+    std::vector<int32_t> blocks = tile_to_blocks(src, grid, offset);
+    std::vector<float> coeffs;
+    dct2d_blocks(blocks, N, coeffs);
+    std::vector<int16_t> qcoeff;
+    quantize(coeffs, N, q, qcoeff);
+    std::vector<int16_t> seq;
+    zigzag_scan_blocks(qcoeff, N, seq);
+    std::vector<RlePair> rle;
+    rle_encode_zeros(seq, N, rle);
+    std::vector<uint32_t> symbols;
+    pack_rle_symbols(rle, symbols);
+    std::vector<std::pair<uint32_t, uint32_t>> freqs;
+    build_symbol_frequencies(symbols, freqs);
+    auto encoded = huff_encode(symbols);
+    const std::vector<uint8_t> bytes = encode_to_mcodec(src, q);
+    const std::vector<uint8_t> lossless_bytes = encode_lossless_mcodec(src);
+    const Image decoded = decode_from_mcodec(bytes);
+
+    // Scratch outputs live outside the timed lambdas so the work is not optimized away.
+    std::vector<int32_t> out_i32;
+    std::vector<float> out_f;
+    std::vector<int16_t> out_i16;
+    std::vector<RlePair> out_rle;
+    std::vector<uint32_t> out_sym;
+    std::vector<std::pair<uint32_t, uint32_t>> out_freqs;
+    std::vector<uint8_t> out_bytes;
+    Image out_image;
+    DisplayImage out_display;
+    const double levels = static_cast<double>(1 << src.bits_stored); // maxv + 1
+    const DisplayWindow window{levels / 2.0, std::max(1.0, levels / 4.0)};
+    HuffmanEncoder huff;
+    EncoderSession enc_session;
+    DecoderSession dec_session;
+    // series coding of the same slice over and over: every call after the first reuses the table
+    SeriesEncoder series_enc(q);
+    std::vector<uint8_t> series_bytes;
+    series_enc.encode(src, series_bytes);
+    DecoderSession series_session;
+    series_session.set_series_tables(series_enc.tables());
+
+    std::vector<StageResult> res;
+    auto add = [&](const std::string& name, auto&& fn) {
+        res.push_back(measure(name, blocks_n, raw_bytes, cfg, fn));
+    };
+
+    add("tile", [&] {
+        BlockGrid g = make_grid(src.width, src.height, N);
+        out_i32 = tile_to_blocks(src, g, offset);
+    });
+    add("dct2d", [&] { dct2d_blocks(blocks, N, out_f); });
+    add("idct2d", [&] { idct2d_blocks(coeffs, N, out_i32); });
+    add("quantize", [&] { quantize(coeffs, N, q, out_i16); });
+    add("dequantize", [&] { dequantize(qcoeff, N, q, out_f); });
+    add("zigzag", [&] { zigzag_scan_blocks(qcoeff, N, out_i16); });
+    add("inv_zigzag", [&] { inverse_zigzag_blocks(seq, N, out_i16); });
+    add("rle_encode", [&] {
+        rle_encode_zeros(seq, N, out_rle);
+        pack_rle_symbols(out_rle, out_sym);
+    });
+    add("rle_decode", [&] {
+        unpack_rle_symbols(symbols, out_rle);
+        rle_decode_zeros(out_rle, N, seq.size(), out_i16);
+    });
+    add("sym_freq", [&] { build_symbol_frequencies(symbols, out_freqs); });
+    add("huff_table", [&] {
+        HuffTable t = build_canonical_table(freqs);
+        do_not_optimize(t);
+    });
+    add("huff_encode", [&] {
+        auto e = huff_encode(symbols);
+        do_not_optimize(e);
+    });
+    add("huff_decode", [&] { huff_decode(encoded.second, encoded.first, symbols.size(), out_sym); });
+    add("huff_coder", [&] {
+        huff.build(symbols);
+        out_bytes.clear();
+        huff.write_payload(out_bytes);
+    });
+    add("encode", [&] {
+        auto b = encode_to_mcodec(src, q);
+        do_not_optimize(b);
+    });
+    add("decode", [&] {
+        Image im = decode_from_mcodec(bytes);
+        do_not_optimize(im);
+    });
+    add("session_encode", [&] { enc_session.encode(src, q, out_bytes); });
+    add("estimate_size", [&] { do_not_optimize(estimate_mcodec_size(src, q)); });
+    add("session_decode", [&] { dec_session.decode(bytes, out_image); });
+    add("series_encode", [&] { series_enc.encode(src, out_bytes); });
+    add("series_decode", [&] { series_session.decode(series_bytes, out_image); });
+    add("display_decode", [&] { dec_session.decode_display(bytes, window, out_display); });
+    add("lossless_encode", [&] {
+        auto b = encode_lossless_mcodec(src);
+        do_not_optimize(b);
+    });
+    add("lossless_decode", [&] { dec_session.decode(lossless_bytes, out_image); });
+    // single-threaded like every other stage: MemWindow and PerfCounters see only this thread
+    add("metrics", [&] {
+        ImageMetrics m = compute_metrics(src, decoded, MetricsOptions{true, true, true, 1});
+        do_not_optimize(m);
+    });
+
+    return res;
+}
+
+double median_of(std::vector<double> v) {
+    if (v.empty()) return 0.0;
+    const size_t mid = v.size() / 2;
+    std::nth_element(v.begin(), v.begin() + mid, v.end());
+    if (v.size() % 2) return v[mid];
+    const double hi = v[mid];
+    return 0.5 * (hi + *std::max_element(v.begin(), v.begin() + mid));
+}
+
+// Run the whole stage suite `repeats` times; ns_per_op becomes the median, mad_ns its MAD.
+std::vector<StageResult> bench_repeated(const mcodec::Image& src, const BenchConfig& cfg, int repeats) {
+    std::vector<std::vector<StageResult>> runs;
+    for (int r = 0; r < repeats; ++r) runs.push_back(bench_image(src, cfg));
+
+    std::vector<StageResult> res = runs.front();
+    for (size_t s = 0; s < res.size(); ++s) {
+        std::vector<double> ns;
+        for (const auto& run : runs) ns.push_back(run[s].ns_per_op);
+        const double med = median_of(ns);
+        for (double& x : ns) x = std::fabs(x - med);
+        const double scale = res[s].ns_per_op > 0 ? med / res[s].ns_per_op : 0.0;
+        res[s].ns_per_op = med;
+        res[s].ns_per_block *= scale;
+        res[s].mb_per_s = scale > 0 ? res[s].mb_per_s / scale : 0.0;
+        res[s].mad_ns = median_of(ns);
+    }
+    return res;
+}
+
+void print_results(const std::string& label, const mcodec::Image& im,
+                   const std::vector<StageResult>& res) {
+    const int blocks = ((im.width + 7) / 8) * ((im.height + 7) / 8);
+    std::printf("\n== %s  (%dx%d, B=%d, %d blocks)\n", label.c_str(), im.width, im.height,
+                im.bits_stored, blocks);
+    std::printf("%-14s %12s %10s %10s %10s %10s %12s\n", "stage", "us/op", "MAD us", "ns/block", "MB/s",
+                "allocs/op", "KB alloc/op");
+    for (const auto& r : res) {
+        std::printf("%-14s %12.1f %10.1f %10.1f %10.1f %10.1f %12.1f\n", r.name.c_str(), r.ns_per_op / 1e3,
+                    r.mad_ns / 1e3, r.ns_per_block, r.mb_per_s, r.allocs_per_op, r.bytes_per_op / 1024.0);
+    }
+}
+
+// --perf table: IPC and per-block cycles / misses; "-" where the event is unavailable.
+void print_perf(const std::vector<StageResult>& res) {
+    using mcodec::PerfEvent;
+    bool any = false;
+    for (const auto& r : res) any = any || r.perf.has(PerfEvent::Cycles) || r.perf.has(PerfEvent::BranchMisses);
+    if (!any) return;
+
+    std::printf("%-14s %8s %12s %12s %12s %12s\n", "stage", "IPC", "cyc/block", "brmiss/blk", "L1dmiss/blk",
+                "LLCmiss/blk");
+    auto col = [](const StageResult& r, PerfEvent e) {
+        char buf[32];
+        if (!r.perf.has(e) || r.iters == 0 || r.blocks == 0) return std::string("-");
+        std::snprintf(buf, sizeof(buf), "%.2f",
+                      static_cast<double>(r.perf.get(e)) / (static_cast<double>(r.iters) * r.blocks));
+        return std::string(buf);
+    };
+    for (const auto& r : res) {
+        char ipc[32] = "-";
+        if (r.perf.has(PerfEvent::Cycles) && r.perf.has(PerfEvent::Instructions) && r.perf.get(PerfEvent::Cycles)) {
+            std::snprintf(ipc, sizeof(ipc), "%.2f",
+                          static_cast<double>(r.perf.get(PerfEvent::Instructions)) / r.perf.get(PerfEvent::Cycles));
+        }
+        std::printf("%-14s %8s %12s %12s %12s %12s\n", r.name.c_str(), ipc, col(r, PerfEvent::Cycles).c_str(),
+                    col(r, PerfEvent::BranchMisses).c_str(), col(r, PerfEvent::L1dMisses).c_str(),
+                    col(r, PerfEvent::LlcMisses).c_str());
+    }
+}
+
+// ---------------- output invariants ---------------- //
+// Compressed size and PSNR as evaluate reports them (mcodec::compute_metrics).
+struct OutputPoint {
+    int quality = 0;
+    uint64_t bytes = 0;
+    double psnr = 0.0;
+};
+
+double psnr_of(const mcodec::Image& ref, const mcodec::Image& rec) {
+    const double psnr = mcodec::compute_metrics(ref, rec, mcodec::MetricsOptions{false, false, false, 1}).psnr;
+    return std::isfinite(psnr) ? psnr : 999.0; // lossless; JSON has no infinity
+}
+
+std::vector<OutputPoint> output_points(const mcodec::Image& src) {
+    std::vector<OutputPoint> pts;
+    for (int q : {25, 50, 75}) {
+        const auto bytes = mcodec::encode_to_mcodec(src, q);
+        pts.push_back({q, bytes.size(), psnr_of(src, mcodec::decode_from_mcodec(bytes))});
+    }
+    return pts;
+}
+
+// ---------------- baseline file ---------------- //
+// {"stages":{"<input>/<stage>":{"median_ns":..,"mad_ns":..}},
+//  "outputs":{"<input>/q<q>":{"bytes":..,"psnr":..}}}
+// Read back as a flat map "stages.<input>/<stage>.median_ns" -> value.
+class FlatJsonReader {
+public:
+    explicit FlatJsonReader(std::string text) : s_(std::move(text)) {}
+
+    std::map<std::string, double> parse() {
+        std::map<std::string, double> out;
+        ws();
+        object("", out);
+        return out;
+    }
+
+private:
+    void ws() { while (i_ < s_.size() && std::isspace(static_cast<unsigned char>(s_[i_]))) ++i_; }
+    void expect(char c) {
+        ws();
+        if (i_ >= s_.size() || s_[i_] != c) throw std::runtime_error(std::string("baseline: expected '") + c + "'");
+        ++i_;
+    }
+    std::string str() {
+        expect('"');
+        std::string r;
+        while (i_ < s_.size() && s_[i_] != '"') r += s_[i_++];
+        expect('"');
+        return r;
+    }
+    void object(const std::string& prefix, std::map<std::string, double>& out) {
+        expect('{');
+        ws();
+        if (i_ < s_.size() && s_[i_] == '}') { ++i_; return; }
+        for (;;) {
+            const std::string key = prefix.empty() ? str() : prefix + "." + str();
+            expect(':');
+            ws();
+            if (i_ < s_.size() && s_[i_] == '{') {
+                object(key, out);
+            } else if (i_ < s_.size() && s_[i_] == '"') {
+                str(); // string values carry no numbers we compare
+            } else {
+                size_t used = 0;
+                out[key] = std::stod(s_.substr(i_), &used);
+                i_ += used;
+            }
+            ws();
+            if (i_ < s_.size() && s_[i_] == ',') { ++i_; continue; }
+            expect('}');
+            return;
+        }
+    }
+
+    std::string s_;
+    size_t i_ = 0;
+};
+
+struct InputRun {
+    std::string key;   // baseline key, e.g. "I26" or "synth_512x512_12"
+    std::vector<StageResult> stages;
+    std::vector<OutputPoint> outputs;
+};
+
+void write_baseline(const std::string& path, const std::vector<InputRun>& runs) {
+    std::ofstream ofs(path, std::ios::trunc);
+    if (!ofs.good()) throw std::runtime_error("Cannot write baseline: " + path);
+    char buf[160];
+    ofs << "{\n  \"stages\": {";
+    bool first = true;
+    for (const auto& run : runs) {
+        for (const auto& r : run.stages) {
+            std::snprintf(buf, sizeof(buf), "\"median_ns\": %.0f, \"mad_ns\": %.0f", r.ns_per_op, r.mad_ns);
+            ofs << (first ? "\n" : ",\n") << "    \"" << run.key << "/" << r.name << "\": {" << buf << "}";
+            first = false;
+        }
+    }
+    ofs << "\n  },\n  \"outputs\": {";
+    first = true;
+    for (const auto& run : runs) {
+        for (const auto& o : run.outputs) {
+            std::snprintf(buf, sizeof(buf), "\"bytes\": %llu, \"psnr\": %.4f",
+                          static_cast<unsigned long long>(o.bytes), o.psnr);
+            ofs << (first ? "\n" : ",\n") << "    \"" << run.key << "/q" << o.quality << "\": {" << buf << "}";
+            first = false;
+        }
+    }
+    ofs << "\n  }\n}\n";
+}
+
+// Returns the number of failures (stage regressions + changed outputs).
+// A stage regresses when its median is more than `threshold` (fraction) above the
+// baseline median and the difference exceeds 3x the larger MAD (noise guard).
+// A stage or output without a baseline entry fails too, unless allow_new (a new
+// stage or input whose baseline is written in the same change).
+int compare_baseline(const std::map<std::string, double>& base, const std::vector<InputRun>& runs,
+                     double threshold, bool allow_new) {
+    const char* const missing = allow_new ? "new" : "MISSING";
+    int failures = 0;
+    std::printf("\n== baseline comparison (threshold %.0f%%)\n", threshold * 100.0);
+    for (const auto& run : runs) {
+        for (const auto& r : run.stages) {
+            const std::string k = "stages." + run.key + "/" + r.name;
+            const auto med = base.find(k + ".median_ns");
+            if (med == base.end()) {
+                if (!allow_new) ++failures;
+                std::printf("  %-9s %s/%s (no baseline)\n", missing, run.key.c_str(), r.name.c_str());
+                continue;
+            }
+            const auto mad = base.find(k + ".mad_ns");
+            const double b = med->second;
+            const double noise = 3.0 * std::max(r.mad_ns, mad == base.end() ? 0.0 : mad->second);
+            const double change = b > 0 ? (r.ns_per_op - b) / b : 0.0;
+            const bool slow = change > threshold && (r.ns_per_op - b) > noise;
+            if (slow) ++failures;
+            std::printf("  %-9s %-28s %10.1f us vs %10.1f us (%+.1f%%)\n", slow ? "REGRESSED" : "ok",
+                        (run.key + "/" + r.name).c_str(), r.ns_per_op / 1e3, b / 1e3, change * 100.0);
+        }
+        for (const auto& o : run.outputs) {
+            const std::string name = run.key + "/q" + std::to_string(o.quality);
+            const auto bytes = base.find("outputs." + name + ".bytes");
+            const auto psnr = base.find("outputs." + name + ".psnr");
+            if (bytes == base.end() || psnr == base.end()) {
+                if (!allow_new) ++failures;
+                std::printf("  %-9s %s (no baseline)\n", missing, name.c_str());
+                continue;
+            }
+            const bool same = static_cast<uint64_t>(bytes->second) == o.bytes &&
+                              std::fabs(psnr->second - o.psnr) < 5e-4;
+            if (!same) ++failures;
+            std::printf("  %-9s %-28s %10llu B  PSNR %.4f (baseline %llu B, %.4f)\n", same ? "ok" : "CHANGED",
+                        name.c_str(), static_cast<unsigned long long>(o.bytes), o.psnr,
+                        static_cast<unsigned long long>(bytes->second), psnr->second);
+        }
+    }
+    return failures;
+}
+
+bool parse_size(const std::string& s, int& w, int& h) {
+    const auto x = s.find('x');
+    if (x == std::string::npos) return false;
+    try {
+        w = std::stoi(s.substr(0, x));
+        h = std::stoi(s.substr(x + 1));
+    } catch (...) {
+        return false;
+    }
+    return w > 0 && h > 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const char* usage =
+        "Usage: mcodec_bench [--in <image>] [--assets <dir>] [--size WxH] [--bits B]\n"
+        "                    [--quality q] [--min_ms ms] [--iters n] [--repeat n] [--perf]\n"
+        "                    [--baseline <json> [--threshold pct] [--allow-new]] [--write-baseline <json>]\n";
+    try {
+        mcodec::CliParser cli;
+        cli.parse(argc, argv);
+        if (cli.has("help")) {
+            std::cout << usage;
+            return 0;
+        }
+
+        BenchConfig cfg;
+        cfg.quality = std::stoi(cli.get("quality", "50"));
+        cfg.min_ms = std::stod(cli.get("min_ms", "200"));
+        cfg.min_iters = std::stoi(cli.get("iters", "3"));
+        if (cfg.quality < 1 || cfg.quality > 100) throw std::runtime_error("quality out of range 1..100");
+        const bool regression = cli.has("baseline") || cli.has("write-baseline");
+        const int repeats = std::stoi(cli.get("repeat", regression ? "5" : "1"));
+        if (repeats < 1) throw std::runtime_error("--repeat must be >= 1");
+        const double threshold = std::stod(cli.get("threshold", "10")) / 100.0;
+
+        std::unique_ptr<mcodec::PerfCounters> perf;
+        if (cli.has("perf")) {
+            perf = std::make_unique<mcodec::PerfCounters>();
+            if (perf->available()) {
+                cfg.perf = perf.get();
+            } else {
+                std::cerr << "[WARN] hardware counters unavailable (" << perf->error()
+                          << "); reporting wall time only\n";
+            }
+        }
+
+        // Inputs: explicit --in, else the bundled assets; plus one synthetic image.
+        // Regression mode always adds a small 8-bit image so the U8 paths are covered too.
+        std::vector<std::pair<std::string, mcodec::Image>> inputs;
+        if (cli.has("in")) {
+            inputs.push_back({cli.get("in"), mcodec::load_medical(cli.get("in"))});
+        } else {
+            const std::string dir = cli.get("assets", "assets");
+            for (const char* name : {"I0", "I26"}) {
+                const std::string path = (std::filesystem::path(dir) / name).string();
+                try {
+                    inputs.push_back({path, mcodec::load_medical(path)});
+                } catch (const std::exception& e) {
+                    // the regression corpus is fixed: a missing asset must not pass silently
+                    if (regression) throw;
+                    std::cerr << "[WARN] skip " << path << ": " << e.what() << "\n";
+                }
+            }
+        }
+        int w = 512, h = 512;
+        if (!parse_size(cli.get("size", "512x512"), w, h)) throw std::runtime_error("--size must be WxH");
+        const int bits = std::stoi(cli.get("bits", "12"));
+        if (bits < 1 || bits > 16) throw std::runtime_error("--bits out of range 1..16");
+        inputs.push_back({"synth_" + std::to_string(w) + "x" + std::to_string(h) + "_" + std::to_string(bits),
+                          make_synthetic(w, h, bits)});
+        if (regression) inputs.push_back({"synth_256x256_8", make_synthetic(256, 256, 8)});
+
+        std::printf("quality=%d min_ms=%.0f repeat=%d\n", cfg.quality, cfg.min_ms, repeats);
+        std::vector<InputRun> runs;
+        for (const auto& [label, im] : inputs) {
+            InputRun run;
+            run.key = std::filesystem::path(label).filename().string();
+            run.stages = bench_repeated(im, cfg, repeats);
+            print_results(label, im, run.stages);
+            print_perf(run.stages);
+            if (regression) run.outputs = output_points(im);
+            runs.push_back(std::move(run));
+        }
+
+        int failures = 0;
+        if (cli.has("baseline")) {
+            std::ifstream ifs(cli.get("baseline"), std::ios::binary);
+            if (!ifs.good()) throw std::runtime_error("Cannot open baseline: " + cli.get("baseline"));
+            std::stringstream ss;
+            ss << ifs.rdbuf();
+            failures = compare_baseline(FlatJsonReader(ss.str()).parse(), runs, threshold, cli.has("allow-new"));
+            std::printf("%s (%d failure%s)\n", failures ? "PERF REGRESSION" : "PERF OK", failures,
+                        failures == 1 ? "" : "s");
+        }
+        if (cli.has("write-baseline")) {
+            write_baseline(cli.get("write-baseline"), runs);
+            std::printf("Wrote baseline: %s\n", cli.get("write-baseline").c_str());
+        }
+        return failures ? 2 : 0;
+    } catch (const std::exception& e) {
+        std::cerr << "[ERROR] " << e.what() << "\n" << usage;
+        return 1;
+    }
+}
@@ -1,5 +1,6 @@
 #include "block/tiling.hpp"
 
+#include <cstdint>
 #include <stdexcept>
 
 namespace mcodec {
@@ -20,26 +21,72 @@ BlockGrid make_grid(int width, int height, int block_size) {
     return g;
 }
 
-std::vector<int32_t> tile_to_blocks(const Image& img, const BlockGrid& g) {
+namespace {
+template <typename T>
+void copy_rows_shifted(const T* src, int width, int height, int32_t offset,
+                       const BlockGrid& g, std::vector<int32_t>& padded) {
+    for (int y = 0; y < height; ++y) {
+        const T* row = src + static_cast<size_t>(y) * width;
+        int32_t* dst = padded.data() + static_cast<size_t>(y) * g.padded_w;
+        for (int x = 0; x < width; ++x) {
+            dst[x] = static_cast<int32_t>(row[x]) - offset;
+        }
+    }
+}
+
+void check_grid(int width, int height, const BlockGrid& g) {
+    if (g.padded_w <= 0 || g.padded_h <= 0) {
+        throw std::runtime_error("tile_to_blocks: invalid grid");
+    }
+    if (g.padded_w < width || g.padded_h < height) {
+        throw std::runtime_error("tile_to_blocks: grid smaller than image");
+    }
+}
+} // namespace
+
+std::vector<int32_t> tile_to_blocks(const Image& img, const BlockGrid& g, int32_t offset) {
+    std::vector<int32_t> padded;
+    tile_to_blocks(img, g, offset, padded);
+    return padded;
+}
+
+std::vector<int32_t> tile_to_blocks(const PixelView& src, const BlockGrid& g, int32_t offset) {
+    std::vector<int32_t> padded;
+    tile_to_blocks(src, g, offset, padded);
+    return padded;
+}
+
+void tile_to_blocks(const Image& img, const BlockGrid& g, int32_t offset, std::vector<int32_t>& padded) {
     if (img.channels != 1) throw std::runtime_error("tile_to_blocks: only grayscale supported");
     if (img.width <= 0 || img.height <= 0) throw std::runtime_error("tile_to_blocks: invalid image size");
     if (static_cast<int>(img.pixels.size()) != img.width * img.height) {
         throw std::runtime_error("tile_to_blocks: pixel buffer mismatch");
     }
-    if (g.padded_w <= 0 || g.padded_h <= 0) {
-        throw std::runtime_error("tile_to_blocks: invalid grid");
-    }
+    check_grid(img.width, img.height, g);
 
-    std::vector<int32_t> padded(static_cast<size_t>(g.padded_w) * g.padded_h, 0);
+    padded.assign(static_cast<size_t>(g.padded_w) * g.padded_h, 0);
+    copy_rows_shifted(img.pixels.data(), img.width, img.height, offset, g, padded);
+}
 
-    for (int y = 0; y < img.height; ++y) {
-        for (int x = 0; x < img.width; ++x) {
-            const size_t src_idx = static_cast<size_t>(y) * img.width + x;
-            const size_t dst_idx = static_cast<size_t>(y) * g.padded_w + x;
-            padded[dst_idx] = img.pixels[src_idx];
-        }
+void tile_to_blocks(const PixelView& src, const BlockGrid& g, int32_t offset, std::vector<int32_t>& padded) {
+    if (!src.data) throw std::runtime_error("tile_to_blocks: null pixel buffer");
+    if (src.width <= 0 || src.height <= 0) throw std::runtime_error("tile_to_blocks: invalid image size");
+    check_grid(src.width, src.height, g);
+
+    padded.assign(static_cast<size_t>(g.padded_w) * g.padded_h, 0);
+    switch (src.type) {
+    case PixelType::U8:
+        copy_rows_shifted(static_cast<const uint8_t*>(src.data), src.width, src.height, offset, g, padded);
+        break;
+    case PixelType::U16:
+        copy_rows_shifted(static_cast<const uint16_t*>(src.data), src.width, src.height, offset, g, padded);
+        break;
+    case PixelType::S16:
+        copy_rows_shifted(static_cast<const int16_t*>(src.data), src.width, src.height, offset, g, padded);
+        break;
+    default:
+        throw std::runtime_error("tile_to_blocks: unsupported pixel type");
     }
-    return padded;
 }
 
 void untile_from_blocks(Image& img, const BlockGrid& g, const std::vector<int32_t>& padded) {
@@ -59,6 +106,30 @@ void untile_from_blocks(Image& img, const BlockGrid& g, const std::vector<int32_
     }
 }
 
+size_t find_flat_blocks(const std::vector<int32_t>& padded, int block_size, std::vector<int32_t>& flat) {
+    if (block_size != 8 && block_size != 16) {
+        throw std::runtime_error("find_flat_blocks: block_size must be 8 or 16");
+    }
+    const size_t block_elems = static_cast<size_t>(block_size * block_size);
+    if (padded.size() % block_elems != 0) {
+        throw std::runtime_error("find_flat_blocks: input size not multiple of block");
+    }
+    const size_t blocks = padded.size() / block_elems;
+    flat.resize(blocks);
+    size_t count = 0;
+    for (size_t b = 0; b < blocks; ++b) {
+        const int32_t* src = padded.data() + b * block_elems;
+        const int32_t v = src[0];
+        int32_t diff = 0; // branch-free, so the compare loop vectorizes
+        for (size_t i = 1; i < block_elems; ++i) diff |= src[i] ^ v;
+        const bool uniform = diff == 0 && v >= INT16_MIN && v <= INT16_MAX;
+        flat[b] = uniform ? v : kNotFlat;
+        count += uniform ? 1u : 0u;
+    }
+    if (count == 0) flat.clear();
+    return count;
+}
+
 #ifndef NDEBUG
 namespace {
 // Simple self-test to validate tiling/untile round-trip on a tiny image.
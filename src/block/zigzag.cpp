@@ -26,6 +26,15 @@ std::vector<int> make_zigzag_order(int N) {
     return order;
 }
 
+namespace {
+// Orders for the two supported block sizes, built once.
+const std::vector<int>& cached_zigzag_order(int N) {
+    static const std::vector<int> order8 = make_zigzag_order(8);
+    static const std::vector<int> order16 = make_zigzag_order(16);
+    return N == 8 ? order8 : order16;
+}
+} // namespace
+
 void zigzag_scan_blocks(const std::vector<int16_t>& qcoeff_in,
                         int block_size,
                         std::vector<int16_t>& seq_out) {
@@ -37,7 +46,7 @@ void zigzag_scan_blocks(const std::vector<int16_t>& qcoeff_in,
         throw std::runtime_error("zigzag_scan_blocks: input size not multiple of block");
     }
 
-    auto order = make_zigzag_order(block_size);
+    const std::vector<int>& order = cached_zigzag_order(block_size);
     const size_t blocks = qcoeff_in.size() / block_elems;
     seq_out.resize(qcoeff_in.size());
 
@@ -61,7 +70,7 @@ void inverse_zigzag_blocks(const std::vector<int16_t>& seq_in,
         throw std::runtime_error("inverse_zigzag_blocks: input size not multiple of block");
     }
 
-    auto order = make_zigzag_order(block_size);
+    const std::vector<int>& order = cached_zigzag_order(block_size);
     const size_t blocks = seq_in.size() / block_elems;
     qcoeff_out.resize(seq_in.size());
 
@@ -0,0 +1,51 @@
+#include "cli/cli_output.hpp"
+
+#include "util/trace.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+namespace mcodec {
+
+namespace {
+bool g_status_to_stderr = false;
+} // namespace
+
+void set_status_to_stderr(bool to_stderr) { g_status_to_stderr = to_stderr; }
+
+std::ostream& status_out() {
+    return g_status_to_stderr ? std::cerr : std::cout;
+}
+
+void emit_stats(const std::string& dest, const std::string& json) {
+    if (dest == "true") {
+        status_out() << json << "\n";
+        return;
+    }
+    std::ofstream ofs(dest, std::ios::binary);
+    if (!ofs.good()) throw std::runtime_error("Cannot write file: " + dest);
+    ofs << json << "\n";
+}
+
+CliTrace::CliTrace(std::string path) : path_(std::move(path)) {
+    if (path_.empty()) return;
+    if (!trace_compiled_in()) {
+        std::cerr << "[WARN] --trace: built without MCODEC_TRACE, the trace will be empty\n";
+    }
+    trace_start();
+}
+
+CliTrace::~CliTrace() {
+    if (path_.empty()) return;
+    trace_stop();
+    try {
+        write_chrome_trace(path_);
+        status_out() << "Trace: " << path_ << "\n";
+    } catch (const std::exception& e) {
+        std::cerr << "[WARN] --trace: " << e.what() << "\n";
+    }
+}
+
+} // namespace mcodec
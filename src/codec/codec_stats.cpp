@@ -0,0 +1,111 @@
+#include "codec/codec_stats.hpp"
+
+#include <sstream>
+
+namespace mcodec {
+
+namespace {
+// Tiny JSON object writer: "key":value pairs, comma-separated.
+class JsonObject {
+public:
+    JsonObject() { os_ << "{"; }
+    template <typename T>
+    JsonObject& field(const char* key, T value) {
+        if (!first_) os_ << ",";
+        first_ = false;
+        os_ << "\"" << key << "\":" << value;
+        return *this;
+    }
+    // Nested object / pre-formatted JSON value.
+    JsonObject& raw(const char* key, const std::string& json) {
+        if (!first_) os_ << ",";
+        first_ = false;
+        os_ << "\"" << key << "\":" << json;
+        return *this;
+    }
+    std::string str() { os_ << "}"; return os_.str(); }
+private:
+    std::ostringstream os_;
+    bool first_ = true;
+};
+std::string mem_json(const MemUsage& m) {
+    JsonObject j;
+    j.field("alloc_bytes", m.alloc_bytes)
+     .field("allocs", m.allocs)
+     .field("peak_live_bytes", m.peak_live_bytes);
+    return j.str();
+}
+} // namespace
+
+std::string to_json(const EncodeStats& s) {
+    JsonObject j;
+    j.field("tile_ms", s.tile_ms)
+     .field("dct_ms", s.dct_ms)
+     .field("quantize_ms", s.quantize_ms)
+     .field("zigzag_ms", s.zigzag_ms)
+     .field("rle_ms", s.rle_ms)
+     .field("huffman_ms", s.huffman_ms)
+     .field("bitstream_ms", s.bitstream_ms)
+     .field("total_ms", s.total_ms)
+     .field("blocks", s.blocks)
+     .field("skipped_blocks", s.skipped_blocks)
+     .field("nonzero_coeffs", s.nonzero_coeffs)
+     .field("rle_pairs", s.rle_pairs)
+     .field("symbols", s.symbols)
+     .field("used_symbols", s.used_symbols)
+     .field("max_code_len", s.max_code_len)
+     .field("table_bytes", s.table_bytes)
+     .field("payload_bytes", s.payload_bytes)
+     .field("output_bytes", s.output_bytes);
+    if (s.mem_tracked) {
+        JsonObject mem;
+        mem.raw("tile", mem_json(s.tile_mem))
+           .raw("dct", mem_json(s.dct_mem))
+           .raw("quantize", mem_json(s.quantize_mem))
+           .raw("zigzag", mem_json(s.zigzag_mem))
+           .raw("rle", mem_json(s.rle_mem))
+           .raw("huffman", mem_json(s.huffman_mem))
+           .raw("bitstream", mem_json(s.bitstream_mem))
+           .field("peak_live_bytes", s.peak_live_bytes);
+        j.raw("mem", mem.str());
+    }
+    return j.str();
+}
+
+std::string to_json(const DecodeStats& s) {
+    JsonObject j;
+    j.field("parse_ms", s.parse_ms)
+     .field("huffman_ms", s.huffman_ms)
+     .field("rle_ms", s.rle_ms)
+     .field("zigzag_ms", s.zigzag_ms)
+     .field("dequantize_ms", s.dequantize_ms)
+     .field("idct_ms", s.idct_ms)
+     .field("untile_ms", s.untile_ms)
+     .field("total_ms", s.total_ms)
+     .field("blocks", s.blocks)
+     .field("skipped_blocks", s.skipped_blocks)
+     .field("nonzero_coeffs", s.nonzero_coeffs)
+     .field("rle_pairs", s.rle_pairs)
+     .field("symbols", s.symbols)
+     .field("used_symbols", s.used_symbols)
+     .field("max_code_len", s.max_code_len)
+     .field("table_bytes", s.table_bytes)
+     .field("payload_bytes", s.payload_bytes)
+     .field("input_bytes", s.input_bytes)
+     .field("layers", s.layers);
+    if (s.mem_tracked) {
+        JsonObject mem;
+        mem.raw("parse", mem_json(s.parse_mem))
+           .raw("huffman", mem_json(s.huffman_mem))
+           .raw("rle", mem_json(s.rle_mem))
+           .raw("zigzag", mem_json(s.zigzag_mem))
+           .raw("dequantize", mem_json(s.dequantize_mem))
+           .raw("idct", mem_json(s.idct_mem))
+           .raw("untile", mem_json(s.untile_mem))
+           .field("peak_live_bytes", s.peak_live_bytes);
+        j.raw("mem", mem.str());
+    }
+    return j.str();
+}
+
+} // namespace mcodec
@@ -1,8 +1,10 @@
 #include "codec/decoder.hpp"
 
+#include "codec/predictive.hpp"
 #include "format/mcodec_format.hpp"
 
 #include "preprocess/level_shift.hpp"
+#include "preprocess/window_level.hpp"
 
 #include "entropy/bitstream.hpp"
 #include "entropy/rle.hpp"
@@ -14,107 +16,550 @@
 #include "transform/dct2d.hpp"
 #include "quant/quantizer.hpp"
 
+#include "util/mem_track.hpp"
+#include "util/trace.hpp"
+
 #include <algorithm>
+#include <cstdint>
 #include <cstring>
 #include <stdexcept>
 #include <vector>
 
 namespace mcodec {
 
-Image decode_from_mcodec(const std::vector<uint8_t>& bytes) {
-    if (bytes.size() < kMCodecHeaderBytes) {
-        throw std::runtime_error("decode: buffer too small for header");
+// Working memory of one DecoderSession; every vector keeps its capacity between frames.
+struct DecoderSession::Buffers {
+    std::vector<std::pair<uint32_t, uint8_t>> entries;
+    std::vector<uint32_t> symbols;
+    std::vector<RlePair> rle;
+    std::vector<LayerEntry> layers;
+    std::vector<int16_t> seq;
+    std::vector<int32_t> flat;     // kFlagSkipBlocks: sample value of each skipped block
+    std::vector<int16_t> residual;
+    std::vector<int16_t> qcoeff;
+    std::vector<float> coeffs;
+    std::vector<int32_t> blocks;
+    HuffmanDecoder huff;
+    // kFlagTableRef streams: the series table file, and which of its tables `huff` holds
+    // (consecutive slices sharing a table skip the rebuild)
+    SeriesTables series;
+    size_t built_table = SIZE_MAX;
+    // decode_display: window LUT of the last call, and the samples of predictive streams
+    std::vector<uint8_t> lut;
+    int lut_bits = 0;
+    bool lut_signed = false;
+    DisplayWindow lut_window;
+    Image samples;
+};
+
+namespace {
+
+// Code of a kFlagTableRef table section (after symbol_count): the referenced series table.
+const std::vector<std::pair<uint32_t, uint8_t>>& referenced_table(ByteReader& r, DecoderSession::Buffers& buf) {
+    const uint32_t table_id = r.read_u32_le();
+    const uint32_t table_hash = r.read_u32_le();
+    if (buf.series.tables.empty()) {
+        throw std::runtime_error("decode: stream uses a series table file (.mtab), none given");
     }
-    MCodecHeader hdr = read_bitstream_header(bytes);
-    if (bytes.size() < hdr.header_bytes + hdr.payload_bytes) {
-        throw std::runtime_error("decode: buffer smaller than declared payload_bytes");
+    if (table_id >= buf.series.tables.size()) throw std::runtime_error("decode: series table id out of range");
+    const auto& table = buf.series.tables[table_id];
+    if (series_table_hash(table) != table_hash) {
+        throw std::runtime_error("decode: series table does not match the stream (wrong .mtab?)");
     }
+    return table;
+}
 
-    const size_t payload_start = hdr.header_bytes;
-    const size_t payload_end = hdr.header_bytes + hdr.payload_bytes;
-    ByteReader r(std::vector<uint8_t>(bytes.begin() + payload_start, bytes.begin() + payload_end));
+// One layer (table section + Huffman payload at `data`) through Huffman and RLE into `seq`;
+// with `flat`, skip pairs are accepted and their blocks' sample values go there.
+// Stage times and counters accumulate over layers.
+void decode_layer(const uint8_t* data,
+                  size_t size,
+                  bool table_ref,
+                  int block_size,
+                  size_t total_coeffs,
+                  DecodeStats* stats,
+                  DecoderSession::Buffers& buf,
+                  StageClock& clock,
+                  std::vector<int16_t>& seq,
+                  std::vector<int32_t>* flat) {
+    MemScope parse_mem(MemTag::Parse); // table section; stages below re-tag
+    ByteReader r(data, size);
 
     // Huffman table section
     uint32_t symbol_count = r.read_u32_le();
-    uint32_t used_symbol_count = r.read_u32_le();
-    if (used_symbol_count == 0) {
-        throw std::runtime_error("decode: used_symbol_count is zero");
-    }
-    if (r.remaining() < static_cast<size_t>(used_symbol_count) * (4u + 1u)) {
-        throw std::runtime_error("decode: table section truncated");
-    }
-    std::vector<std::pair<uint32_t, uint8_t>> entries;
-    entries.reserve(used_symbol_count);
-    for (uint32_t i = 0; i < used_symbol_count; ++i) {
-        uint32_t sym = r.read_u32_le();
-        uint8_t len = r.read_u8();
-        if (len == 0 || len > 32) {
-            throw std::runtime_error("decode: invalid code length in table section");
+    const std::vector<std::pair<uint32_t, uint8_t>>* table = &buf.entries;
+    size_t table_id = SIZE_MAX;
+    if (table_ref) {
+        table = &referenced_table(r, buf);
+        table_id = static_cast<size_t>(table - buf.series.tables.data());
+    } else {
+        uint32_t used_symbol_count = r.read_u32_le();
+        if (used_symbol_count == 0) {
+            throw std::runtime_error("decode: used_symbol_count is zero");
+        }
+        if (r.remaining() < static_cast<size_t>(used_symbol_count) * (4u + 1u)) {
+            throw std::runtime_error("decode: table section truncated");
+        }
+        std::vector<std::pair<uint32_t, uint8_t>>& entries = buf.entries;
+        entries.clear();
+        entries.reserve(used_symbol_count);
+        for (uint32_t i = 0; i < used_symbol_count; ++i) {
+            uint32_t sym = r.read_u32_le();
+            uint8_t len = r.read_u8();
+            if (len == 0 || len > 32) {
+                throw std::runtime_error("decode: invalid code length in table section");
+            }
+            entries.push_back({sym, len});
         }
-        entries.push_back({sym, len});
     }
+    const std::vector<std::pair<uint32_t, uint8_t>>& entries = *table;
+    const uint32_t used_symbol_count = static_cast<uint32_t>(entries.size());
+    if (stats) stats->parse_ms += clock.lap_ms();
 
-    // Remaining are Huffman payload bits
-    std::vector<uint8_t> huff_bits(r.remaining());
-    if (!huff_bits.empty()) {
-        r.read_bytes(huff_bits.data(), huff_bits.size());
+    // Remaining are Huffman payload bits (decoded in place)
+    const uint8_t* huff_bits = data + r.position();
+    const size_t huff_bits_size = r.remaining();
+    // Every block starts with a DC (or skip) symbol and every code is at least one bit long; checked
+    // before any buffer is sized from the header's dimensions.
+    const size_t blocks = total_coeffs / static_cast<size_t>(block_size * block_size);
+    if (symbol_count < blocks || symbol_count / 8u > huff_bits_size) {
+        throw std::runtime_error("decode: symbol count inconsistent with image size or payload");
     }
 
     // Rebuild Huffman table and decode symbols
-    HuffTable table = build_table_from_code_lengths(entries);
-    std::vector<uint32_t> symbols;
-    symbols.reserve(symbol_count);
-    huff_decode(huff_bits, table, symbol_count, symbols);
+    std::vector<uint32_t>& symbols = buf.symbols;
+    {
+        MCODEC_TRACE_SCOPE("dec.huffman");
+        MemScope mem(MemTag::Huffman);
+        if (table_id == SIZE_MAX || table_id != buf.built_table) buf.huff.build(entries);
+        buf.built_table = table_id;
+        buf.huff.decode(huff_bits, huff_bits_size, symbol_count, symbols, table_ref);
+    }
+    if (stats) stats->huffman_ms += clock.lap_ms();
 
     // Unpack RLE pairs
-    std::vector<RlePair> rle;
-    unpack_rle_symbols(symbols, rle);
+    std::vector<RlePair>& rle = buf.rle;
+    {
+        MCODEC_TRACE_SCOPE("dec.rle");
+        MemScope mem(MemTag::Rle);
+        unpack_rle_symbols(symbols, rle);
+        if (flat) {
+            rle_decode_zeros(rle, block_size, total_coeffs, seq, *flat);
+        } else {
+            rle_decode_zeros(rle, block_size, total_coeffs, seq);
+        }
+    }
+    if (stats) {
+        stats->rle_ms += clock.lap_ms();
+        stats->rle_pairs += rle.size();
+        stats->symbols += symbol_count;
+        stats->used_symbols += used_symbol_count;
+        uint8_t max_len = 0;
+        for (const auto& e : entries) max_len = std::max(max_len, e.second);
+        stats->max_code_len = std::max<uint32_t>(stats->max_code_len, max_len);
+        stats->table_bytes += table_ref ? 4u + 4u + 4u : 4u + 4u + static_cast<uint64_t>(used_symbol_count) * (4u + 1u);
+        stats->payload_bytes += huff_bits_size;
+        clock.lap_ms(); // counting is not part of a stage
+    }
+}
+
+// Entropy side: header, layer index, then each layer's table section, Huffman and RLE,
+// into buf.seq (quantized coefficients in zigzag order) and buf.flat. Decodes at most `max_layers`
+// layers (all when <= 0); a layered stream cut after any complete layer decodes up to
+// that layer. The returned header carries the quality of the last decoded layer.
+// Fills the stage times up to rle_ms and the counters.
+MCodecHeader decode_scan(const std::vector<uint8_t>& bytes,
+                           DecodeStats* stats,
+                           DecoderSession::Buffers& buf,
+                           StageClock& clock,
+                           BlockGrid& grid,
+                           int max_layers) {
+    if (bytes.size() < kMCodecHeaderBytes) {
+        throw std::runtime_error("decode: buffer too small for header");
+    }
+    MCodecHeader hdr = read_bitstream_header(bytes);
+    if ((hdr.flags & kFlagPredictive) != 0) {
+        throw std::runtime_error("decode: predictive stream has no DCT coefficient scan");
+    }
+    std::vector<LayerEntry>& layers = buf.layers;
+    read_layer_index(bytes, hdr, layers);
+    const size_t payload_start = hdr.header_bytes;
+    size_t n = layers.size();
+    if ((hdr.flags & kFlagLayered) != 0) {
+        const size_t avail = bytes.size() - payload_start;
+        while (n > 0 && layers[n - 1].end > avail) --n;
+        if (n == 0) throw std::runtime_error("decode: base layer truncated");
+    } else if (bytes.size() < hdr.header_bytes + hdr.payload_bytes) {
+        throw std::runtime_error("decode: buffer smaller than declared payload_bytes");
+    }
+    if (max_layers > 0) n = std::min(n, static_cast<size_t>(max_layers));
 
-    // Recompute grid
     const int block_size = static_cast<int>(hdr.block_size);
-    BlockGrid grid = make_grid(static_cast<int>(hdr.width), static_cast<int>(hdr.height), block_size);
+    grid = make_grid(static_cast<int>(hdr.width), static_cast<int>(hdr.height), block_size);
     const size_t coeffs_per_block = static_cast<size_t>(block_size * block_size);
     const size_t total_coeffs = static_cast<size_t>(grid.blocks_x * grid.blocks_y) * coeffs_per_block;
 
-    std::vector<int16_t> seq;
-    rle_decode_zeros(rle, block_size, total_coeffs, seq);
+    const bool table_ref = (hdr.flags & kFlagTableRef) != 0;
+    std::vector<int16_t>& seq = buf.seq;
+    buf.flat.clear();
+    for (size_t k = 0; k < n; ++k) {
+        const uint8_t* data = bytes.data() + payload_start + layers[k].begin;
+        const size_t size = layers[k].end - layers[k].begin;
+        if (k == 0) {
+            std::vector<int32_t>* flat = (hdr.flags & kFlagSkipBlocks) != 0 ? &buf.flat : nullptr;
+            decode_layer(data, size, table_ref, block_size, total_coeffs, stats, buf, clock, seq, flat);
+            continue;
+        }
+        // Refinement: previous scan at this layer's step plus the coded residual
+        std::vector<int16_t>& residual = buf.residual;
+        decode_layer(data, size, table_ref, block_size, total_coeffs, stats, buf, clock, residual, nullptr);
+        requantize(seq, layers[k - 1].quality, layers[k].quality);
+        for (size_t i = 0; i < seq.size(); ++i) {
+            const int32_t v = static_cast<int32_t>(seq[i]) + residual[i];
+            if (v < INT16_MIN || v > INT16_MAX) throw std::runtime_error("decode: layer refinement out of int16 range");
+            seq[i] = static_cast<int16_t>(v);
+        }
+        if (stats) stats->rle_ms += clock.lap_ms(); // merge counted with the RLE stage
+    }
+    hdr.quality = layers[n - 1].quality;
+
+    if (stats) {
+        stats->blocks = static_cast<uint64_t>(grid.blocks_x) * static_cast<uint64_t>(grid.blocks_y);
+        stats->skipped_blocks = static_cast<uint64_t>(
+            std::count_if(buf.flat.begin(), buf.flat.end(), [](int32_t v) { return v != kNotFlat; }));
+        stats->nonzero_coeffs = static_cast<uint64_t>(
+            seq.size() - static_cast<size_t>(std::count(seq.begin(), seq.end(), int16_t{0})));
+        stats->layers = static_cast<uint32_t>(n);
+        stats->input_bytes = bytes.size();
+        clock.lap_ms(); // counting is not part of a stage
+    }
+    return hdr;
+}
+
+// Scan, inverse zigzag and dequantize: the DCT coefficients of every block in buf.coeffs.
+MCodecHeader decode_coeffs(const std::vector<uint8_t>& bytes, int max_layers, DecodeStats* stats,
+                           DecoderSession::Buffers& buf, StageClock& clock, BlockGrid& grid) {
+    const MCodecHeader hdr = decode_scan(bytes, stats, buf, clock, grid, max_layers);
+    const int block_size = grid.block_size;
 
     // Inverse zigzag -> qcoeff
-    std::vector<int16_t> qcoeff;
-    inverse_zigzag_blocks(seq, block_size, qcoeff);
+    std::vector<int16_t>& qcoeff = buf.qcoeff;
+    {
+        MCODEC_TRACE_SCOPE("dec.zigzag");
+        MemScope mem(MemTag::Zigzag);
+        inverse_zigzag_blocks(buf.seq, block_size, qcoeff);
+    }
+    if (stats) stats->zigzag_ms = clock.lap_ms();
 
     // Dequantize
-    std::vector<float> coeffs;
-    dequantize(qcoeff, block_size, static_cast<int>(hdr.quality), coeffs);
+    std::vector<float>& coeffs = buf.coeffs;
+    {
+        MCODEC_TRACE_SCOPE("dec.dequantize");
+        MemScope mem(MemTag::Dequantize);
+        dequantize(qcoeff, block_size, static_cast<int>(hdr.quality), coeffs);
+    }
+    if (stats) stats->dequantize_ms = clock.lap_ms();
+    return hdr;
+}
+
+// IDCT of every block, except that a skipped block is filled with its sample value.
+void idct_coded_blocks(const std::vector<float>& coeffs, const std::vector<int32_t>& flat, int block_size,
+                       std::vector<int32_t>& blocks) {
+    if (flat.empty()) {
+        idct2d_blocks(coeffs, block_size, blocks);
+        return;
+    }
+    const size_t block_elems = static_cast<size_t>(block_size * block_size);
+    blocks.resize(coeffs.size());
+    for (size_t b = 0; b < flat.size(); ++b) {
+        int32_t* dst = blocks.data() + b * block_elems;
+        if (flat[b] != kNotFlat) {
+            std::fill(dst, dst + block_elems, flat[b]);
+        } else {
+            idct2d_block(coeffs.data() + b * block_elems, block_size, dst);
+        }
+    }
+}
+
+void decode_impl(const std::vector<uint8_t>& bytes, int max_layers, DecodeStats* stats,
+                 DecoderSession::Buffers& buf, Image& im) {
+    MCODEC_TRACE_SCOPE("decode");
+    const MemWindow mem_window;
+    StageClock clock;
+    if ((read_bitstream_header(bytes).flags & kFlagPredictive) != 0) {
+        // Lossless predictive engine: no blocks, the payload decodes straight to samples
+        const MCodecHeader hdr = read_bitstream_header(bytes);
+        if (bytes.size() - hdr.header_bytes < hdr.payload_bytes) {
+            throw std::runtime_error("decode: buffer smaller than declared payload_bytes");
+        }
+        decode_predictive_payload(hdr, bytes.data() + hdr.header_bytes, hdr.payload_bytes, im);
+        if (stats) {
+            stats->total_ms = clock.total_ms();
+            stats->payload_bytes = hdr.payload_bytes;
+            stats->input_bytes = bytes.size();
+            stats->layers = 1;
+            stats->mem_tracked = mem_tracking_active();
+            stats->peak_live_bytes = mem_window.peak_live_bytes();
+        }
+        return;
+    }
+    BlockGrid grid;
+    const MCodecHeader hdr = decode_coeffs(bytes, max_layers, stats, buf, clock, grid);
 
     // IDCT
-    std::vector<int32_t> blocks;
-    idct2d_blocks(coeffs, block_size, blocks);
+    std::vector<int32_t>& blocks = buf.blocks;
+    {
+        MCODEC_TRACE_SCOPE("dec.idct2d");
+        MemScope mem(MemTag::Idct);
+        idct_coded_blocks(buf.coeffs, buf.flat, grid.block_size, blocks);
+    }
+    if (stats) stats->idct_ms = clock.lap_ms();
 
     // Untile
-    Image im;
     im.width = static_cast<int>(hdr.width);
     im.height = static_cast<int>(hdr.height);
     im.channels = static_cast<int>(hdr.channels);
     im.bits_allocated = static_cast<int>(hdr.bits_allocated);
     im.bits_stored = static_cast<int>(hdr.bits_stored);
     im.is_signed = (hdr.is_signed != 0);
-    const bool level_shift_applied = (hdr.flags & 0x01u) != 0;
+    const bool level_shift_applied = (hdr.flags & kFlagLevelShift) != 0;
     im.type = im.is_signed ? PixelType::S16 : (im.bits_allocated <= 8 ? PixelType::U8 : PixelType::U16);
 
-    untile_from_blocks(im, grid, blocks);
+    {
+        MCODEC_TRACE_SCOPE("dec.untile");
+        MemScope mem(MemTag::Untile);
+        untile_from_blocks(im, grid, blocks);
 
-    // Inverse level shift and clip
-    if (level_shift_applied) {
-        inverse_level_shift(im);
+        // Inverse level shift and clip
+        if (level_shift_applied) {
+            inverse_level_shift(im);
+        }
     }
 
     if (static_cast<int>(im.pixels.size()) != im.width * im.height * im.channels) {
         throw std::runtime_error("decode: decoded pixel count mismatch");
     }
+
+    if (stats) {
+        stats->untile_ms = clock.lap_ms();
+        stats->total_ms = clock.total_ms();
+        stats->mem_tracked = mem_tracking_active();
+        stats->parse_mem = mem_window.usage(MemTag::Parse);
+        stats->huffman_mem = mem_window.usage(MemTag::Huffman);
+        stats->rle_mem = mem_window.usage(MemTag::Rle);
+        stats->zigzag_mem = mem_window.usage(MemTag::Zigzag);
+        stats->dequantize_mem = mem_window.usage(MemTag::Dequantize);
+        stats->idct_mem = mem_window.usage(MemTag::Idct);
+        stats->untile_mem = mem_window.usage(MemTag::Untile);
+        stats->peak_live_bytes = mem_window.peak_live_bytes();
+    }
+}
+
+// Window LUT for the stream's sample format, rebuilt only when format or window change.
+const std::vector<uint8_t>& session_lut(DecoderSession::Buffers& buf, int bits_stored, bool is_signed,
+                                        const DisplayWindow& window) {
+    if (buf.lut.empty() || buf.lut_bits != bits_stored || buf.lut_signed != is_signed ||
+        buf.lut_window.center != window.center || buf.lut_window.width != window.width) {
+        make_window_lut(bits_stored, is_signed, window, buf.lut);
+        buf.lut_bits = bits_stored;
+        buf.lut_signed = is_signed;
+        buf.lut_window = window;
+    }
+    return buf.lut;
+}
+
+// Display decode: each block's IDCT output (a skipped block's sample value) goes straight through crop, inverse level
+// shift, clamp and the window LUT into 8-bit pixels; neither the padded int32 raster nor
+// the int32 image is built. Predictive streams have no IDCT stage and are windowed from
+// their decoded samples.
+void decode_display_impl(const std::vector<uint8_t>& bytes, const DisplayWindow& window,
+                         DecoderSession::Buffers& buf, DisplayImage& out) {
+    MCODEC_TRACE_SCOPE("decode.display");
+    const MCodecHeader head = read_bitstream_header(bytes);
+    if ((head.flags & kFlagPredictive) != 0) {
+        decode_impl(bytes, 0, nullptr, buf, buf.samples);
+        apply_window(buf.samples, session_lut(buf, buf.samples.bits_stored, buf.samples.is_signed, window), out);
+        return;
+    }
+    if (head.channels != 1) throw std::runtime_error("decode: only grayscale is supported");
+    StageClock clock;
+    BlockGrid grid;
+    const MCodecHeader hdr = decode_coeffs(bytes, 0, nullptr, buf, clock, grid);
+    const int bits_stored = static_cast<int>(hdr.bits_stored);
+    // The header describes level-shifted samples as signed; decode_impl's output is unsigned
+    const bool level_shift_applied = (hdr.flags & kFlagLevelShift) != 0;
+    const bool is_signed = (hdr.is_signed != 0) && !level_shift_applied;
+    const std::vector<uint8_t>& lut = session_lut(buf, bits_stored, is_signed, window);
+
+    MCODEC_TRACE_SCOPE("dec.idct_display");
+    MemScope mem(MemTag::Idct);
+    // LUT index = sample as unsigned value: undo the level shift, or offset signed samples
+    const int32_t base = (level_shift_applied || is_signed) ? (int32_t{1} << (bits_stored - 1)) : 0;
+    const int32_t maxv = (int32_t{1} << bits_stored) - 1;
+    const int w = static_cast<int>(hdr.width);
+    const int h = static_cast<int>(hdr.height);
+    out.width = w;
+    out.height = h;
+    out.pixels.resize(static_cast<size_t>(w) * static_cast<size_t>(h));
+
+    // A block is block_size^2 consecutive samples of the padded raster; map each row
+    // segment of it that falls inside the image.
+    const int block_elems = grid.block_size * grid.block_size;
+    const size_t blocks = buf.coeffs.size() / static_cast<size_t>(block_elems);
+    int32_t samples[16 * 16];
+    for (size_t b = 0; b < blocks; ++b) {
+        if (!buf.flat.empty() && buf.flat[b] != kNotFlat) {
+            std::fill(samples, samples + block_elems, buf.flat[b]);
+        } else {
+            idct2d_block(buf.coeffs.data() + b * static_cast<size_t>(block_elems), grid.block_size, samples);
+        }
+        size_t pos = b * static_cast<size_t>(block_elems);
+        for (int i = 0; i < block_elems;) {
+            const int y = static_cast<int>(pos / static_cast<size_t>(grid.padded_w));
+            const int x = static_cast<int>(pos % static_cast<size_t>(grid.padded_w));
+            const int n = std::min(block_elems - i, grid.padded_w - x);
+            if (y < h && x < w) {
+                const int m = std::min(n, w - x);
+                uint8_t* dst = out.pixels.data() + static_cast<size_t>(y) * static_cast<size_t>(w) + static_cast<size_t>(x);
+                for (int k = 0; k < m; ++k) {
+                    dst[k] = lut[static_cast<size_t>(std::min(std::max(samples[i + k] + base, 0), maxv))];
+                }
+            }
+            i += n;
+            pos += static_cast<size_t>(n);
+        }
+    }
+}
+
+} // namespace
+
+DecoderSession::DecoderSession() : buf_(std::make_unique<Buffers>()) {}
+DecoderSession::~DecoderSession() = default;
+DecoderSession::DecoderSession(DecoderSession&&) noexcept = default;
+DecoderSession& DecoderSession::operator=(DecoderSession&&) noexcept = default;
+
+void DecoderSession::decode(const std::vector<uint8_t>& bytes, Image& out) {
+    decode_impl(bytes, 0, nullptr, *buf_, out);
+}
+
+void DecoderSession::decode(const std::vector<uint8_t>& bytes, Image& out, DecodeStats& stats) {
+    stats = DecodeStats{};
+    decode_impl(bytes, 0, &stats, *buf_, out);
+}
+
+void DecoderSession::decode_display(const std::vector<uint8_t>& bytes, const DisplayWindow& window, DisplayImage& out) {
+    decode_display_impl(bytes, window, *buf_, out);
+}
+
+void DecoderSession::set_series_tables(SeriesTables tables) {
+    buf_->series = std::move(tables);
+    buf_->built_table = SIZE_MAX;
+}
+
+DisplayImage decode_display_from_mcodec(const std::vector<uint8_t>& bytes, const DisplayWindow& window) {
+    DecoderSession::Buffers buf;
+    DisplayImage out;
+    decode_display_impl(bytes, window, buf, out);
+    return out;
+}
+
+void DecoderSession::decode_quantized_scan(const std::vector<uint8_t>& bytes, QuantizedScan& s) {
+    MCODEC_TRACE_SCOPE("decode.scan");
+    StageClock clock;
+    // decode straight into s's vectors: the session's own are swapped out for the call
+    std::swap(s.scan, buf_->seq);
+    std::swap(s.flat, buf_->flat);
+    const MCodecHeader hdr = decode_scan(bytes, nullptr, *buf_, clock, s.grid, 0);
+    std::swap(s.scan, buf_->seq);
+    std::swap(s.flat, buf_->flat);
+    s.meta.width = static_cast<int>(hdr.width);
+    s.meta.height = static_cast<int>(hdr.height);
+    s.meta.channels = static_cast<int>(hdr.channels);
+    s.meta.bits_allocated = static_cast<int>(hdr.bits_allocated);
+    s.meta.bits_stored = static_cast<int>(hdr.bits_stored);
+    s.meta.is_signed = (hdr.is_signed != 0);
+    s.meta.type = s.meta.bits_allocated <= 8 ? PixelType::U8 : PixelType::U16;
+    s.level_shift_applied = (hdr.flags & kFlagLevelShift) != 0;
+    s.quality = static_cast<int>(hdr.quality);
+}
+
+QuantizedScan decode_quantized_scan(const std::vector<uint8_t>& bytes) {
+    QuantizedScan s;
+    DecoderSession().decode_quantized_scan(bytes, s);
+    return s;
+}
+
+Image decode_from_mcodec(const std::vector<uint8_t>& bytes) {
+    Image im;
+    DecoderSession().decode(bytes, im);
     return im;
 }
 
+Image decode_from_mcodec(const std::vector<uint8_t>& bytes, DecodeStats& stats) {
+    Image im;
+    DecoderSession().decode(bytes, im, stats);
+    return im;
+}
+
+Image decode_from_mcodec(const std::vector<uint8_t>& bytes, const SeriesTables& tables) {
+    DecoderSession session;
+    session.set_series_tables(tables);
+    Image im;
+    session.decode(bytes, im);
+    return im;
+}
+
+Image decode_from_mcodec(const std::vector<uint8_t>& bytes, int max_layers) {
+    DecoderSession::Buffers buf;
+    Image im;
+    decode_impl(bytes, max_layers, nullptr, buf, im);
+    return im;
+}
+
+std::vector<LayerInfo> mcodec_layers(const std::vector<uint8_t>& bytes) {
+    const MCodecHeader hdr = read_bitstream_header(bytes);
+    std::vector<LayerEntry> entries;
+    read_layer_index(bytes, hdr, entries);
+    std::vector<LayerInfo> out;
+    out.reserve(entries.size());
+    for (const LayerEntry& e : entries) {
+        out.push_back({static_cast<int>(e.quality),
+                       static_cast<size_t>(hdr.header_bytes) + e.begin,
+                       static_cast<size_t>(hdr.header_bytes) + e.end});
+    }
+    return out;
+}
+
+std::vector<uint8_t> truncate_layers(const std::vector<uint8_t>& bytes, int layers) {
+    const MCodecHeader hdr = read_bitstream_header(bytes);
+    std::vector<LayerEntry> entries;
+    read_layer_index(bytes, hdr, entries);
+    if (layers < 1) throw std::runtime_error("truncate_layers: need at least one layer");
+    if ((hdr.flags & kFlagLayered) == 0 || static_cast<size_t>(layers) >= entries.size()) {
+        return bytes;
+    }
+    const LayerEntry& last = entries[static_cast<size_t>(layers) - 1];
+    if (bytes.size() < hdr.header_bytes + static_cast<size_t>(last.end)) {
+        throw std::runtime_error("truncate_layers: stream is shorter than the kept layers");
+    }
+    // Same fixed header with a shorter index, then the payload prefix
+    const uint16_t header_bytes = static_cast<uint16_t>(kMCodecHeaderBytes + 4u + 8u * layers);
+    std::vector<uint8_t> out;
+    out.reserve(header_bytes + static_cast<size_t>(last.end));
+    out.insert(out.end(), bytes.begin(), bytes.begin() + header_bytes);
+    out.insert(out.end(), bytes.begin() + hdr.header_bytes, bytes.begin() + hdr.header_bytes + last.end);
+    const auto put_u16 = [&](size_t off, uint16_t v) {
+        out[off] = static_cast<uint8_t>(v & 0xFF);
+        out[off + 1] = static_cast<uint8_t>(v >> 8);
+    };
+    put_u16(6, header_bytes);
+    put_u16(26, last.quality);
+    put_u16(kMCodecHeaderBytes, static_cast<uint16_t>(layers));
+    put_u16(28, static_cast<uint16_t>(last.end & 0xFFFF));
+    put_u16(30, static_cast<uint16_t>(last.end >> 16));
+    return out;
+}
+
 } // namespace mcodec
 
 
@@ -12,226 +12,617 @@
 #include "transform/dct2d.hpp"
 #include "quant/quantizer.hpp"
 
-#include <stdexcept>
+#include "util/mem_track.hpp"
+#include "util/trace.hpp"
 
-#include <iostream>
 #include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
 
 namespace mcodec {
 
-std::vector<uint8_t> encode_to_mcodec(const Image& im, int quality) {
-    Image img = im; // make a mutable working copy
-    if (img.channels != 1) throw std::runtime_error("encode: only grayscale is supported");
-    if (img.width <= 0 || img.height <= 0) throw std::runtime_error("encode: invalid image size");
-    if (static_cast<int>(img.pixels.size()) != img.width * img.height) throw std::runtime_error("encode: buffer size mismatch");
-
-    int block_size = 8;
-    const bool level_shift_applied = !img.is_signed;
-    //===Preprocess image===//
-#ifndef NDEBUG
-    std::cerr << "B(stored)=" << img.bits_stored
-              << " allocated=" << img.bits_allocated
-              << " is_signed=" << img.is_signed << "\n";
-#endif
-
-    // Debug: print 8x8 pixels before and after level shift
-    apply_level_shift(img);
-#ifndef NDEBUG
-    if (!img.empty()) {
-        const int N = block_size;
-        std::fprintf(stderr, "First block of pixels AFTER level shift (%dx%d):\n", N, N);
-        for (int v = 0; v < N; ++v) {
-            for (int u = 0; u < N; ++u) {
-                std::fprintf(stderr, "%5d ", img.pixels[v * N + u]);
-            }
-            std::fprintf(stderr, "\n");
-        }
-    }
-#endif
-    //===Tiling image===//
-    BlockGrid grid = make_grid(img.width, img.height, block_size);
-    std::vector<int32_t> blocks = tile_to_blocks(img, grid);
-    
-    //===Decorrelate===//
+// Working memory of one EncoderSession; every vector keeps its capacity between frames.
+struct EncoderSession::Buffers {
+    std::vector<int32_t> blocks;
+    std::vector<int32_t> flat;   // uniform tiles (find_flat_blocks), coded as skip blocks
     std::vector<float> coeffs;
-    dct2d_blocks(blocks, block_size, coeffs);
-
-    // Debug: print first coefficient block
-#ifndef NDEBUG
-    if (!coeffs.empty()) {
-        const int N = block_size;
-        std::fprintf(stderr, "First DCT coefficient block (%dx%d):\n", N, N);
-        for (int v = 0; v < N; ++v) {
-            for (int u = 0; u < N; ++u) {
-                std::fprintf(stderr, "%8.2f ", coeffs[v * N + u]);
-            }
-            std::fprintf(stderr, "\n");
-        }
-    }
-#endif
-    //===Quantizer===//
     std::vector<int16_t> qcoeff;
-#ifndef NDEBUG
-    std::fprintf(stderr, "Quantizing with quality %d\n", quality);
-#endif
-    quantize(coeffs, block_size, quality, qcoeff);
+    std::vector<int16_t> zigzag_seq;
+    std::vector<RlePair> rle;
+    std::vector<uint32_t> symbols;
+    HuffmanEncoder huff;
+    // Series coding: set by SeriesEncoder, which then picks the table of each scan.
+    SeriesEncoder::State* series = nullptr;
+    int64_t table_ref = -1;      // series table coding the last scan, -1: own table section
+    uint32_t table_hash = 0;
+};
 
-    // Debug: print first quantized coefficients
-#ifndef NDEBUG
-    if (!qcoeff.empty()) {
-        const int N = block_size;
-        std::fprintf(stderr, "First block of quantized coefficients (%dx%d):\n", N, N);
-        for (int v = 0; v < N; ++v) {
-            for (int u = 0; u < N; ++u) {
-                std::fprintf(stderr, "%6d ", static_cast<int>(qcoeff[ v * N + u]));
-            }
-            std::fprintf(stderr, "\n");
-        }
-    }
-#endif
+// Running table of a SeriesEncoder: tables written so far (the last one is reused while
+// it codes the slices well enough) and decayed symbol counts of the recent slices.
+struct SeriesEncoder::State {
+    int quality = 50;
+    double max_penalty = 0.0;
+    EncoderSession::Buffers buf;
+    SeriesTables tables;
+    uint32_t running_hash = 0;
+    double running_redundancy = 0.0; // (bits - bound) / bound of the slice that added it
+    double running_penalty = 0.0;    // penalty bits of the slices that reused it
+    std::vector<std::pair<uint32_t, uint32_t>> counts;  // by symbol
+    std::vector<std::pair<uint32_t, uint32_t>> slice;   // scratch
+    std::vector<std::pair<uint32_t, uint32_t>> merged;  // scratch
+    HuffmanEncoder table_coder;
+    size_t slices = 0;
+    size_t reused = 0;
+
+    void choose_table(const std::vector<uint32_t>& symbols, EncoderSession::Buffers& b);
+    void update_counts();
+};
 
-    //===Scan===//
-    std::vector<int16_t> zigzag_seq;
-    zigzag_scan_blocks(qcoeff, block_size, zigzag_seq);
+namespace {
 
-    // Debug: print first block of zigzag sequence
-#ifndef NDEBUG
-    std::fprintf(stderr, "First block of zigzag sequence (%dx%d):\n", block_size, block_size);
-    for (int i = 0; i < block_size * block_size; ++i) {
-        std::fprintf(stderr, "%6d ", static_cast<int>(zigzag_seq[i]));
-    
-        if ((i + 1) % block_size == 0) {
-            std::fprintf(stderr, "\n");
-        }
-    }
-    std::fprintf(stderr, "\n");
-#endif
+using Buffers = EncoderSession::Buffers;
+
+// Header fields of the image being encoded (pixels left empty).
+Image header_of(const Image& im) {
+    Image meta;
+    meta.width = im.width;
+    meta.height = im.height;
+    meta.channels = im.channels;
+    meta.bits_stored = im.bits_stored;
+    meta.bits_allocated = im.bits_allocated;
+    meta.is_signed = im.is_signed;
+    meta.type = im.type;
+    return meta;
+}
 
-    //===Symbolization (RLE)===//
-    std::vector<RlePair> rle;
-    rle_encode_zeros(zigzag_seq, block_size, rle);
+// Per-stage heap usage since `win` was opened (zeros unless the tool links the mem hook).
+void fill_mem(const MemWindow& win, EncodeStats& s) {
+    s.mem_tracked = mem_tracking_active();
+    s.tile_mem = win.usage(MemTag::Tile);
+    s.dct_mem = win.usage(MemTag::Dct);
+    s.quantize_mem = win.usage(MemTag::Quantize);
+    s.zigzag_mem = win.usage(MemTag::Zigzag);
+    s.rle_mem = win.usage(MemTag::Rle);
+    s.huffman_mem = win.usage(MemTag::Huffman);
+    s.bitstream_mem = win.usage(MemTag::Bitstream);
+    s.peak_live_bytes = win.peak_live_bytes();
+}
 
-    // Debug: print first block of RLE pairs
-#ifndef NDEBUG
-    std::fprintf(stderr, "First block of RLE pairs (%dx%d):\n", block_size, block_size);
-    for (int i = 0; i < block_size * block_size; ++i) {
-        std::fprintf(stderr, "%6d %6d ", static_cast<int>(rle[i].value), static_cast<int>(rle[i].run));
-        if ((i + 1) % block_size == 0) {
-            std::fprintf(stderr, "\n");
+void check_image(const Image& im) {
+    if (im.channels != 1) throw std::runtime_error("encode: only grayscale is supported");
+    if (im.width <= 0 || im.height <= 0) throw std::runtime_error("encode: invalid image size");
+    if (static_cast<int>(im.pixels.size()) != im.width * im.height) throw std::runtime_error("encode: buffer size mismatch");
+}
+
+void encode_scan(const Image& meta, const BlockGrid& grid, const std::vector<int16_t>& zigzag_seq,
+                 const std::vector<int32_t>& flat, bool level_shift_applied, int quality, StageClock& clock,
+                 EncodeStats* stats, Buffers& buf, std::vector<uint8_t>& out);
+
+// DCT of the tiles that are not skipped; skipped (uniform) tiles get zero coefficients.
+void dct_coded_blocks(const std::vector<int32_t>& blocks, const std::vector<int32_t>& flat, int block_size,
+                      std::vector<float>& coeffs) {
+    if (flat.empty()) {
+        dct2d_blocks(blocks, block_size, coeffs);
+        return;
+    }
+    const size_t block_elems = static_cast<size_t>(block_size * block_size);
+    coeffs.resize(blocks.size());
+    for (size_t b = 0; b < flat.size(); ++b) {
+        float* dst = coeffs.data() + b * block_elems;
+        if (flat[b] != kNotFlat) {
+            std::fill(dst, dst + block_elems, 0.0f);
         } else {
-            std::fprintf(stderr, ", ");
+            dct2d_block(blocks.data() + b * block_elems, block_size, dst);
         }
     }
-    std::fprintf(stderr, "\n");
-#endif
+}
 
-    //===Entropy Coding===//
-    std::vector<uint32_t> symbols;
-    pack_rle_symbols(rle, symbols);
+// Quality-dependent stages: quantizer -> zigzag -> RLE -> Huffman -> bitstream.
+// `coeffs` are the DCT coefficients of the level-shifted tiles and `flat` the tiles coded
+// as skip blocks; `meta` supplies the header.
+// Scratch comes from `buf`; the .mcodec bytes replace the contents of `out`.
+void encode_coeffs(const Image& meta,
+                   const BlockGrid& grid,
+                   const std::vector<float>& coeffs,
+                   const std::vector<int32_t>& flat,
+                   bool level_shift_applied,
+                   int quality,
+                   StageClock& clock,
+                   EncodeStats* stats,
+                   Buffers& buf,
+                   std::vector<uint8_t>& out) {
+    const int block_size = grid.block_size;
 
-    // Debug: print first block of symbols
-#ifndef NDEBUG
-    std::fprintf(stderr, "First 10 symbols (binary):\n");
-    for (int i = 0; i < 10 && i < static_cast<int>(symbols.size()); ++i) {
-        uint32_t sym = symbols[i];
-        std::fprintf(stderr, "0b");
-        for (int bit = 31; bit >= 0; --bit) {
-            std::fprintf(stderr, "%d", (sym >> bit) & 1);
-        }
-        std::fprintf(stderr, " ");
+    //===Quantizer===//
+    std::vector<int16_t>& qcoeff = buf.qcoeff;
+    {
+        MCODEC_TRACE_SCOPE("enc.quantize");
+        MemScope mem(MemTag::Quantize);
+        quantize(coeffs, block_size, quality, qcoeff);
+    }
+    if (stats) {
+        stats->quantize_ms = clock.lap_ms();
+        stats->nonzero_coeffs = static_cast<uint64_t>(
+            qcoeff.size() - static_cast<size_t>(std::count(qcoeff.begin(), qcoeff.end(), int16_t{0})));
+        clock.lap_ms(); // counting is not part of a stage
     }
-    std::fprintf(stderr, "\n");
-#endif
-
-    auto encoded = huff_encode(symbols);
-    HuffTable table = std::move(encoded.first);
-    std::vector<uint8_t> huff_encode_bits = std::move(encoded.second);
 
-    // Debug: print Huffman table (code lengths)
-#ifndef NDEBUG
-    std::fprintf(stderr, "Huffman table (first 10 used symbols):\n");
-    int count = 0;
-    for (size_t i = 0; i < table.enc.size() && count < 10; ++i) {
-        if (table.enc[i].valid) {
-            std::fprintf(stderr,
-                    "sym=%zu len=%u code=0x%x\n",
-                    i,
-                    table.enc[i].len,
-                    table.enc[i].code);
-            ++count;
-        }
+    //===Scan===//
+    std::vector<int16_t>& zigzag_seq = buf.zigzag_seq;
+    {
+        MCODEC_TRACE_SCOPE("enc.zigzag");
+        MemScope mem(MemTag::Zigzag);
+        zigzag_scan_blocks(qcoeff, block_size, zigzag_seq);
     }
+    if (stats) stats->zigzag_ms = clock.lap_ms();
+    encode_scan(meta, grid, zigzag_seq, flat, level_shift_applied, quality, clock, stats, buf, out);
+}
 
-    // Debug: print first 10 Huffman encoded bits (binary)
-    std::fprintf(stderr, "First 2 Huffman encoded bytes (binary):\n");
-    for (int i = 0; i < 2 && i < static_cast<int>(huff_encode_bits.size()); ++i) {
-        std::fprintf(stderr, "0b");
-        for (int bit = 7; bit >= 0; --bit) {
-            std::fprintf(stderr, "%d", (huff_encode_bits[i] >> bit) & 1);
-        }
-        std::fprintf(stderr, " ");
+// RLE symbols and Huffman code for one scan; the results stay in buf.rle / buf.symbols / buf.huff.
+void model_scan(const std::vector<int16_t>& zigzag_seq, const std::vector<int32_t>& flat, int block_size,
+                StageClock& clock, EncodeStats* stats, Buffers& buf) {
+    //===Symbolization (RLE)===//
+    std::vector<RlePair>& rle = buf.rle;
+    std::vector<uint32_t>& symbols = buf.symbols;
+    {
+        MCODEC_TRACE_SCOPE("enc.rle");
+        MemScope mem(MemTag::Rle);
+        rle_encode_zeros(zigzag_seq, block_size, flat, rle);
+        pack_rle_symbols(rle, symbols);
     }
-    std::fprintf(stderr, "\n");
-#endif
+    if (stats) stats->rle_ms = clock.lap_ms();
 
-    //===Bitstream Writer===//
-    const uint8_t flags = level_shift_applied ? 0x01 : 0x00;
-    const uint32_t symbol_count = static_cast<uint32_t>(symbols.size());
-
-    // Collect used symbols (freq>0) with their code lengths
-    std::vector<std::pair<uint32_t, uint8_t>> table_entries;
-    table_entries.reserve(table.enc.size());
-    for (uint32_t i = 0; i < table.enc.size(); ++i) {
-        if (table.enc[i].valid && table.enc[i].len > 0) {
-            table_entries.push_back({i, table.enc[i].len});
+    //===Entropy Coding===//
+    {
+        MCODEC_TRACE_SCOPE("enc.huffman");
+        MemScope mem(MemTag::Huffman);
+        if (buf.series) {
+            buf.series->choose_table(symbols, buf);
+        } else {
+            buf.huff.build(symbols);
         }
     }
-    // canonical rebuild要求 (len asc, symbol asc)
-    std::sort(table_entries.begin(), table_entries.end(),
-              [](const auto& a, const auto& b) {
-                  if (a.second != b.second) return a.second < b.second;
-                  return a.first < b.first;
-              });
+    if (stats) stats->huffman_ms = clock.lap_ms();
+}
+
+// Huffman table section bytes:
+// 4 bytes for symbol_count, 4 bytes for used_symbol_count, used_symbol_count * (4 bytes for symbol + 1 byte for code length)
+// (series table reference: symbol_count, table_id and table_hash)
+uint32_t table_section_bytes(const Buffers& buf) {
+    if (buf.table_ref >= 0) return 4u + 4u + 4u;
+    return 4u + 4u + static_cast<uint32_t>(buf.huff.code_lengths().size()) * (4u + 1u);
+}
+
+// Table section of the scan modelled last.
+void write_table_section(ByteWriter& w, const Buffers& buf) {
+    // Used symbols with their code lengths, already in canonical rebuild order (len asc, symbol asc)
+    const std::vector<std::pair<uint32_t, uint8_t>>& table_entries = buf.huff.code_lengths();
     if (table_entries.empty()) {
         throw std::runtime_error("encode: no used symbols for Huffman table");
     }
-    const uint32_t used_symbol_count = static_cast<uint32_t>(table_entries.size());
-
-    // Huffman table section bytes: 
-    // 4 bytes for symbol_count, 4 bytes for used_symbol_count, used_symbol_count * (4 bytes for symbol + 1 byte for code length)
-    const uint32_t huff_table_section_bytes = 4u + 4u + used_symbol_count * (4u + 1u); 
-    const uint32_t huff_payload_bytes = static_cast<uint32_t>(huff_encode_bits.size());
-    const uint32_t payload_bytes = huff_table_section_bytes + huff_payload_bytes;
-
-    ByteWriter w;
-    // header (payload_bytes will be patched after table/payload are written)
-    write_bitstream_header(w, img, flags, /*block_size=*/block_size, /*quality=*/quality);
-
-    // Huffman table section
-    w.write_u32_le(symbol_count);
-    w.write_u32_le(used_symbol_count);
+    w.write_u32_le(static_cast<uint32_t>(buf.symbols.size()));
+    if (buf.table_ref >= 0) {
+        w.write_u32_le(static_cast<uint32_t>(buf.table_ref));
+        w.write_u32_le(buf.table_hash);
+        return;
+    }
+    w.write_u32_le(static_cast<uint32_t>(table_entries.size()));
     for (const auto& [sym, len] : table_entries) {
         w.write_u32_le(sym);
         w.write_u8(len);
     }
+}
+
+void patch_u32_le(std::vector<uint8_t>& bytes, size_t off, uint32_t v) {
+    bytes[off] = static_cast<uint8_t>(v & 0xFF);
+    bytes[off + 1] = static_cast<uint8_t>((v >> 8) & 0xFF);
+    bytes[off + 2] = static_cast<uint8_t>((v >> 16) & 0xFF);
+    bytes[off + 3] = static_cast<uint8_t>((v >> 24) & 0xFF);
+}
+
+// Entropy side: RLE -> Huffman -> bitstream for quantized coefficients in zigzag order.
+void encode_scan(const Image& meta,
+                 const BlockGrid& grid,
+                 const std::vector<int16_t>& zigzag_seq,
+                 const std::vector<int32_t>& flat,
+                 bool level_shift_applied,
+                 int quality,
+                 StageClock& clock,
+                 EncodeStats* stats,
+                 Buffers& buf,
+                 std::vector<uint8_t>& out) {
+    const int block_size = grid.block_size;
+    model_scan(zigzag_seq, flat, block_size, clock, stats, buf);
+
+    //===Bitstream Writer===//
+    MCODEC_TRACE_SCOPE("enc.bitstream");
+    MemScope mem(MemTag::Bitstream);
+    const uint8_t flags = static_cast<uint8_t>((level_shift_applied ? kFlagLevelShift : 0x00) |
+                                               (buf.table_ref >= 0 ? kFlagTableRef : 0x00) |
+                                               (flat.empty() ? 0x00 : kFlagSkipBlocks));
+    const std::vector<std::pair<uint32_t, uint8_t>>& table_entries = buf.huff.code_lengths();
+    const uint32_t huff_table_section_bytes = table_section_bytes(buf);
+    const uint32_t huff_payload_bytes = static_cast<uint32_t>(buf.huff.payload_bytes());
+    const uint32_t payload_bytes = huff_table_section_bytes + huff_payload_bytes;
+
+    ByteWriter w(std::move(out));
+    w.reserve(kMCodecHeaderBytes + payload_bytes);
+    // header (payload_bytes will be patched after table/payload are written)
+    write_bitstream_header(w, meta, flags, /*block_size=*/block_size, /*quality=*/quality);
+    write_table_section(w, buf);
 
     // Huffman payload bits
-    w.write_bytes(huff_encode_bits.data(), huff_encode_bits.size());
+    out = w.release();
+    buf.huff.write_payload(out);
+    std::vector<uint8_t>& bytes = out;
 
     // patch payload_bytes (at fixed offset in header)
-    std::vector<uint8_t> bytes = w.bytes();
     if (bytes.size() < kMCodecHeaderBytes) {
         throw std::runtime_error("encode: header size too small when patching payload_bytes");
     }
-    bytes[28] = static_cast<uint8_t>(payload_bytes & 0xFF);
-    bytes[29] = static_cast<uint8_t>((payload_bytes >> 8) & 0xFF);
-    bytes[30] = static_cast<uint8_t>((payload_bytes >> 16) & 0xFF);
-    bytes[31] = static_cast<uint8_t>((payload_bytes >> 24) & 0xFF);
+    patch_u32_le(bytes, 28, payload_bytes);
     const uint32_t expected_size = kMCodecHeaderBytes + payload_bytes;
     if (bytes.size() != expected_size) {
         throw std::runtime_error("encode: buffer size mismatch after patching payload_bytes");
     }
-    return std::move(bytes);
+
+    if (stats) {
+        stats->bitstream_ms = clock.lap_ms();
+        stats->blocks = static_cast<uint64_t>(grid.blocks_x) * static_cast<uint64_t>(grid.blocks_y);
+        stats->skipped_blocks = static_cast<uint64_t>(
+            std::count_if(flat.begin(), flat.end(), [](int32_t v) { return v != kNotFlat; }));
+        stats->rle_pairs = buf.rle.size();
+        stats->symbols = buf.symbols.size();
+        stats->used_symbols = static_cast<uint32_t>(table_entries.size());
+        stats->max_code_len = table_entries.back().second; // sorted by length
+        stats->table_bytes = huff_table_section_bytes;
+        stats->payload_bytes = huff_payload_bytes;
+        stats->output_bytes = bytes.size();
+    }
+}
+
+// Uniform-tile test and DCT of the other tiles, then the quality-dependent stages.
+// `buf.blocks` holds the level-shifted, padded tiles.
+void encode_blocks(const Image& meta,
+                   const BlockGrid& grid,
+                   bool level_shift_applied,
+                   int quality,
+                   StageClock& clock,
+                   EncodeStats* stats,
+                   Buffers& buf,
+                   std::vector<uint8_t>& out) {
+    //===Decorrelate===//
+    {
+        MCODEC_TRACE_SCOPE("enc.dct2d");
+        MemScope mem(MemTag::Dct);
+        find_flat_blocks(buf.blocks, grid.block_size, buf.flat);
+        dct_coded_blocks(buf.blocks, buf.flat, grid.block_size, buf.coeffs);
+    }
+    if (stats) stats->dct_ms = clock.lap_ms();
+    encode_coeffs(meta, grid, buf.coeffs, buf.flat, level_shift_applied, quality, clock, stats, buf, out);
+}
+
+void encode_image(const Image& im, int quality, EncodeStats* stats, Buffers& buf, std::vector<uint8_t>& out) {
+    check_image(im);
+
+    MCODEC_TRACE_SCOPE("encode");
+    const MemWindow mem_window;
+    StageClock clock;
+    const int block_size = 8;
+    const bool level_shift_applied = !im.is_signed;
+
+    //===Preprocess + Tiling (level shift fused into the tile copy)===//
+    const int32_t offset = level_shift_offset(im.bits_stored, im.is_signed);
+    BlockGrid grid = make_grid(im.width, im.height, block_size);
+    {
+        MCODEC_TRACE_SCOPE("enc.tile");
+        MemScope mem(MemTag::Tile);
+        tile_to_blocks(im, grid, offset, buf.blocks);
+    }
+    if (stats) stats->tile_ms = clock.lap_ms();
+
+    Image meta = header_of(im);
+    meta.is_signed = true; // level-shifted domain, as written by apply_level_shift
+    encode_blocks(meta, grid, level_shift_applied, quality, clock, stats, buf, out);
+    if (stats) {
+        stats->total_ms = clock.total_ms();
+        fill_mem(mem_window, *stats);
+    }
+}
+
+// A view comes straight from caller metadata (e.g. DICOM BitsStored / PixelRepresentation);
+// reject fields that disagree with the buffer before the tiler reads it.
+void check_view(const PixelView& src) {
+    if (!src.data) throw std::runtime_error("encode: null pixel buffer");
+    if (src.width <= 0 || src.height <= 0) throw std::runtime_error("encode: invalid image size");
+    if (src.type != PixelType::U8 && src.type != PixelType::U16 && src.type != PixelType::S16) {
+        throw std::runtime_error("encode: unsupported pixel type");
+    }
+    const int sample_bits = (src.type == PixelType::U8) ? 8 : 16;
+    if (src.bits_allocated != sample_bits) throw std::runtime_error("encode: bits_allocated does not match pixel type");
+    if (src.bits_stored < 1 || src.bits_stored > src.bits_allocated) {
+        throw std::runtime_error("encode: bits_stored out of range 1..bits_allocated");
+    }
+    if (src.is_signed != (src.type == PixelType::S16)) {
+        throw std::runtime_error("encode: is_signed does not match pixel type");
+    }
+}
+
+void encode_view(const PixelView& src, int quality, EncodeStats* stats, Buffers& buf, std::vector<uint8_t>& out) {
+    check_view(src);
+
+    MCODEC_TRACE_SCOPE("encode");
+    const MemWindow mem_window;
+    StageClock clock;
+    const int block_size = 8;
+    const bool level_shift_applied = !src.is_signed;
+
+    const int32_t offset = level_shift_offset(src.bits_stored, src.is_signed);
+    BlockGrid grid = make_grid(src.width, src.height, block_size);
+    {
+        MCODEC_TRACE_SCOPE("enc.tile");
+        MemScope mem(MemTag::Tile);
+        tile_to_blocks(src, grid, offset, buf.blocks);
+    }
+    if (stats) stats->tile_ms = clock.lap_ms();
+
+    Image meta;
+    meta.width = src.width;
+    meta.height = src.height;
+    meta.channels = 1;
+    meta.bits_stored = src.bits_stored;
+    meta.bits_allocated = src.bits_allocated;
+    meta.is_signed = true; // level-shifted domain (or natively signed)
+    meta.type = src.type;
+    encode_blocks(meta, grid, level_shift_applied, quality, clock, stats, buf, out);
+    if (stats) {
+        stats->total_ms = clock.total_ms();
+        fill_mem(mem_window, *stats);
+    }
+}
+
+} // namespace
+
+// Half of the older counts plus this slice's: a new table follows the recent slices but keeps
+// codes for symbols seen a few slices back, so it covers the slices that follow.
+void SeriesEncoder::State::update_counts() {
+    std::sort(slice.begin(), slice.end());
+    merged.clear();
+    size_t i = 0;
+    for (const auto& [sym, n] : slice) {
+        for (; i < counts.size() && counts[i].first < sym; ++i) {
+            if (counts[i].second > 1) merged.push_back({counts[i].first, counts[i].second / 2});
+        }
+        const uint32_t old = (i < counts.size() && counts[i].first == sym) ? counts[i++].second / 2 : 0u;
+        merged.push_back({sym, n + old});
+    }
+    for (; i < counts.size(); ++i) {
+        if (counts[i].second > 1) merged.push_back({counts[i].first, counts[i].second / 2});
+    }
+    counts.swap(merged);
+}
+
+// Code the scan with the running table (symbols it has no code for are escaped) if its
+// penalty is at most max_penalty of the scan's size, or if the penalties of the slices that
+// reused the table still add up to less than a new table's bytes. The penalty is the
+// redundancy over the Shannon bound of the scan's own counts, less the table's redundancy
+// on the slice that added it: the bound needs no table build, and measuring against the
+// table's first slice leaves out the redundancy Huffman codes have anyway. Otherwise
+// append a table built from the running counts, which becomes the running table.
+void SeriesEncoder::State::choose_table(const std::vector<uint32_t>& symbols, EncoderSession::Buffers& b) {
+    ++slices;
+    const std::vector<std::pair<uint32_t, uint8_t>> none;
+    const auto& running = tables.tables.empty() ? none : tables.tables.back();
+    const bool coded = b.huff.build_from_table(symbols, running);
+    b.huff.frequencies(slice);
+    if (coded) {
+        const double bound = b.huff.entropy_bits();
+        const double penalty_bits = static_cast<double>(b.huff.payload_bytes()) * 8.0 - bound * (1.0 + running_redundancy);
+        const double table_bits = static_cast<double>(slice.size()) * (4 + 1) * 8;
+        if (penalty_bits <= max_penalty * bound || running_penalty + penalty_bits <= table_bits) {
+            running_penalty += std::max(penalty_bits, 0.0);
+            update_counts();
+            b.table_ref = static_cast<int64_t>(tables.tables.size() - 1);
+            b.table_hash = running_hash;
+            ++reused;
+            return;
+        }
+    }
+    update_counts();
+    table_coder.reset_counts();
+    for (const auto& [sym, n] : counts) table_coder.count(sym, n);
+    // Escape for symbols the following slices bring in, about as frequent as this slice's
+    // symbols seen once (Good-Turing)
+    const size_t singletons = static_cast<size_t>(
+        std::count_if(slice.begin(), slice.end(), [](const auto& e) { return e.second == 1; }));
+    table_coder.count(kHuffEscapeSymbol, static_cast<uint32_t>(std::max<size_t>(singletons, 1)));
+    table_coder.build_lengths();
+    tables.tables.push_back(table_coder.code_lengths());
+    running_hash = series_table_hash(tables.tables.back());
+    if (!b.huff.build_from_table(symbols, tables.tables.back())) {
+        throw std::runtime_error("encode: series table does not cover the slice");
+    }
+    const double bound = b.huff.entropy_bits();
+    running_redundancy = bound > 0.0 ? static_cast<double>(b.huff.payload_bytes()) * 8.0 / bound - 1.0 : 0.0;
+    running_penalty = 0.0;
+    b.table_ref = static_cast<int64_t>(tables.tables.size() - 1);
+    b.table_hash = running_hash;
+}
+
+EncoderSession::EncoderSession() : buf_(std::make_unique<Buffers>()) {}
+EncoderSession::~EncoderSession() = default;
+EncoderSession::EncoderSession(EncoderSession&&) noexcept = default;
+EncoderSession& EncoderSession::operator=(EncoderSession&&) noexcept = default;
+
+void EncoderSession::encode(const Image& im, int quality, std::vector<uint8_t>& out) {
+    encode_image(im, quality, nullptr, *buf_, out);
+}
+
+void EncoderSession::encode(const Image& im, int quality, std::vector<uint8_t>& out, EncodeStats& stats) {
+    stats = EncodeStats{};
+    encode_image(im, quality, &stats, *buf_, out);
+}
+
+void EncoderSession::encode(const PixelView& src, int quality, std::vector<uint8_t>& out) {
+    encode_view(src, quality, nullptr, *buf_, out);
+}
+
+void EncoderSession::encode(const PixelView& src, int quality, std::vector<uint8_t>& out, EncodeStats& stats) {
+    stats = EncodeStats{};
+    encode_view(src, quality, &stats, *buf_, out);
+}
+
+std::vector<uint8_t> encode_to_mcodec(const Image& im, int quality) {
+    std::vector<uint8_t> out;
+    EncoderSession().encode(im, quality, out);
+    return out;
+}
+
+std::vector<uint8_t> encode_to_mcodec(const Image& im, int quality, EncodeStats& stats) {
+    std::vector<uint8_t> out;
+    EncoderSession().encode(im, quality, out, stats);
+    return out;
+}
+
+SeriesEncoder::SeriesEncoder(int quality, double max_penalty) : st_(std::make_unique<State>()) {
+    if (quality < 1 || quality > 100) throw std::runtime_error("encode: quality out of range 1..100");
+    if (!(max_penalty >= 0.0)) throw std::runtime_error("encode: table penalty must be >= 0");
+    st_->quality = quality;
+    st_->max_penalty = max_penalty;
+    st_->buf.series = st_.get();
+}
+SeriesEncoder::~SeriesEncoder() = default;
+
+void SeriesEncoder::encode(const Image& im, std::vector<uint8_t>& out) {
+    encode_image(im, st_->quality, nullptr, st_->buf, out);
+}
+
+void SeriesEncoder::encode(const PixelView& src, std::vector<uint8_t>& out) {
+    encode_view(src, st_->quality, nullptr, st_->buf, out);
+}
+
+const SeriesTables& SeriesEncoder::tables() const { return st_->tables; }
+size_t SeriesEncoder::slices() const { return st_->slices; }
+size_t SeriesEncoder::reused() const { return st_->reused; }
+
+std::vector<uint8_t> encode_to_mcodec(const PixelView& src, int quality) {
+    std::vector<uint8_t> out;
+    EncoderSession().encode(src, quality, out);
+    return out;
+}
+
+std::vector<uint8_t> encode_to_mcodec(const PixelView& src, int quality, EncodeStats& stats) {
+    std::vector<uint8_t> out;
+    EncoderSession().encode(src, quality, out, stats);
+    return out;
+}
+
+EncoderFrontEnd encode_front_end(const Image& im) {
+    check_image(im);
+    MCODEC_TRACE_SCOPE("enc.front_end");
+    const int block_size = 8;
+
+    EncoderFrontEnd fe;
+    fe.meta = header_of(im);
+    fe.meta.is_signed = true; // level-shifted domain, as in encode_image
+    fe.level_shift_applied = !im.is_signed;
+    fe.grid = make_grid(im.width, im.height, block_size);
+    const std::vector<int32_t> blocks =
+        tile_to_blocks(im, fe.grid, level_shift_offset(im.bits_stored, im.is_signed));
+    find_flat_blocks(blocks, block_size, fe.flat);
+    dct_coded_blocks(blocks, fe.flat, block_size, fe.coeffs);
+    return fe;
+}
+
+void EncoderSession::encode(const QuantizedScan& s, std::vector<uint8_t>& out) {
+    if (s.quality < 1 || s.quality > 100) throw std::runtime_error("encode: quality out of range 1..100");
+    const size_t expected = static_cast<size_t>(s.grid.padded_w) * static_cast<size_t>(s.grid.padded_h);
+    if (s.scan.size() != expected) throw std::runtime_error("encode: scan size does not match the grid");
+    if (!s.flat.empty() && s.flat.size() != expected / static_cast<size_t>(s.grid.block_size * s.grid.block_size)) {
+        throw std::runtime_error("encode: skip block list does not match the grid");
+    }
+    MCODEC_TRACE_SCOPE("encode");
+    StageClock clock;
+    encode_scan(s.meta, s.grid, s.scan, s.flat, s.level_shift_applied, s.quality, clock, nullptr, *buf_, out);
+}
+
+std::vector<uint8_t> encode_quantized_scan(const QuantizedScan& s) {
+    std::vector<uint8_t> out;
+    EncoderSession().encode(s, out);
+    return out;
+}
+
+std::vector<uint8_t> encode_from_front_end(const EncoderFrontEnd& fe, int quality) {
+    MCODEC_TRACE_SCOPE("encode");
+    StageClock clock;
+    Buffers buf;
+    std::vector<uint8_t> out;
+    encode_coeffs(fe.meta, fe.grid, fe.coeffs, fe.flat, fe.level_shift_applied, quality, clock, nullptr, buf, out);
+    return out;
+}
+
+std::vector<uint8_t> encode_layered_mcodec(const Image& im, const std::vector<int>& qualities) {
+    if (qualities.empty() || qualities.size() > static_cast<size_t>(kMaxLayers)) {
+        throw std::runtime_error("encode: layer count out of range 1.." + std::to_string(kMaxLayers));
+    }
+    for (size_t k = 0; k < qualities.size(); ++k) {
+        if (qualities[k] < 1 || qualities[k] > 100) throw std::runtime_error("encode: quality out of range 1..100");
+        if (k > 0 && qualities[k] <= qualities[k - 1]) throw std::runtime_error("encode: layer qualities must increase");
+    }
+    MCODEC_TRACE_SCOPE("encode.layered");
+    const EncoderFrontEnd fe = encode_front_end(im);
+    const int block_size = fe.grid.block_size;
+    const uint16_t layer_count = static_cast<uint16_t>(qualities.size());
+    const uint16_t header_bytes = static_cast<uint16_t>(kMCodecHeaderBytes + 4u + 8u * layer_count);
+
+    ByteWriter w;
+    const uint8_t flags = static_cast<uint8_t>((fe.level_shift_applied ? kFlagLevelShift : 0x00) | kFlagLayered |
+                                               (fe.flat.empty() ? 0x00 : kFlagSkipBlocks));
+    write_bitstream_header(w, fe.meta, flags, static_cast<uint16_t>(block_size),
+                           static_cast<uint16_t>(qualities.back()), header_bytes);
+    w.write_u16_le(layer_count);
+    w.write_u16_le(0);
+    for (int q : qualities) {
+        w.write_u16_le(static_cast<uint16_t>(q));
+        w.write_u16_le(0);
+        w.write_u32_le(0); // end offset, patched below
+    }
+    std::vector<uint8_t> out = w.release();
+
+    StageClock clock;
+    Buffers buf;
+    std::vector<int16_t> prev;      // scan reconstructed from the layers written so far
+    std::vector<int16_t> residual;
+    std::vector<uint8_t> layer;
+    const std::vector<int32_t> no_skips;
+    for (size_t k = 0; k < qualities.size(); ++k) {
+        quantize(fe.coeffs, block_size, qualities[k], buf.qcoeff);
+        zigzag_scan_blocks(buf.qcoeff, block_size, buf.zigzag_seq);
+        const std::vector<int16_t>* coded = &buf.zigzag_seq;
+        if (k > 0) {
+            requantize(prev, qualities[k - 1], qualities[k]);
+            residual.resize(prev.size());
+            for (size_t i = 0; i < prev.size(); ++i) {
+                const int32_t d = static_cast<int32_t>(buf.zigzag_seq[i]) - prev[i];
+                if (d < INT16_MIN || d > INT16_MAX) throw std::runtime_error("encode: layer residual out of int16 range");
+                residual[i] = static_cast<int16_t>(d);
+            }
+            coded = &residual;
+        }
+        model_scan(*coded, k == 0 ? fe.flat : no_skips, block_size, clock, nullptr, buf); // skip pairs in layer 0 only
+
+        ByteWriter lw(std::move(layer));
+        lw.reserve(table_section_bytes(buf) + buf.huff.payload_bytes());
+        write_table_section(lw, buf);
+        layer = lw.release();
+        buf.huff.write_payload(layer);
+        out.insert(out.end(), layer.begin(), layer.end());
+        patch_u32_le(out, kMCodecHeaderBytes + 4u + 8u * k + 4u, static_cast<uint32_t>(out.size() - header_bytes));
+        prev.swap(buf.zigzag_seq);
+    }
+    patch_u32_le(out, 28, static_cast<uint32_t>(out.size() - header_bytes));
+    return out;
 }
 
 
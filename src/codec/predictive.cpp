@@ -0,0 +1,663 @@
+#include "codec/predictive.hpp"
+
+#include "entropy/bitstream.hpp"
+#include "util/trace.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+#include <utility>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace mcodec {
+
+namespace {
+
+// ---------------- Parameters (ITU-T T.87 defaults) ---------------- //
+
+constexpr int kReset = 64;             // halve a context's statistics after this many samples
+constexpr int kMinC = -128;            // bias correction range
+constexpr int kMaxC = 127;
+constexpr int kRegularContexts = 365;  // 1..364 used; 0 is the all-flat case (run mode)
+constexpr int kRunContexts = 2;        // run interruption, Ra != Rb / Ra == Rb
+// Run-length order: a run mode '1' bit stands for 2^kJ[run_index] samples.
+constexpr int kJ[32] = {0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                        4, 4, 5, 5, 6, 6, 7, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+
+struct LocoParams {
+    int maxval = 0;
+    int near = 0;   // maximum |reconstruction error|; 0 = lossless
+    int qstep = 1;  // 2 * near + 1, the residual quantizer step
+    int range = 0;  // number of quantized residual values: maxval + 1 when lossless
+    int qbpp = 0;   // bits of an escaped residual
+    int limit = 0;  // longest Golomb code
+    int t1 = 0, t2 = 0, t3 = 0; // gradient thresholds
+};
+
+// T.87 CLAMP: values outside [lo, hi] fall back to lo.
+int clamp_threshold(int v, int hi, int lo) {
+    return (v > hi || v < lo) ? lo : v;
+}
+
+int leading_zeros64(uint64_t v) { // v != 0
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_clzll(v);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long idx;
+    _BitScanReverse64(&idx, v);
+    return 63 - static_cast<int>(idx);
+#else
+    int n = 0;
+    while ((v & (uint64_t{1} << 63)) == 0) {
+        v <<= 1;
+        ++n;
+    }
+    return n;
+#endif
+}
+
+// Smallest k with (n << k) >= a (T.87 A.5.1), from the bit lengths and one correction.
+int golomb_parameter(int32_t n, int32_t a) {
+    if (n >= a) return 0;
+    int k = leading_zeros64(static_cast<uint64_t>(n)) - leading_zeros64(static_cast<uint64_t>(a));
+    if ((n << k) < a) ++k;
+    return k;
+}
+
+int max_near(int bits_stored) {
+    return std::min(255, ((1 << bits_stored) - 1) / 2); // T.87 bound on NEAR
+}
+
+LocoParams loco_params(int bits_stored, int near) {
+    if (bits_stored < 1 || bits_stored > 16) throw std::runtime_error("predictive: bits_stored must be 1..16");
+    if (near < 0 || near > max_near(bits_stored)) throw std::runtime_error("predictive: near out of range for bits_stored");
+    LocoParams p;
+    p.maxval = (1 << bits_stored) - 1;
+    p.near = near;
+    p.qstep = 2 * near + 1;
+    p.range = (p.maxval + 2 * near) / p.qstep + 1;
+    p.qbpp = 1;
+    while ((1 << p.qbpp) < p.range) ++p.qbpp;
+    const int bpp = std::max(2, bits_stored);
+    p.limit = 2 * (bpp + std::max(8, bpp));
+    if (p.maxval >= 128) {
+        const int factor = (std::min(p.maxval, 4095) + 128) >> 8;
+        p.t1 = clamp_threshold(factor * (3 - 2) + 2 + 3 * near, p.maxval, near + 1);
+        p.t2 = clamp_threshold(factor * (7 - 3) + 3 + 5 * near, p.maxval, p.t1);
+        p.t3 = clamp_threshold(factor * (21 - 4) + 4 + 7 * near, p.maxval, p.t2);
+    } else {
+        const int factor = 256 / (p.maxval + 1);
+        p.t1 = clamp_threshold(std::max(2, 3 / factor + 3 * near), p.maxval, near + 1);
+        p.t2 = clamp_threshold(std::max(3, 7 / factor + 5 * near), p.maxval, p.t1);
+        p.t3 = clamp_threshold(std::max(4, 21 / factor + 7 * near), p.maxval, p.t2);
+    }
+    return p;
+}
+
+// Adaptive state shared by encoder and decoder; both update it identically.
+struct LocoState {
+    LocoParams p;
+    std::vector<int8_t> qtab;  // gradient -> -4..4, indexed by d + maxval
+    const int8_t* grad = nullptr;
+    int32_t A[kRegularContexts + kRunContexts];
+    int32_t N[kRegularContexts + kRunContexts];
+    int32_t B[kRegularContexts];
+    int32_t C[kRegularContexts];
+    int32_t Nn[kRunContexts];
+    int run_index = 0;
+
+    LocoState(int bits_stored, int near) : p(loco_params(bits_stored, near)) {
+        qtab.resize(static_cast<size_t>(2 * p.maxval + 1));
+        for (int d = -p.maxval; d <= p.maxval; ++d) {
+            int q;
+            if (d <= -p.t3) q = -4;
+            else if (d <= -p.t2) q = -3;
+            else if (d <= -p.t1) q = -2;
+            else if (d < -p.near) q = -1;
+            else if (d <= p.near) q = 0;
+            else if (d < p.t1) q = 1;
+            else if (d < p.t2) q = 2;
+            else if (d < p.t3) q = 3;
+            else q = 4;
+            qtab[static_cast<size_t>(d + p.maxval)] = static_cast<int8_t>(q);
+        }
+        grad = qtab.data() + p.maxval;
+        const int32_t a0 = std::max(2, (p.range + 32) / 64);
+        std::fill(std::begin(A), std::end(A), a0);
+        std::fill(std::begin(N), std::end(N), 1);
+        std::fill(std::begin(B), std::end(B), 0);
+        std::fill(std::begin(C), std::end(C), 0);
+        std::fill(std::begin(Nn), std::end(Nn), 0);
+    }
+
+    // Context of the gradients (d1, d2, d3): 1..364 with sign = +-1, or 0 when all are
+    // within +-near (run mode). The sign folds mirrored contexts together.
+    int context(int d1, int d2, int d3, int& sign) const {
+        const int q = 81 * grad[d1] + 9 * grad[d2] + grad[d3];
+        sign = (q < 0) ? -1 : 1;
+        return (q < 0) ? -q : q;
+    }
+
+    // Bias-corrected median edge detector prediction, written as selects: which case
+    // applies is data-dependent and would be a poorly predicted branch.
+    int predict(int ctx, int sign, int ra, int rb, int rc) const {
+        const int mx = std::max(ra, rb);
+        const int mn = std::min(ra, rb);
+        int px = ra + rb - rc;
+        px = (rc >= mx) ? mn : px;
+        px = (rc <= mn) ? mx : px;
+        px += sign * C[ctx];
+        return std::min(std::max(px, 0), p.maxval);
+    }
+
+    // Residual <-> non-negative code index (T.87 A.5.2): 0, -1, 1, -2, ... and, where the
+    // context's bias is negative (lossless, k == 0, 2B <= -N), the mirrored order -1, 0, -2, 1, ...
+    bool mirrored(int ctx, int k) const { return p.near == 0 && k == 0 && 2 * B[ctx] <= -N[ctx]; }
+    static uint32_t map_error(int err, bool mirror) {
+        const int e = mirror ? ~err : err;
+        return static_cast<uint32_t>(e >= 0 ? 2 * e : -2 * e - 1);
+    }
+    static int unmap_error(uint32_t m, bool mirror) {
+        const int e = (m & 1u) ? -static_cast<int>((m + 1u) >> 1) : static_cast<int>(m >> 1);
+        return mirror ? ~e : e;
+    }
+
+    int golomb_k(int ctx) const { return golomb_parameter(N[ctx], A[ctx]); }
+
+    // Near-lossless residual quantizer (T.87 A.4.4): |err - dequantized| <= near.
+    int quantize(int err) const {
+        return err > 0 ? (err + p.near) / p.qstep : -((p.near - err) / p.qstep);
+    }
+
+    // Encoder-side reconstruction the decoder will reproduce.
+    int reconstruct(int px, int qerr) const {
+        return std::min(std::max(px + qerr * p.qstep, 0), p.maxval);
+    }
+
+    // Residual into [-range/2, range/2).
+    int reduce(int err) const {
+        if (err < 0) err += p.range;
+        if (err >= (p.range + 1) / 2) err -= p.range;
+        return err;
+    }
+
+    // Decoder side of reduce(): prediction + dequantized residual back into [0, maxval].
+    // Anything further than near outside can only come from a corrupt stream (and would
+    // index past qtab).
+    int wrap(int v) const {
+        if (v < -p.near) v += p.range * p.qstep;
+        else if (v > p.maxval + p.near) v -= p.range * p.qstep;
+        if (v < -p.near || v > p.maxval + p.near) throw std::runtime_error("decode: corrupt predictive payload");
+        return std::min(std::max(v, 0), p.maxval);
+    }
+
+    // `err`: quantized residual.
+    template <bool Near>
+    void update_regular(int ctx, int err) {
+        B[ctx] += Near ? err * p.qstep : err;
+        A[ctx] += std::abs(err);
+        if (N[ctx] == kReset) {
+            A[ctx] >>= 1;
+            B[ctx] >>= 1;
+            N[ctx] >>= 1;
+        }
+        ++N[ctx];
+        if (B[ctx] <= -N[ctx]) {
+            B[ctx] += N[ctx];
+            if (C[ctx] > kMinC) --C[ctx];
+            if (B[ctx] <= -N[ctx]) B[ctx] = -N[ctx] + 1;
+        } else if (B[ctx] > 0) {
+            B[ctx] -= N[ctx];
+            if (C[ctx] < kMaxC) ++C[ctx];
+            if (B[ctx] > 0) B[ctx] = 0;
+        }
+    }
+
+    // Run interruption sample: Golomb parameter, and its statistics update.
+    int ri_k(int ritype) const {
+        const int ctx = kRegularContexts + ritype;
+        return golomb_parameter(N[ctx], ritype ? A[ctx] + (N[ctx] >> 1) : A[ctx]);
+    }
+
+    void update_ri(int ritype, int err, int merr) {
+        const int ctx = kRegularContexts + ritype;
+        if (err < 0) ++Nn[ritype];
+        A[ctx] += (merr + 1 - ritype) >> 1;
+        if (N[ctx] == kReset) {
+            A[ctx] >>= 1;
+            N[ctx] >>= 1;
+            Nn[ritype] >>= 1;
+        }
+        ++N[ctx];
+    }
+
+    // Whether the run interruption mapping swaps the sign order (T.87 A.7.2.1).
+    bool ri_negative_first(int ritype, int k) const {
+        return k != 0 || 2 * Nn[ritype] >= N[kRegularContexts + ritype];
+    }
+};
+
+// ---------------- Bit I/O ---------------- //
+
+// MSB-first writer through a 64-bit accumulator (low `n_` bits pending), appending to
+// `out`; full words go straight into the buffer, which grows into its capacity, then doubles.
+class RiceWriter {
+public:
+    explicit RiceWriter(std::vector<uint8_t>& out) : out_(out), pos_(out.size()) {}
+
+    void put(uint32_t bits, int len) { // len <= 32
+        acc_ = (acc_ << len) | bits;
+        n_ += len;
+        if (n_ >= 32) {
+            n_ -= 32;
+            const uint32_t w = static_cast<uint32_t>(acc_ >> n_);
+            if (pos_ + 4 > out_.size()) out_.resize(std::max({out_.capacity(), 2 * out_.size(), size_t{64}}));
+            uint8_t* d = out_.data() + pos_;
+            d[0] = static_cast<uint8_t>(w >> 24);
+            d[1] = static_cast<uint8_t>(w >> 16);
+            d[2] = static_cast<uint8_t>(w >> 8);
+            d[3] = static_cast<uint8_t>(w);
+            pos_ += 4;
+        }
+    }
+
+    void put_zeros(int n) {
+        while (n > 32) {
+            put(0, 32);
+            n -= 32;
+        }
+        put(0, n);
+    }
+
+    // Limited-length Golomb code of `m` with parameter k (T.87 A.5.3).
+    void golomb(uint32_t m, int k, int limit, int qbpp) {
+        const uint32_t high = m >> k;
+        const uint32_t max_unary = static_cast<uint32_t>(limit - qbpp - 1);
+        if (high < max_unary) {
+            const uint32_t code = (1u << k) | (m & ((1u << k) - 1u));
+            const int len = static_cast<int>(high) + k + 1;
+            if (len <= 32) {
+                put(code, len); // the unary zeros are the code's leading zeros
+            } else {
+                put_zeros(static_cast<int>(high));
+                put(code, k + 1);
+            }
+        } else {
+            put_zeros(static_cast<int>(max_unary));
+            put(1, 1);
+            put(m - 1, qbpp);
+        }
+    }
+
+    // Pad to a byte and trim `out` to the written size.
+    void flush() {
+        out_.resize(pos_);
+        while (n_ >= 8) {
+            n_ -= 8;
+            out_.push_back(static_cast<uint8_t>(acc_ >> n_));
+        }
+        if (n_ > 0) out_.push_back(static_cast<uint8_t>(acc_ << (8 - n_)));
+        n_ = 0;
+        pos_ = out_.size();
+    }
+
+private:
+    std::vector<uint8_t>& out_;
+    size_t pos_;
+    uint64_t acc_ = 0;
+    int n_ = 0;
+};
+
+// MSB-first reader: `acc_` holds `n_` valid bits at the top. Reading more than a word past
+// the end throws; decode_predictive_payload checks the exact end afterwards.
+class RiceReader {
+public:
+    RiceReader(const uint8_t* data, size_t size) : begin_(data), p_(data), end_(data + size) {}
+
+    uint32_t get(int len) { // len <= 32
+        if (len == 0) return 0;
+        if (n_ < len) refill();
+        const uint32_t v = static_cast<uint32_t>(acc_ >> (64 - len));
+        acc_ <<= len;
+        n_ -= len;
+        return v;
+    }
+
+    bool bit() { return get(1) != 0; }
+
+    // Zeros up to and including the next 1; more than `max` zeros is a corrupt stream.
+    int unary(int max) {
+        int zeros = 0;
+        for (;;) {
+            if (n_ < 32) refill();
+            if (acc_ != 0) {
+                const int c = leading_zeros64(acc_);
+                if (c < n_) {
+                    zeros += c;
+                    acc_ <<= c;
+                    acc_ <<= 1;
+                    n_ -= c + 1;
+                    break;
+                }
+            }
+            zeros += n_;
+            acc_ = 0;
+            n_ = 0;
+            if (zeros > max) break;
+        }
+        if (zeros > max) throw std::runtime_error("decode: invalid Golomb code in predictive payload");
+        return zeros;
+    }
+
+    uint32_t golomb(int k, int limit, int qbpp) {
+        const int max_unary = limit - qbpp - 1;
+        const int high = unary(max_unary);
+        if (high < max_unary) return (static_cast<uint32_t>(high) << k) | get(k);
+        return get(qbpp) + 1u;
+    }
+
+    // Bits consumed so far (including zeros read past the end).
+    uint64_t consumed_bits() const {
+        return 8u * (static_cast<uint64_t>(p_ - begin_) + overrun_) - static_cast<uint64_t>(n_);
+    }
+
+private:
+    void refill() {
+        while (n_ <= 56) {
+            uint64_t b = 0;
+            if (p_ < end_) {
+                b = *p_++;
+            } else if (++overrun_ > 8) {
+                throw std::runtime_error("decode: predictive payload truncated");
+            }
+            acc_ |= b << (56 - n_);
+            n_ += 8;
+        }
+    }
+
+    const uint8_t* begin_;
+    const uint8_t* p_;
+    const uint8_t* end_;
+    uint64_t acc_ = 0;
+    int n_ = 0;
+    uint64_t overrun_ = 0;
+};
+
+// ---------------- Line coders ---------------- //
+// `prev` / `cur` point at sample 0 of the line above / the current line, each with one
+// extra entry on both sides: cur[-1] = prev[0] (Ra of the first sample), prev[w] =
+// prev[w - 1] (Rd of the last), and prev[-1] is the previous line's own [-1] (Rc).
+// Both sides predict from reconstructed samples: with Near the encoder overwrites `cur`
+// with what the decoder will produce; lossless it is left as is.
+
+template <bool Near>
+void encode_line(const int32_t* prev, int32_t* cur, int w, LocoState& s, RiceWriter& bw) {
+    const LocoParams& p = s.p;
+    int x = 0;
+    while (x < w) {
+        const int ra = cur[x - 1], rb = prev[x], rc = prev[x - 1], rd = prev[x + 1];
+        int sign;
+        const int ctx = s.context(rd - rb, rb - rc, rc - ra, sign);
+        if (ctx != 0) {
+            // Regular mode
+            const int px = s.predict(ctx, sign, ra, rb, rc);
+            int err = sign * (cur[x] - px);
+            if (Near) {
+                err = s.quantize(err);
+                cur[x] = s.reconstruct(px, sign * err);
+            }
+            err = s.reduce(err);
+            const int k = s.golomb_k(ctx);
+            bw.golomb(LocoState::map_error(err, !Near && s.mirrored(ctx, k)), k, p.limit, p.qbpp);
+            s.update_regular<Near>(ctx, err);
+            ++x;
+            continue;
+        }
+
+        // Run mode: samples equal to Ra (within +-near), coded in chunks of 2^J
+        int run = 0;
+        if (Near) {
+            for (; x + run < w && std::abs(cur[x + run] - ra) <= p.near; ++run) cur[x + run] = ra;
+        } else {
+            while (x + run < w && cur[x + run] == ra) ++run;
+        }
+        x += run;
+        while (run >= (1 << kJ[s.run_index])) {
+            bw.put(1, 1);
+            run -= 1 << kJ[s.run_index];
+            if (s.run_index < 31) ++s.run_index;
+        }
+        if (x == w) {
+            if (run > 0) bw.put(1, 1); // partial chunk up to the end of the line
+            break;
+        }
+        bw.put(static_cast<uint32_t>(run), kJ[s.run_index] + 1); // '0' + remainder
+
+        // Run interruption sample
+        const int rb_i = prev[x];
+        const int ritype = (std::abs(ra - rb_i) <= p.near) ? 1 : 0;
+        const int px = ritype ? ra : rb_i;
+        const int ri_sign = (!ritype && ra > rb_i) ? -1 : 1;
+        int err = ri_sign * (cur[x] - px);
+        if (Near) {
+            err = s.quantize(err);
+            cur[x] = s.reconstruct(px, ri_sign * err);
+        }
+        err = s.reduce(err);
+        const int k = s.ri_k(ritype);
+        const bool map = s.ri_negative_first(ritype, k) ? (err < 0) : (err > 0 && k == 0);
+        const int merr = 2 * std::abs(err) - ritype - (map ? 1 : 0);
+        bw.golomb(static_cast<uint32_t>(merr), k, p.limit - kJ[s.run_index] - 1, p.qbpp);
+        s.update_ri(ritype, err, merr);
+        if (s.run_index > 0) --s.run_index;
+        ++x;
+    }
+}
+
+template <bool Near>
+void decode_line(const int32_t* prev, int32_t* cur, int w, LocoState& s, RiceReader& br) {
+    const LocoParams& p = s.p;
+    int x = 0;
+    while (x < w) {
+        const int ra = cur[x - 1], rb = prev[x], rc = prev[x - 1], rd = prev[x + 1];
+        int sign;
+        const int ctx = s.context(rd - rb, rb - rc, rc - ra, sign);
+        if (ctx != 0) {
+            const int px = s.predict(ctx, sign, ra, rb, rc);
+            const int k = s.golomb_k(ctx);
+            const int err = LocoState::unmap_error(br.golomb(k, p.limit, p.qbpp), !Near && s.mirrored(ctx, k));
+            s.update_regular<Near>(ctx, err);
+            cur[x++] = s.wrap(px + sign * (Near ? err * p.qstep : err));
+            continue;
+        }
+
+        const int remaining = w - x;
+        int run = 0;
+        while (run < remaining && br.bit()) {
+            const int chunk = 1 << kJ[s.run_index];
+            const int n = std::min(chunk, remaining - run);
+            run += n;
+            if (n == chunk && s.run_index < 31) ++s.run_index;
+        }
+        const bool interrupted = run < remaining;
+        if (interrupted) {
+            run += static_cast<int>(br.get(kJ[s.run_index]));
+            if (run >= remaining) throw std::runtime_error("decode: run length past the end of a line");
+        }
+        std::fill(cur + x, cur + x + run, ra);
+        x += run;
+        if (!interrupted) break;
+
+        const int rb_i = prev[x];
+        const int ritype = (std::abs(ra - rb_i) <= p.near) ? 1 : 0;
+        const int k = s.ri_k(ritype);
+        const int merr = static_cast<int>(br.golomb(k, p.limit - kJ[s.run_index] - 1, p.qbpp));
+        const int temp = merr + ritype;
+        const bool map = (temp & 1) != 0;
+        const int mag = (temp + (map ? 1 : 0)) / 2;
+        const int err = (map == s.ri_negative_first(ritype, k)) ? -mag : mag;
+        s.update_ri(ritype, err, merr);
+        if (s.run_index > 0) --s.run_index;
+        const int px = ritype ? ra : rb_i;
+        const int dq = Near ? err * p.qstep : err;
+        cur[x++] = s.wrap(px + ((!ritype && ra > rb_i) ? -dq : dq));
+    }
+}
+
+// ---------------- Image level ---------------- //
+
+struct SampleFormat {
+    int width = 0;
+    int height = 0;
+    int bits_stored = 0;
+    int bits_allocated = 0;
+    bool is_signed = false;
+    PixelType type = PixelType::U16;
+};
+
+int32_t sample_offset(int bits_stored, bool is_signed) {
+    return is_signed ? (int32_t{1} << (bits_stored - 1)) : 0;
+}
+
+template <typename T>
+std::vector<uint8_t> encode_samples(const T* px, const SampleFormat& f, int near) {
+    LocoState s(f.bits_stored, near);
+    const int32_t offset = sample_offset(f.bits_stored, f.is_signed);
+    const size_t w = static_cast<size_t>(f.width);
+
+    Image meta;
+    meta.width = f.width;
+    meta.height = f.height;
+    meta.channels = 1;
+    meta.bits_stored = f.bits_stored;
+    meta.bits_allocated = f.bits_allocated;
+    meta.is_signed = f.is_signed;
+    meta.type = f.type;
+
+    ByteWriter hw;
+    write_bitstream_header(hw, meta, kFlagPredictive, /*block_size=*/0, /*quality=*/0);
+    hw.write_u16_le(static_cast<uint16_t>(near));
+    hw.write_u16_le(0); // reserved
+    std::vector<uint8_t> out = hw.release();
+    const size_t payload_start = kMCodecHeaderBytes;
+    out.reserve(out.size() + w * static_cast<size_t>(f.height) * static_cast<size_t>(f.bits_allocated) / 32);
+
+    std::vector<int32_t> line_a(w + 2, 0), line_b(w + 2, 0);
+    int32_t* prev = line_a.data() + 1;
+    int32_t* cur = line_b.data() + 1;
+    RiceWriter bw(out);
+    for (int y = 0; y < f.height; ++y) {
+        const T* row = px + static_cast<size_t>(y) * w;
+        for (size_t x = 0; x < w; ++x) {
+            const int32_t v = static_cast<int32_t>(row[x]) + offset;
+            if (v < 0 || v > s.p.maxval) throw std::runtime_error("encode: sample outside the bits_stored range");
+            cur[x] = v;
+        }
+        cur[-1] = prev[0];
+        prev[w] = prev[w - 1];
+        if (near > 0) encode_line<true>(prev, cur, f.width, s, bw);
+        else encode_line<false>(prev, cur, f.width, s, bw);
+        std::swap(prev, cur);
+    }
+    bw.flush();
+
+    const uint32_t payload_bytes = static_cast<uint32_t>(out.size() - payload_start);
+    out[28] = static_cast<uint8_t>(payload_bytes & 0xFF);
+    out[29] = static_cast<uint8_t>((payload_bytes >> 8) & 0xFF);
+    out[30] = static_cast<uint8_t>((payload_bytes >> 16) & 0xFF);
+    out[31] = static_cast<uint8_t>((payload_bytes >> 24) & 0xFF);
+    return out;
+}
+
+} // namespace
+
+std::vector<uint8_t> encode_lossless_mcodec(const Image& im) {
+    return encode_near_lossless_mcodec(im, 0);
+}
+
+std::vector<uint8_t> encode_lossless_mcodec(const PixelView& src) {
+    return encode_near_lossless_mcodec(src, 0);
+}
+
+std::vector<uint8_t> encode_near_lossless_mcodec(const Image& im, int near) {
+    if (im.channels != 1) throw std::runtime_error("encode: only grayscale is supported");
+    if (im.width <= 0 || im.height <= 0) throw std::runtime_error("encode: invalid image size");
+    if (static_cast<int>(im.pixels.size()) != im.width * im.height) throw std::runtime_error("encode: buffer size mismatch");
+    MCODEC_TRACE_SCOPE("encode.predictive");
+    SampleFormat f{im.width, im.height, im.bits_stored, im.bits_allocated, im.is_signed, im.type};
+    return encode_samples(im.pixels.data(), f, near);
+}
+
+std::vector<uint8_t> encode_near_lossless_mcodec(const PixelView& src, int near) {
+    if (!src.data) throw std::runtime_error("encode: null pixel buffer");
+    if (src.width <= 0 || src.height <= 0) throw std::runtime_error("encode: invalid image size");
+    MCODEC_TRACE_SCOPE("encode.predictive");
+    SampleFormat f{src.width, src.height, src.bits_stored, src.bits_allocated, src.is_signed, src.type};
+    switch (src.type) {
+    case PixelType::U8:
+        return encode_samples(static_cast<const uint8_t*>(src.data), f, near);
+    case PixelType::U16:
+        return encode_samples(static_cast<const uint16_t*>(src.data), f, near);
+    case PixelType::S16:
+        return encode_samples(static_cast<const int16_t*>(src.data), f, near);
+    default:
+        throw std::runtime_error("encode: unsupported pixel type");
+    }
+}
+
+void decode_predictive_payload(const MCodecHeader& hdr, const uint8_t* payload, size_t size, Image& out) {
+    MCODEC_TRACE_SCOPE("dec.predictive");
+    if (hdr.channels != 1) throw std::runtime_error("decode: only grayscale is supported");
+    if (hdr.width == 0 || hdr.height == 0 || hdr.width > 0x7FFFFFFFu || hdr.height > 0x7FFFFFFFu) {
+        throw std::runtime_error("decode: invalid image size");
+    }
+    if (size < 4) throw std::runtime_error("decode: predictive payload too small");
+    ByteReader r(payload, size);
+    const uint16_t near = r.read_u16_le();
+    r.read_u16_le(); // reserved
+    if (hdr.bits_stored < 1 || hdr.bits_stored > 16 || near > max_near(static_cast<int>(hdr.bits_stored))) {
+        throw std::runtime_error("decode: invalid predictive parameters");
+    }
+
+    const uint8_t* bits = payload + 4;
+    const size_t bits_size = size - 4;
+    // Every line costs at least one bit, and one bit covers at most 2^15 run samples;
+    // checked before the image is sized from the header.
+    const uint64_t avail_bits = 8u * static_cast<uint64_t>(bits_size);
+    if (hdr.height > avail_bits ||
+        static_cast<uint64_t>(hdr.width) * hdr.height > avail_bits * (uint64_t{1} << 15)) {
+        throw std::runtime_error("decode: image size inconsistent with the predictive payload");
+    }
+
+    LocoState s(static_cast<int>(hdr.bits_stored), near);
+    out.width = static_cast<int>(hdr.width);
+    out.height = static_cast<int>(hdr.height);
+    out.channels = 1;
+    out.bits_allocated = static_cast<int>(hdr.bits_allocated);
+    out.bits_stored = static_cast<int>(hdr.bits_stored);
+    out.is_signed = (hdr.is_signed != 0);
+    out.type = out.is_signed ? PixelType::S16 : (out.bits_allocated <= 8 ? PixelType::U8 : PixelType::U16);
+    const size_t w = hdr.width;
+    out.pixels.resize(w * hdr.height);
+    const int32_t offset = sample_offset(out.bits_stored, out.is_signed);
+
+    std::vector<int32_t> line_a(w + 2, 0), line_b(w + 2, 0);
+    int32_t* prev = line_a.data() + 1;
+    int32_t* cur = line_b.data() + 1;
+    RiceReader br(bits, bits_size);
+    for (size_t y = 0; y < hdr.height; ++y) {
+        cur[-1] = prev[0];
+        prev[w] = prev[w - 1];
+        if (near > 0) decode_line<true>(prev, cur, static_cast<int>(w), s, br);
+        else decode_line<false>(prev, cur, static_cast<int>(w), s, br);
+        int32_t* dst = out.pixels.data() + y * w;
+        for (size_t x = 0; x < w; ++x) dst[x] = cur[x] - offset;
+        std::swap(prev, cur);
+    }
+    if (br.consumed_bits() > avail_bits) throw std::runtime_error("decode: predictive payload truncated");
+}
+
+} // namespace mcodec
@@ -0,0 +1,126 @@
+#include "codec/rd_sweep.hpp"
+
+#include "codec/decoder.hpp"
+#include "codec/encoder.hpp"
+#include "util/parallel.hpp"
+#include "util/trace.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+namespace mcodec {
+
+std::vector<RdPoint> rd_sweep(const Image& im, const std::vector<int>& qualities, const RdSweepOptions& opt) {
+    for (int q : qualities) {
+        if (q < 1 || q > 100) throw std::runtime_error("rd_sweep: quality out of range 1..100");
+    }
+    MCODEC_TRACE_SCOPE("rd_sweep");
+    const EncoderFrontEnd fe = encode_front_end(im);
+    const double pixels = static_cast<double>(im.width) * static_cast<double>(im.height);
+
+    MetricsOptions mopt;
+    mopt.histogram = opt.histogram;
+    mopt.ssim = opt.ssim;
+    mopt.ms_ssim = opt.ssim;
+    mopt.threads = 1; // already one quality per worker
+
+    using Clock = std::chrono::steady_clock;
+    auto ms_since = [](Clock::time_point t) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - t).count();
+    };
+    std::vector<RdPoint> points(qualities.size());
+    parallel_for(qualities.size(), [&](size_t i) {
+        RdPoint& p = points[i];
+        p.quality = qualities[i];
+        auto t = Clock::now();
+        const std::vector<uint8_t> bytes = encode_from_front_end(fe, p.quality);
+        p.encode_ms = ms_since(t);
+        t = Clock::now();
+        Image rec = decode_from_mcodec(bytes);
+        p.decode_ms = ms_since(t);
+        p.compressed_bytes = bytes.size();
+        p.bpp = 8.0 * static_cast<double>(bytes.size()) / pixels;
+        p.metrics = compute_metrics(im, rec, mopt);
+        if (opt.keep_recon) p.recon = std::move(rec);
+    }, opt.threads);
+    return points;
+}
+
+namespace {
+
+// Least-squares cubic y = c0 + c1 t + c2 t^2 + c3 t^3 with t = (x - mid) / half
+// (normalized for conditioning). Returns coefficients in t.
+std::array<double, 4> fit_cubic(const std::vector<std::pair<double, double>>& xy, double mid, double half) {
+    double a[4][5] = {};
+    for (const auto& [x, y] : xy) {
+        const double t = (x - mid) / half;
+        const double p[4] = {1.0, t, t * t, t * t * t};
+        for (int r = 0; r < 4; ++r) {
+            for (int c = 0; c < 4; ++c) a[r][c] += p[r] * p[c];
+            a[r][4] += p[r] * y;
+        }
+    }
+    // Gaussian elimination with partial pivoting.
+    for (int c = 0; c < 4; ++c) {
+        int piv = c;
+        for (int r = c + 1; r < 4; ++r) {
+            if (std::fabs(a[r][c]) > std::fabs(a[piv][c])) piv = r;
+        }
+        if (std::fabs(a[piv][c]) < 1e-12) throw std::runtime_error("bd_rate: degenerate curve");
+        for (int k = 0; k < 5; ++k) std::swap(a[c][k], a[piv][k]);
+        for (int r = 0; r < 4; ++r) {
+            if (r == c) continue;
+            const double f = a[r][c] / a[c][c];
+            for (int k = c; k < 5; ++k) a[r][k] -= f * a[c][k];
+        }
+    }
+    return {a[0][4] / a[0][0], a[1][4] / a[1][1], a[2][4] / a[2][2], a[3][4] / a[3][3]};
+}
+
+// Integral of the fitted cubic over x in [lo, hi].
+double integrate_cubic(const std::array<double, 4>& c, double mid, double half, double lo, double hi) {
+    auto prim = [&](double x) {
+        const double t = (x - mid) / half;
+        return half * (c[0] * t + c[1] * t * t / 2.0 + c[2] * t * t * t / 3.0 + c[3] * t * t * t * t / 4.0);
+    };
+    return prim(hi) - prim(lo);
+}
+
+// (psnr, log10 rate) pairs of the usable points.
+std::vector<std::pair<double, double>> log_rate_curve(const std::vector<std::pair<double, double>>& pts) {
+    std::vector<std::pair<double, double>> out;
+    for (const auto& [bpp, psnr] : pts) {
+        if (bpp > 0.0 && std::isfinite(psnr)) out.push_back({psnr, std::log10(bpp)});
+    }
+    if (out.size() < 4) throw std::runtime_error("bd_rate: need at least 4 points with finite PSNR per curve");
+    return out;
+}
+
+} // namespace
+
+double bd_rate(const std::vector<std::pair<double, double>>& ref,
+               const std::vector<std::pair<double, double>>& test) {
+    const auto r = log_rate_curve(ref);
+    const auto t = log_rate_curve(test);
+    auto range = [](const std::vector<std::pair<double, double>>& c) {
+        const auto mm = std::minmax_element(c.begin(), c.end());
+        return std::make_pair(mm.first->first, mm.second->first);
+    };
+    const auto [r_lo, r_hi] = range(r);
+    const auto [t_lo, t_hi] = range(t);
+    const double lo = std::max(r_lo, t_lo);
+    const double hi = std::min(r_hi, t_hi);
+    if (!(hi > lo)) throw std::runtime_error("bd_rate: PSNR ranges do not overlap");
+
+    const double mid = 0.5 * (lo + hi);
+    const double half = std::max(0.5 * (std::max(r_hi, t_hi) - std::min(r_lo, t_lo)), 1e-9);
+    const auto cr = fit_cubic(r, mid, half);
+    const auto ct = fit_cubic(t, mid, half);
+    const double avg_diff = (integrate_cubic(ct, mid, half, lo, hi) - integrate_cubic(cr, mid, half, lo, hi)) / (hi - lo);
+    return (std::pow(10.0, avg_diff) - 1.0) * 100.0;
+}
+
+} // namespace mcodec
@@ -0,0 +1,245 @@
+#include "codec/size_estimate.hpp"
+
+#include "block/tiling.hpp"
+#include "block/zigzag.hpp"
+#include "entropy/huffman.hpp"
+#include "entropy/rle.hpp"
+#include "format/mcodec_format.hpp"
+#include "preprocess/level_shift.hpp"
+#include "quant/quantizer.hpp"
+#include "util/trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace mcodec {
+
+namespace {
+
+constexpr int kN = 8;
+constexpr int kBlockElems = kN * kN;
+
+// Single-precision 8x8 DCT-II with the same orthonormal scaling as dct2d_blocks.
+// Both passes accumulate eight outputs at once, which the compiler vectorizes.
+struct FloatDct8 {
+    float ct[kN][kN]; // ct[x][u] = alpha(u) * cos((2x+1) u pi / 16)
+
+    FloatDct8() {
+        const double pi = 3.14159265358979323846;
+        for (int u = 0; u < kN; ++u) {
+            const double a = (u == 0) ? std::sqrt(1.0 / kN) : std::sqrt(2.0 / kN);
+            for (int x = 0; x < kN; ++x) {
+                ct[x][u] = static_cast<float>(a * std::cos((2 * x + 1) * u * pi / (2.0 * kN)));
+            }
+        }
+    }
+
+    void forward(const float* in, float* out) const {
+        float tmp[kBlockElems];
+        for (int y = 0; y < kN; ++y) {
+            float acc[kN] = {};
+            for (int x = 0; x < kN; ++x) {
+                const float s = in[y * kN + x];
+                for (int u = 0; u < kN; ++u) acc[u] += s * ct[x][u];
+            }
+            for (int u = 0; u < kN; ++u) tmp[y * kN + u] = acc[u];
+        }
+        for (int v = 0; v < kN; ++v) {
+            float acc[kN] = {};
+            for (int y = 0; y < kN; ++y) {
+                const float w = ct[y][v];
+                for (int u = 0; u < kN; ++u) acc[u] += w * tmp[y * kN + u];
+            }
+            for (int u = 0; u < kN; ++u) out[v * kN + u] = acc[u];
+        }
+    }
+};
+
+const FloatDct8& float_dct8() {
+    static const FloatDct8 dct;
+    return dct;
+}
+
+int16_t clamp_i16(int q) {
+    if (q > std::numeric_limits<int16_t>::max()) q = std::numeric_limits<int16_t>::max();
+    if (q < std::numeric_limits<int16_t>::min()) q = std::numeric_limits<int16_t>::min();
+    return static_cast<int16_t>(q);
+}
+
+// `Exact` rounds with std::round as quantize() does; otherwise half-away-from-zero by
+// truncation, which only differs within float rounding of a .5 boundary but vectorizes.
+template <bool Exact>
+void quantize_block(const float* coeff, float inv_step, int16_t* q) {
+    for (int i = 0; i < kBlockElems; ++i) {
+        const float v = coeff[i] * inv_step;
+        const int r = Exact ? static_cast<int>(std::round(v)) : static_cast<int>(v + std::copysign(0.5f, v));
+        q[i] = clamp_i16(r);
+    }
+}
+
+// Counts the symbols rle_encode_zeros + pack_rle_symbols would produce for each
+// quantized block. Runs inside a block are below 64, so (run, value) pairs with a
+// small value are counted in a dense table and only the rest go through the
+// Huffman model's hash; the code lengths do not depend on the counting order.
+class SymbolCounter {
+public:
+    SymbolCounter() : dense_(static_cast<size_t>(kBlockElems) * kDenseValues, 0u) {
+        const std::vector<int> order = make_zigzag_order(kN);
+        for (int i = 0; i < kBlockElems; ++i) order_[i] = static_cast<uint8_t>(order[static_cast<size_t>(i)]);
+        huff_.reset_counts();
+    }
+
+    // `q`: one block in natural (row-major) order.
+    void add_block(const int16_t* q) {
+        count(0, q[0]); // DC
+        uint32_t run = 0;
+        for (int i = 1; i < kBlockElems; ++i) {
+            const int16_t v = q[order_[i]];
+            if (v == 0) {
+                ++run;
+                continue;
+            }
+            count(run, v);
+            run = 0;
+        }
+        if (run > 0) count(run - 1, 0); // trailing zeros are stored as run - 1
+    }
+
+    // A uniform block coded as a skip block (kFlagSkipBlocks): one pair.
+    void add_skip(int32_t value) {
+        huff_.count((static_cast<uint32_t>(kSkipRun) << 16) | static_cast<uint16_t>(value));
+    }
+
+    // Header + table section + payload, as laid out by encode_scan.
+    uint64_t stream_bytes() {
+        for (size_t i = 0; i < dense_.size(); ++i) {
+            if (dense_[i] == 0) continue;
+            const uint32_t run = static_cast<uint32_t>(i / kDenseValues);
+            const int value = static_cast<int>(i % kDenseValues) - kDenseValues / 2;
+            huff_.count((run << 16) | static_cast<uint16_t>(value), dense_[i]);
+        }
+        huff_.build_lengths();
+        const uint64_t table_bytes = 4u + 4u + static_cast<uint64_t>(huff_.code_lengths().size()) * (4u + 1u);
+        return kMCodecHeaderBytes + table_bytes + huff_.payload_bytes();
+    }
+
+private:
+    static constexpr int kDenseValues = 256; // values -128..127
+
+    void count(uint32_t run, int16_t v) {
+        if (v >= -kDenseValues / 2 && v < kDenseValues / 2) {
+            ++dense_[run * kDenseValues + static_cast<uint32_t>(v + kDenseValues / 2)];
+        } else {
+            huff_.count((run << 16) | static_cast<uint16_t>(v));
+        }
+    }
+
+    uint8_t order_[kBlockElems];
+    std::vector<uint32_t> dense_;
+    HuffmanEncoder huff_;
+};
+
+float inverse_step(int quality) {
+    if (quality < 1 || quality > 100) throw std::runtime_error("estimate: quality out of range 1..100");
+    return 1.0f / static_cast<float>(quant_step_from_quality(quality));
+}
+
+// Sample value of a uniform block that find_flat_blocks would mark, else kNotFlat.
+int32_t flat_value(const float* chunk) {
+    bool uniform = true;
+    for (int i = 1; i < kBlockElems; ++i) uniform &= (chunk[i] == chunk[0]);
+    if (!uniform || chunk[0] < INT16_MIN || chunk[0] > INT16_MAX) return kNotFlat;
+    return static_cast<int32_t>(chunk[0]);
+}
+
+// The encoder's blocks are consecutive runs of 64 samples of the zero-padded,
+// level-shifted raster (tile_to_blocks -> dct2d_blocks); walk the rows in that order.
+// Uniform blocks skip the transform as in the encoder.
+template <typename T>
+uint64_t estimate_samples(const T* px, int width, int height, int32_t offset, int quality) {
+    const float inv_step = inverse_step(quality);
+    const BlockGrid g = make_grid(width, height, kN);
+    const FloatDct8& dct = float_dct8();
+    SymbolCounter counter;
+
+    float chunk[kBlockElems];
+    float coeff[kBlockElems];
+    int16_t q[kBlockElems];
+    int k = 0; // samples in chunk
+    for (int y = 0; y < g.padded_h; ++y) {
+        const T* row = (y < height) ? px + static_cast<size_t>(y) * width : px;
+        const int valid = (y < height) ? width : 0;
+        for (int x = 0; x < g.padded_w;) {
+            const int n = std::min(kBlockElems - k, g.padded_w - x);
+            const int m = std::max(0, std::min(n, valid - x));
+            for (int i = 0; i < m; ++i) chunk[k + i] = static_cast<float>(static_cast<int32_t>(row[x + i]) - offset);
+            for (int i = m; i < n; ++i) chunk[k + i] = 0.0f;
+            k += n;
+            x += n;
+            if (k == kBlockElems) {
+                const int32_t flat = flat_value(chunk);
+                if (flat != kNotFlat) {
+                    counter.add_skip(flat);
+                } else {
+                    dct.forward(chunk, coeff);
+                    quantize_block<false>(coeff, inv_step, q);
+                    counter.add_block(q);
+                }
+                k = 0;
+            }
+        }
+    }
+    return counter.stream_bytes();
+}
+
+} // namespace
+
+uint64_t estimate_mcodec_size(const Image& im, int quality) {
+    if (im.channels != 1) throw std::runtime_error("estimate: only grayscale is supported");
+    if (im.width <= 0 || im.height <= 0) throw std::runtime_error("estimate: invalid image size");
+    if (static_cast<int>(im.pixels.size()) != im.width * im.height) throw std::runtime_error("estimate: buffer size mismatch");
+    MCODEC_TRACE_SCOPE("estimate");
+    return estimate_samples(im.pixels.data(), im.width, im.height,
+                            level_shift_offset(im.bits_stored, im.is_signed), quality);
+}
+
+uint64_t estimate_mcodec_size(const PixelView& src, int quality) {
+    if (!src.data) throw std::runtime_error("estimate: null pixel buffer");
+    if (src.width <= 0 || src.height <= 0) throw std::runtime_error("estimate: invalid image size");
+    MCODEC_TRACE_SCOPE("estimate");
+    const int32_t offset = level_shift_offset(src.bits_stored, src.is_signed);
+    switch (src.type) {
+    case PixelType::U8:
+        return estimate_samples(static_cast<const uint8_t*>(src.data), src.width, src.height, offset, quality);
+    case PixelType::U16:
+        return estimate_samples(static_cast<const uint16_t*>(src.data), src.width, src.height, offset, quality);
+    case PixelType::S16:
+        return estimate_samples(static_cast<const int16_t*>(src.data), src.width, src.height, offset, quality);
+    default:
+        throw std::runtime_error("estimate: unsupported pixel type");
+    }
+}
+
+uint64_t estimate_mcodec_size(const EncoderFrontEnd& fe, int quality) {
+    const float inv_step = inverse_step(quality);
+    if (fe.grid.block_size != kN || fe.coeffs.empty() || fe.coeffs.size() % kBlockElems != 0 ||
+        (!fe.flat.empty() && fe.flat.size() != fe.coeffs.size() / kBlockElems)) {
+        throw std::runtime_error("estimate: invalid front end");
+    }
+    MCODEC_TRACE_SCOPE("estimate");
+    SymbolCounter counter;
+    int16_t q[kBlockElems];
+    for (size_t b = 0; b < fe.coeffs.size(); b += kBlockElems) {
+        if (!fe.flat.empty() && fe.flat[b / kBlockElems] != kNotFlat) {
+            counter.add_skip(fe.flat[b / kBlockElems]);
+            continue;
+        }
+        quantize_block<true>(fe.coeffs.data() + b, inv_step, q);
+        counter.add_block(q);
+    }
+    return counter.stream_bytes();
+}
+
+} // namespace mcodec
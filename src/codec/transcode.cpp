@@ -0,0 +1,33 @@
+#include "codec/transcode.hpp"
+
+#include "codec/decoder.hpp"
+#include "codec/encoder.hpp"
+#include "entropy/bitstream.hpp"
+#include "quant/quantizer.hpp"
+#include "util/trace.hpp"
+
+#include <stdexcept>
+
+namespace mcodec {
+
+void TranscodeSession::transcode(const std::vector<uint8_t>& bytes, int quality, std::vector<uint8_t>& out) {
+    if (quality < 1 || quality > 100) throw std::runtime_error("transcode: quality out of range 1..100");
+    MCODEC_TRACE_SCOPE("transcode");
+    if (read_bitstream_header(bytes).quality == quality) {
+        out.assign(bytes.begin(), bytes.end());
+        return;
+    }
+    // requantization is scalar, so it runs on the zigzag scan as is
+    dec_.decode_quantized_scan(bytes, scan_);
+    requantize(scan_.scan, scan_.quality, quality);
+    scan_.quality = quality;
+    enc_.encode(scan_, out);
+}
+
+std::vector<uint8_t> transcode_mcodec(const std::vector<uint8_t>& bytes, int quality) {
+    std::vector<uint8_t> out;
+    TranscodeSession().transcode(bytes, quality, out);
+    return out;
+}
+
+} // namespace mcodec
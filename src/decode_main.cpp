@@ -1,38 +1,67 @@
+#include "cli/cli_output.hpp"
 #include "cli/cli_parser.hpp"
 #include "codec/decoder.hpp"
 #include "io/medical_saver.hpp"
+#include "io/stream_io.hpp"
 
 #include <algorithm>
-#include <fstream>
 #include <iostream>
 #include <numeric>
 
-static std::vector<uint8_t> read_all(const std::string& path) {
-    std::ifstream ifs(path, std::ios::binary);
-    if (!ifs.good()) throw std::runtime_error("Cannot open file: " + path);
-    ifs.seekg(0, std::ios::end);
-    std::streamsize n = ifs.tellg();
-    ifs.seekg(0, std::ios::beg);
-    std::vector<uint8_t> buf(static_cast<size_t>(n));
-    ifs.read(reinterpret_cast<char*>(buf.data()), n);
-    return buf;
-}
-
 int main(int argc, char** argv) {
     try {
         mcodec::CliParser cli;
         cli.parse(argc, argv);
         const std::string in = cli.get("in");
         const std::string out = cli.get("out");
+        mcodec::set_status_to_stderr(mcodec::is_stdio_path(out));
         if (in.empty() || out.empty()) {
-            std::cerr << "Usage: decode --in <input.mcodec> --out <output.pgm>\n";
+            std::cerr << "Usage: decode --in <input.mcodec|-> --out <output.pgm|-> [--layers N] [--stats [file]] [--trace <trace.json>]\n"
+                         "       decode --in <input.mcodec|-> --out <output.pgm|-> --window <center>,<width> [--layers N]\n"
+                         "       (--window in stored sample values, not HU: center = (HU - intercept) / slope,\n"
+                         "        width = HU width / slope; e.g. HU 40/400 with intercept -1024 is --window 1064,400)\n"
+                         "       (slices of encode --shared-tables: add --tables <series.mtab>)\n";
             return 1;
         }
 
-        auto bytes = read_all(in);
-        auto im = mcodec::decode_from_mcodec(bytes);
+        // decode_display has no per-stage instrumentation
+        if (cli.has("stats") && cli.has("window")) throw std::runtime_error("--stats: not available with --window");
+
+        const mcodec::CliTrace trace(cli.get("trace"));
+
+        auto bytes = mcodec::read_input(in);
+        // --layers N: decode only the first N quality layers (preview tier)
+        const std::string layers = cli.get("layers");
+        if (!layers.empty()) bytes = mcodec::truncate_layers(bytes, std::stoi(layers));
+        // --tables: series table file of a slice written by encode --shared-tables
+        mcodec::DecoderSession session;
+        const std::string tables = cli.get("tables");
+        if (!tables.empty()) session.set_series_tables(mcodec::read_series_tables(mcodec::read_input(tables)));
+        // --window c,w: 8-bit display PGM straight from the decoder
+        const std::string window = cli.get("window");
+        if (!window.empty()) {
+            mcodec::DisplayWindow w;
+            const size_t comma = window.find(',');
+            try {
+                if (comma == std::string::npos) throw std::invalid_argument("window");
+                w.center = std::stod(window.substr(0, comma));
+                w.width = std::stod(window.substr(comma + 1));
+            } catch (...) {
+                throw std::runtime_error("--window: expected <center>,<width> in stored values, e.g. 1064,400");
+            }
+            mcodec::DisplayImage display;
+            session.decode_display(bytes, w, display);
+            mcodec::save_pgm(out, display);
+            mcodec::status_out() << "Wrote: " << out << " (window " << w.center << "/" << w.width << ")\n";
+            return 0;
+        }
+        mcodec::DecodeStats stats;
+        mcodec::Image im;
+        session.decode(bytes, im, stats);
         mcodec::save_pgm(out, im);
-        std::cout << "Wrote: " << out << "\n";
+        mcodec::status_out() << "Wrote: " << out << "\n";
+        if (stats.layers > 1 || !layers.empty()) mcodec::status_out() << "Layers: " << stats.layers << "\n";
+        if (cli.has("stats")) mcodec::emit_stats(cli.get("stats"), mcodec::to_json(stats));
         return 0;
     } catch (const std::exception& e) {
         std::cerr << "[ERROR] " << e.what() << "\n";
@@ -1,14 +1,148 @@
+#include "cli/cli_output.hpp"
 #include "cli/cli_parser.hpp"
 #include "io/medical_loader.hpp"
+#include "io/series_index.hpp"
+#include "codec/decoder.hpp"
 #include "codec/encoder.hpp"
+#include "codec/predictive.hpp"
+#include "io/stream_io.hpp"
+#include "util/parallel.hpp"
 
-#include <fstream>
+#include <algorithm>
+#include <filesystem>
 #include <iostream>
 
-static void write_all(const std::string& path, const std::vector<uint8_t>& bytes) {
-    std::ofstream ofs(path, std::ios::binary);
-    if (!ofs.good()) throw std::runtime_error("Cannot write file: " + path);
-    ofs.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+static const char* const kUsage =
+    "Usage: encode --in <input.dicom|-> --out <output.mcodec|-> --quality <1..100> [--stats [file]] [--trace <trace.json>]\n"
+    "       encode --in <input.dicom|-> --out <output.mcodec|-> --layers q1,q2,...\n"
+    "       encode --in <input.dicom|-> --out <output.mcodec|-> --lossless | --near <k>\n"
+    "       encode --in <multi-frame.dicom|series dir> --out <output.mcodec> --quality <1..100> --shared-tables [max_penalty]\n";
+
+// "<dir>/<stem>_f0003<ext>" for frame 3 of a multi-frame input.
+static std::string frame_output_path(const std::string& out, int frame) {
+    namespace fs = std::filesystem;
+    const fs::path p(out);
+    char suffix[16];
+    std::snprintf(suffix, sizeof(suffix), "_f%04d", frame);
+    return (p.parent_path() / (p.stem().string() + suffix + p.extension().string())).string();
+}
+
+// Number of frames if `in` is a multi-frame DICOM file, else 1 (stdin: first frame only).
+static int input_frame_count(const std::string& in) {
+    namespace fs = std::filesystem;
+    if (mcodec::is_stdio_path(in) || fs::is_directory(in)) return 1;
+    const std::string ext = fs::path(in).extension().string();
+    if (ext == ".pgm" || ext == ".PGM") return 1;
+    try {
+        return mcodec::dicom_frame_count(in);
+    } catch (...) {
+        return 1; // let load_medical report the real error
+    }
+}
+
+// Multi-frame DICOM: one .mcodec per frame, frames encoded in parallel.
+// Each worker owns a DicomFrameReader, so only one frame per worker is in memory,
+// and the frame is coded straight from the reader's buffer (never widened to int32).
+// near >= 0: (near-)lossless predictive engine instead of the DCT path at `quality`.
+// stats_dest non-empty (DCT path only): --stats as a JSON array, one object per frame.
+static void encode_frames(const std::string& in, const std::string& out, int quality, int near, int frames,
+                          const std::string& stats_dest) {
+    const unsigned workers = std::min<unsigned>(mcodec::default_thread_count(), static_cast<unsigned>(frames));
+    std::vector<size_t> sizes(static_cast<size_t>(frames), 0);
+    std::vector<mcodec::EncodeStats> stats(stats_dest.empty() ? 0 : static_cast<size_t>(frames));
+    mcodec::parallel_for(workers, [&](size_t w) {
+        mcodec::DicomFrameReader reader(in);
+        for (int f = static_cast<int>(w); f < frames; f += static_cast<int>(workers)) {
+            mcodec::EncodeStats frame_stats;
+            auto bytes = near >= 0 ? mcodec::encode_near_lossless_mcodec(reader.frame_view(f), near)
+                                   : mcodec::encode_to_mcodec(reader.frame_view(f), quality, frame_stats);
+            if (!stats.empty()) stats[static_cast<size_t>(f)] = frame_stats;
+            mcodec::write_output(frame_output_path(out, f), bytes);
+            sizes[static_cast<size_t>(f)] = bytes.size();
+        }
+    }, workers);
+
+    size_t total = 0;
+    for (size_t n : sizes) total += n;
+    mcodec::status_out() << "Frames: " << frames << "\n";
+    mcodec::status_out() << "Wrote: " << frame_output_path(out, 0) << " .. " << frame_output_path(out, frames - 1)
+              << " (" << total << " bytes total)\n";
+    if (!stats.empty()) {
+        std::string json = "[";
+        for (size_t f = 0; f < stats.size(); ++f) json += (f ? ",\n" : "\n") + mcodec::to_json(stats[f]);
+        mcodec::emit_stats(stats_dest, json + "\n]");
+    }
+}
+
+// "<dir>/<stem>.mtab": series table file next to the frames of `out`.
+static std::string table_file_path(const std::string& out) {
+    return std::filesystem::path(out).replace_extension(".mtab").string();
+}
+
+// --shared-tables: the frames of a multi-frame file, or the slices of a series folder in
+// index order, coded in sequence by one SeriesEncoder (shared Huffman tables) into one
+// .mcodec per frame plus the series table file.
+static void encode_series(const std::string& in, const std::string& out, int quality, double max_penalty) {
+    namespace fs = std::filesystem;
+    mcodec::SeriesEncoder enc(quality, max_penalty);
+    std::vector<uint8_t> bytes;
+    size_t total = 0;
+    int frames = 0;
+    const auto put = [&](int f) {
+        mcodec::write_output(frame_output_path(out, f), bytes);
+        total += bytes.size();
+    };
+    if (fs::is_directory(in)) {
+        const mcodec::SeriesIndex index = mcodec::index_dicom_series(in);
+        for (const mcodec::SeriesEntry& e : index.entries) {
+            enc.encode(mcodec::load_medical(e.path), bytes);
+            put(frames++);
+        }
+    } else {
+        mcodec::DicomFrameReader reader(in);
+        frames = reader.frame_count();
+        for (int f = 0; f < frames; ++f) {
+            enc.encode(reader.frame_view(f), bytes);
+            put(f);
+        }
+    }
+    if (frames == 0) throw std::runtime_error("--shared-tables: no image in " + in);
+    const std::vector<uint8_t> tables = mcodec::write_series_tables(enc.tables());
+    mcodec::write_output(table_file_path(out), tables);
+
+    mcodec::status_out() << "Frames: " << frames << " (" << enc.reused() << " reuse an earlier table)\n";
+    mcodec::status_out() << "Wrote: " << frame_output_path(out, 0) << " .. " << frame_output_path(out, frames - 1)
+              << " (" << total << " bytes total)\n";
+    mcodec::status_out() << "Wrote: " << table_file_path(out) << " (" << enc.tables().tables.size() << " tables, "
+              << tables.size() << " bytes)\n";
+}
+
+// --layers "20,60,95": strictly increasing qualities of a layered stream.
+static std::vector<int> parse_layer_qualities(const std::string& s) {
+    std::vector<int> out;
+    size_t pos = 0;
+    while (pos <= s.size()) {
+        const size_t comma = std::min(s.find(',', pos), s.size());
+        out.push_back(std::stoi(s.substr(pos, comma - pos)));
+        pos = comma + 1;
+    }
+    return out;
+}
+
+static void encode_layered(const std::string& in, const std::string& out, const std::string& layers) {
+    std::vector<int> qualities;
+    try {
+        qualities = parse_layer_qualities(layers);
+    } catch (...) {
+        throw std::runtime_error("--layers: expected comma-separated qualities, e.g. 20,60,95");
+    }
+    auto im = mcodec::load_medical(in);
+    auto bytes = mcodec::encode_layered_mcodec(im, qualities);
+    mcodec::write_output(out, bytes);
+    mcodec::status_out() << "Wrote: " << out << " (" << bytes.size() << " bytes, " << qualities.size() << " layers)\n";
+    for (const auto& l : mcodec::mcodec_layers(bytes)) {
+        mcodec::status_out() << "  q" << l.quality << ": bytes " << l.begin << ".." << l.end << "\n";
+    }
 }
 
 int main(int argc, char** argv) {
@@ -18,28 +152,72 @@ int main(int argc, char** argv) {
         const std::string in = cli.get("in");
         const std::string out = cli.get("out");
         const std::string quality_str = cli.get("quality");
-        if (in.empty() || out.empty() || quality_str.empty()) {
-            std::cout << "Usage: encode --in <input.dicom> --out <output.mcodec> --quality <1..100>\n";
+        const std::string layers = cli.get("layers");
+        const std::string near_str = cli.get("near");
+        const bool predictive = cli.has("lossless") || !near_str.empty();
+        const bool out_is_stdout = mcodec::is_stdio_path(out);
+        mcodec::set_status_to_stderr(out_is_stdout);
+        // Only the DCT path (--quality) fills EncodeStats
+        const std::string stats_dest = cli.has("stats") ? cli.get("stats") : std::string();
+        if (!stats_dest.empty() && (!layers.empty() || predictive || cli.has("shared-tables"))) {
+            throw std::runtime_error("--stats: only with --quality, not with --layers, --lossless, --near or --shared-tables");
+        }
+        if (in.empty() || out.empty() || (quality_str.empty() && !predictive && layers.empty())) {
+            std::cout << kUsage;
             return 1;
         }
         int quality = 0;
-        try {
-            quality = std::stoi(quality_str);
-        } catch (...) {
-            std::cout << "Usage: encode --in <input.dicom> --out <output.mcodec> --quality <1..100>\n";
-            return 1;
+        int near = -1; // >= 0: --lossless (0) / --near k
+        if (layers.empty()) {
+            try {
+                if (predictive) near = near_str.empty() ? 0 : std::stoi(near_str);
+                else quality = std::stoi(quality_str);
+            } catch (...) {
+                std::cout << kUsage;
+                return 1;
+            }
+            if (predictive ? near < 0 : (quality < 1 || quality > 100)) {
+                std::cout << kUsage;
+                return 1;
+            }
         }
-        if (quality < 1 || quality > 100) {
-            std::cout << "Usage: encode --in <input.dicom> --out <output.mcodec> --quality <1..100>\n";
-            return 1;
+
+        const mcodec::CliTrace trace(cli.get("trace"));
+        if (!layers.empty()) {
+            encode_layered(in, out, layers);
+            return 0;
         }
+        if (cli.has("shared-tables")) {
+            if (predictive || out_is_stdout || mcodec::is_stdio_path(in)) {
+                throw std::runtime_error("--shared-tables: needs --quality and file paths for --in / --out");
+            }
+            const std::string penalty_str = cli.get("shared-tables");
+            double penalty = 0.01;
+            try {
+                if (penalty_str != "true") penalty = std::stod(penalty_str);
+            } catch (...) {
+                throw std::runtime_error("--shared-tables: expected a penalty fraction, e.g. 0.01");
+            }
+            encode_series(in, out, quality, penalty);
+            return 0;
+        }
+
+        const int frames = input_frame_count(in);
+        if (frames > 1) {
+            if (out_is_stdout) throw std::runtime_error("multi-frame input writes one file per frame; --out - is not supported");
+            encode_frames(in, out, quality, near, frames, stats_dest);
+            return 0;
+        }
+
         auto im = mcodec::load_medical(in);
-        auto bytes = mcodec::encode_to_mcodec(im, quality);
-        write_all(out, bytes);
+        mcodec::EncodeStats stats;
+        auto bytes = predictive ? mcodec::encode_near_lossless_mcodec(im, near) : mcodec::encode_to_mcodec(im, quality, stats);
+        mcodec::write_output(out, bytes);
         
         const size_t raw_size = static_cast<size_t>(im.width) * static_cast<size_t>(im.height) * (static_cast<size_t>(im.bits_allocated) / 8);
-        std::cout << "input file size: " << raw_size << " bytes\n";
-        std::cout << "Wrote: " << out << " (" << bytes.size() << " bytes)\n";
+        mcodec::status_out() << "input file size: " << raw_size << " bytes\n";
+        mcodec::status_out() << "Wrote: " << out << " (" << bytes.size() << " bytes)\n";
+        if (!stats_dest.empty()) mcodec::emit_stats(stats_dest, mcodec::to_json(stats));
         return 0;
     } catch (const std::exception& e) {
         std::cerr << "[ERROR] " << e.what() << "\n";
@@ -23,7 +23,8 @@ void write_bitstream_header(ByteWriter& w,
                             const Image& im,
                             uint8_t flags,
                             uint16_t block_size,
-                            uint16_t quality) {
+                            uint16_t quality,
+                            uint16_t header_bytes) {
     MCodecHeader hdr{};
     // "MCDC"
     hdr.magic[0] = 'M';
@@ -31,7 +32,7 @@ void write_bitstream_header(ByteWriter& w,
     hdr.magic[2] = 'D';
     hdr.magic[3] = 'C';
     hdr.version = 1;
-    hdr.header_bytes = kMCodecHeaderBytes;
+    hdr.header_bytes = header_bytes;
 
     hdr.width = static_cast<uint32_t>(im.width);
     hdr.height = static_cast<uint32_t>(im.height);
@@ -39,7 +40,7 @@ void write_bitstream_header(ByteWriter& w,
     hdr.bits_allocated = static_cast<uint16_t>(im.bits_allocated);
     hdr.bits_stored = static_cast<uint16_t>(im.bits_stored);
     hdr.is_signed = static_cast<uint8_t>(im.is_signed ? 1 : 0);
-    hdr.flags = flags; // bit0 = RLE (payload encoding)
+    hdr.flags = flags; // kFlag* bits
     hdr.block_size = block_size;
     hdr.quality = quality;
     hdr.payload_bytes = 0; // patch later by caller
@@ -89,6 +90,91 @@ MCodecHeader read_bitstream_header(const std::vector<uint8_t>& bytes) {
     return hdr;
 }
 
+void read_layer_index(const std::vector<uint8_t>& bytes, const MCodecHeader& hdr, std::vector<LayerEntry>& out) {
+    out.clear();
+    if ((hdr.flags & kFlagLayered) == 0) {
+        out.push_back({hdr.quality, 0u, hdr.payload_bytes});
+        return;
+    }
+    const uint16_t count = read_u16_le_at(bytes, kMCodecHeaderBytes);
+    if (count == 0 || count > kMaxLayers) throw std::runtime_error("decode: invalid layer count");
+    if (hdr.header_bytes != kMCodecHeaderBytes + 4u + 8u * count) {
+        throw std::runtime_error("decode: header_bytes does not match the layer index");
+    }
+    uint32_t begin = 0;
+    for (uint16_t k = 0; k < count; ++k) {
+        const size_t off = kMCodecHeaderBytes + 4u + 8u * k;
+        const uint16_t quality = read_u16_le_at(bytes, off);
+        const uint32_t end = read_u32_le_at(bytes, off + 4);
+        if (quality < 1 || quality > 100 || (k > 0 && quality <= out.back().quality)) {
+            throw std::runtime_error("decode: layer qualities must increase within 1..100");
+        }
+        if (end <= begin || end > hdr.payload_bytes) throw std::runtime_error("decode: invalid layer offset");
+        out.push_back({quality, begin, end});
+        begin = end;
+    }
+    if (begin != hdr.payload_bytes || out.back().quality != hdr.quality) {
+        throw std::runtime_error("decode: layer index does not match the header");
+    }
+}
+
+std::vector<uint8_t> write_series_tables(const SeriesTables& t) {
+    ByteWriter w;
+    w.write_bytes("MTAB", 4);
+    w.write_u16_le(1);
+    w.write_u16_le(0);
+    w.write_u32_le(static_cast<uint32_t>(t.tables.size()));
+    for (const auto& table : t.tables) {
+        if (table.empty()) throw std::runtime_error("series tables: empty table");
+        w.write_u32_le(static_cast<uint32_t>(table.size()));
+        for (const auto& [sym, len] : table) {
+            w.write_u32_le(sym);
+            w.write_u8(len);
+        }
+    }
+    return w.release();
+}
+
+SeriesTables read_series_tables(const std::vector<uint8_t>& bytes) {
+    ByteReader r(bytes.data(), bytes.size());
+    char magic[4];
+    r.read_bytes(magic, 4);
+    if (std::memcmp(magic, "MTAB", 4) != 0) throw std::runtime_error("series tables: bad magic");
+    if (r.read_u16_le() != 1) throw std::runtime_error("series tables: unsupported version");
+    r.read_u16_le();
+    const uint32_t count = r.read_u32_le();
+    if (count > r.remaining() / 9u) throw std::runtime_error("series tables: table count exceeds file size");
+    SeriesTables t;
+    t.tables.resize(count);
+    for (auto& table : t.tables) {
+        const uint32_t used = r.read_u32_le();
+        if (used == 0 || used > r.remaining() / 5u) throw std::runtime_error("series tables: invalid table size");
+        table.reserve(used);
+        for (uint32_t i = 0; i < used; ++i) {
+            const uint32_t sym = r.read_u32_le();
+            const uint8_t len = r.read_u8();
+            if (len == 0 || len > 32) throw std::runtime_error("series tables: invalid code length");
+            table.push_back({sym, len});
+        }
+    }
+    if (!r.eof()) throw std::runtime_error("series tables: trailing bytes");
+    return t;
+}
+
+uint32_t series_table_hash(const std::vector<std::pair<uint32_t, uint8_t>>& table) {
+    uint32_t h = 2166136261u;
+    const auto mix = [&h](uint32_t v, int bytes) {
+        for (int i = 0; i < bytes; ++i) {
+            h = (h ^ ((v >> (8 * i)) & 0xFFu)) * 16777619u;
+        }
+    };
+    for (const auto& [sym, len] : table) {
+        mix(sym, 4);
+        mix(len, 1);
+    }
+    return h;
+}
+
 void write_payload(ByteWriter& w, const uint8_t* data, size_t bytes) {
     if (!data && bytes != 0) throw std::runtime_error("bitstream: write_payload null data");
     w.write_bytes(data, bytes);
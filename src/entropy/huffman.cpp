@@ -1,6 +1,7 @@
 #include "entropy/huffman.hpp"
 
 #include <algorithm>
+#include <cmath>
 #include <cstdint>
 #include <limits>
 #include <queue>
@@ -76,11 +77,11 @@ private:
 // ---------------- BitReader ---------------- //
 class BitReader {
 public:
-    explicit BitReader(const std::vector<uint8_t>& buf)
-        : data_(buf) {}
+    BitReader(const uint8_t* data, size_t size)
+        : data_(data), size_(size) {}
 
     bool read_bit() {
-        if (byte_idx_ >= data_.size()) {
+        if (byte_idx_ >= size_) {
             throw std::runtime_error("BitReader: out of data");
         }
         uint8_t byte = data_[byte_idx_];
@@ -94,11 +95,66 @@ public:
     }
 
 private:
-    const std::vector<uint8_t>& data_;
+    const uint8_t* data_;
+    size_t size_;
     size_t byte_idx_{0};
     uint8_t bit_pos_{0};
 };
 
+namespace {
+
+// Walk the decode tree once per symbol.
+void decode_with_tree(const std::vector<HuffTable::Node>& nodes,
+                      const uint8_t* bits,
+                      size_t size,
+                      size_t symbol_count,
+                      std::vector<uint32_t>& out) {
+    BitReader br(bits, size);
+    out.clear();
+    out.reserve(symbol_count);
+    for (size_t n = 0; n < symbol_count; ++n) {
+        int node = 0;
+        while (true) {
+            if (node < 0 || static_cast<size_t>(node) >= nodes.size()) {
+                throw std::runtime_error("huffman decode: invalid node");
+            }
+            const auto& nd = nodes[node];
+            if (nd.symbol != -1) {
+                out.push_back(static_cast<uint32_t>(nd.symbol));
+                break;
+            }
+            bool bit = br.read_bit();
+            node = bit ? nd.right : nd.left;
+            if (node == -1) {
+                throw std::runtime_error("huffman decode: reached null child");
+            }
+        }
+    }
+}
+
+// Insert one canonical code into a decode tree (nodes[0] is the root).
+void insert_code(std::vector<HuffTable::Node>& nodes, uint32_t symbol, uint32_t code, uint8_t len,
+                 const char* duplicate_error) {
+    int node_idx = 0;
+    for (int i = len - 1; i >= 0; --i) {
+        uint32_t bit = (code >> i) & 1u;
+        int next = (bit == 0) ? nodes[node_idx].left : nodes[node_idx].right;
+        if (next == -1) {
+            next = static_cast<int>(nodes.size());
+            nodes.push_back({-1, -1, -1});
+            if (bit == 0) nodes[node_idx].left = next;
+            else nodes[node_idx].right = next;
+        }
+        node_idx = next;
+    }
+    if (nodes[node_idx].symbol != -1) {
+        throw std::runtime_error(duplicate_error);
+    }
+    nodes[node_idx].symbol = static_cast<int>(symbol);
+}
+
+} // namespace
+
 // Internal node used during build
 struct HeapNode {
     uint32_t freq;
@@ -252,22 +308,7 @@ HuffTable build_canonical_table(const std::vector<std::pair<uint32_t, uint32_t>>
         t.enc[ce.symbol] = {ce.code, ce.len, true};
 
         // decode tree insert
-        int node_idx = 0;
-        for (int i = ce.len - 1; i >= 0; --i) {
-            uint32_t bit = (ce.code >> i) & 1u;
-            int next = (bit == 0) ? t.decode_nodes[node_idx].left : t.decode_nodes[node_idx].right;
-            if (next == -1) {
-                next = static_cast<int>(t.decode_nodes.size());
-                t.decode_nodes.push_back({-1, -1, -1});
-                if (bit == 0) t.decode_nodes[node_idx].left = next;
-                else t.decode_nodes[node_idx].right = next;
-            }
-            node_idx = next;
-        }
-        if (t.decode_nodes[node_idx].symbol != -1) {
-            throw std::runtime_error("huffman: duplicate code assignment");
-        }
-        t.decode_nodes[node_idx].symbol = static_cast<int>(ce.symbol);
+        insert_code(t.decode_nodes, ce.symbol, ce.code, ce.len, "huffman: duplicate code assignment");
     }
 
     return t;
@@ -316,23 +357,7 @@ HuffTable build_table_from_code_lengths(const std::vector<std::pair<uint32_t, ui
     t.decode_nodes.push_back({-1, -1, -1}); // root
     for (const auto& ce : canon) {
         t.enc[ce.symbol] = {ce.code, ce.len, true};
-
-        int node_idx = 0;
-        for (int i = ce.len - 1; i >= 0; --i) {
-            uint32_t bit = (ce.code >> i) & 1u;
-            int next = (bit == 0) ? t.decode_nodes[node_idx].left : t.decode_nodes[node_idx].right;
-            if (next == -1) {
-                next = static_cast<int>(t.decode_nodes.size());
-                t.decode_nodes.push_back({-1, -1, -1});
-                if (bit == 0) t.decode_nodes[node_idx].left = next;
-                else t.decode_nodes[node_idx].right = next;
-            }
-            node_idx = next;
-        }
-        if (t.decode_nodes[node_idx].symbol != -1) {
-            throw std::runtime_error("decode: duplicate code assignment");
-        }
-        t.decode_nodes[node_idx].symbol = static_cast<int>(ce.symbol);
+        insert_code(t.decode_nodes, ce.symbol, ce.code, ce.len, "decode: duplicate code assignment");
     }
     return t;
 }
@@ -362,26 +387,386 @@ void huff_decode(const std::vector<uint8_t>& bits,
                  const HuffTable& t,
                  size_t symbol_count,
                  std::vector<uint32_t>& out) {
-    BitReader br(bits);
+    decode_with_tree(t.decode_nodes, bits.data(), bits.size(), symbol_count, out);
+}
+
+// ---------------- HuffmanEncoder ---------------- //
+
+uint32_t HuffmanEncoder::slot_of(uint32_t symbol) {
+    if ((distinct_.size() + 1) * 2 > hash_keys_.size()) {
+        // keep the load factor <= 1/2: double and reinsert the distinct symbols seen so far
+        const size_t cap = hash_keys_.size() * 2;
+        hash_keys_.assign(cap, 0u);
+        hash_slots_.assign(cap, 0u);
+        --hash_shift_;
+        for (uint32_t k = 0; k < distinct_.size(); ++k) {
+            size_t h = static_cast<size_t>((distinct_[k] * 0x9E3779B1u) >> hash_shift_);
+            while (hash_slots_[h] != 0) h = (h + 1) & (cap - 1);
+            hash_keys_[h] = distinct_[k];
+            hash_slots_[h] = k + 1;
+        }
+    }
+    const size_t mask = hash_keys_.size() - 1;
+    size_t h = static_cast<size_t>((symbol * 0x9E3779B1u) >> hash_shift_);
+    while (true) {
+        const uint32_t s = hash_slots_[h];
+        if (s == 0) {
+            const uint32_t slot = static_cast<uint32_t>(distinct_.size());
+            hash_keys_[h] = symbol;
+            hash_slots_[h] = slot + 1;
+            distinct_.push_back(symbol);
+            freq_.push_back(0);
+            return slot;
+        }
+        if (hash_keys_[h] == symbol) return s - 1;
+        h = (h + 1) & mask;
+    }
+}
+
+void HuffmanEncoder::reset_counts() {
+    if (hash_keys_.empty()) {
+        hash_keys_.assign(size_t{1} << 12, 0u);
+        hash_slots_.assign(size_t{1} << 12, 0u);
+        hash_shift_ = 32 - 12;
+    } else {
+        std::fill(hash_slots_.begin(), hash_slots_.end(), 0u);
+    }
+    distinct_.clear();
+    freq_.clear();
+    sym_slot_.clear();
+}
+
+void HuffmanEncoder::count(uint32_t symbol, uint32_t n) {
+    const uint32_t slot = slot_of(symbol);
+    if (freq_[slot] > std::numeric_limits<uint32_t>::max() - n) {
+        throw std::runtime_error("huffman: frequency overflow");
+    }
+    freq_[slot] += n;
+}
+
+void HuffmanEncoder::build_lengths() {
+    if (distinct_.empty()) {
+        throw std::runtime_error("huffman encode: empty symbols");
+    }
+    build_code();
+}
+
+void HuffmanEncoder::build(const std::vector<uint32_t>& symbols) {
+    if (symbols.empty()) {
+        throw std::runtime_error("huffman encode: empty symbols");
+    }
+    reset_counts();
+
+    // Frequencies
+    sym_slot_.resize(symbols.size());
+    for (size_t i = 0; i < symbols.size(); ++i) {
+        const uint32_t slot = slot_of(symbols[i]);
+        if (freq_[slot] == std::numeric_limits<uint32_t>::max()) {
+            throw std::runtime_error("huffman: frequency overflow");
+        }
+        ++freq_[slot];
+        sym_slot_[i] = slot;
+    }
+    build_code();
+}
+
+bool HuffmanEncoder::build_from_table(const std::vector<uint32_t>& symbols,
+                                      const std::vector<std::pair<uint32_t, uint8_t>>& table) {
+    if (symbols.empty()) {
+        throw std::runtime_error("huffman encode: empty symbols");
+    }
+    reset_counts();
+
+    // Table symbols take slots 0..table.size()-1, so slot k codes with table[k]
+    code_.resize(table.size());
+    code_len_.resize(table.size());
+    coded_slots_ = table.size();
+    escape_slot_ = static_cast<uint32_t>(table.size()); // none
+    uint32_t code = 0;
+    uint8_t prev_len = table.empty() ? 0 : table.front().second;
+    for (size_t k = 0; k < table.size(); ++k) {
+        const auto [sym, len] = table[k];
+        if (len == 0 || len > 32 || len < prev_len || slot_of(sym) != k) {
+            throw std::runtime_error("huffman encode: table is not a canonical code length list");
+        }
+        code <<= (len - prev_len);
+        prev_len = len;
+        code_[k] = code++;
+        code_len_[k] = len;
+        if (sym == kHuffEscapeSymbol) escape_slot_ = static_cast<uint32_t>(k);
+    }
+
+    // Frequencies; a slot past the table is a symbol the table has no code for
+    sym_slot_.resize(symbols.size());
+    for (size_t i = 0; i < symbols.size(); ++i) {
+        const uint32_t slot = slot_of(symbols[i]);
+        if (freq_[slot] == std::numeric_limits<uint32_t>::max()) {
+            throw std::runtime_error("huffman: frequency overflow");
+        }
+        ++freq_[slot];
+        sym_slot_[i] = slot;
+    }
+    escaped_ = 0;
+    for (size_t k = table.size(); k < distinct_.size(); ++k) escaped_ += freq_[k];
+    if (escaped_ != 0 && escape_slot_ == table.size()) return false;
+
+    lengths_.assign(table.begin(), table.end());
+    payload_bits_ = escaped_ * (code_len_.empty() ? 0u : code_len_[escape_slot_] + 32u);
+    for (size_t k = 0; k < table.size(); ++k) {
+        payload_bits_ += static_cast<uint64_t>(freq_[k]) * code_len_[k];
+    }
+    return true;
+}
+
+void HuffmanEncoder::frequencies(std::vector<std::pair<uint32_t, uint32_t>>& out) const {
+    out.clear();
+    for (size_t k = 0; k < distinct_.size(); ++k) {
+        if (freq_[k] != 0) out.push_back({distinct_[k], freq_[k]});
+    }
+}
+
+double HuffmanEncoder::entropy_bits() const {
+    double n = 0.0;
+    for (uint32_t f : freq_) n += f;
+    double bits = 0.0;
+    for (uint32_t f : freq_) {
+        if (f != 0) bits += f * std::log2(n / f);
+    }
+    return bits;
+}
+
+// Tree, code lengths and canonical codes from distinct_ / freq_.
+void HuffmanEncoder::build_code() {
+    // Huffman tree with the same (freq, symbol) order as build_canonical_table,
+    // which fixes the tree and so the code lengths.
+    const auto later = [](const HeapNode& a, const HeapNode& b) {
+        if (a.freq != b.freq) return a.freq > b.freq;
+        return a.symbol > b.symbol;
+    };
+    heap_.clear();
+    nodes_.clear();
+    lens_.clear();
+    for (uint32_t k = 0; k < distinct_.size(); ++k) {
+        heap_.push_back({freq_[k], distinct_[k], -1, static_cast<int>(k)});
+    }
+    if (heap_.size() == 1) {
+        lens_.push_back({distinct_[0], 0u, 1u});
+    } else {
+        std::make_heap(heap_.begin(), heap_.end(), later);
+        while (heap_.size() > 1) {
+            std::pop_heap(heap_.begin(), heap_.end(), later);
+            const HeapNode a = heap_.back();
+            heap_.pop_back();
+            std::pop_heap(heap_.begin(), heap_.end(), later);
+            const HeapNode b = heap_.back();
+            heap_.pop_back();
+            const int left = static_cast<int>(nodes_.size());
+            nodes_.push_back(a);
+            nodes_.push_back(b);
+            heap_.push_back({a.freq + b.freq, std::min(a.symbol, b.symbol), left, left + 1});
+            std::push_heap(heap_.begin(), heap_.end(), later);
+        }
+
+        // Code lengths by DFS (-1 is the root)
+        const HeapNode root = heap_.front();
+        stack_.clear();
+        stack_.push_back({-1, 0});
+        while (!stack_.empty()) {
+            const auto [idx, depth] = stack_.back();
+            stack_.pop_back();
+            const HeapNode cur = (idx == -1) ? root : nodes_[static_cast<size_t>(idx)];
+            if (cur.left == -1) {
+                lens_.push_back({cur.symbol, static_cast<uint32_t>(cur.right), depth});
+                continue;
+            }
+            if (depth >= 32) {
+                throw std::runtime_error("huffman: code length exceeds 32");
+            }
+            stack_.push_back({cur.right, static_cast<uint8_t>(depth + 1)});
+            stack_.push_back({cur.left, static_cast<uint8_t>(depth + 1)});
+        }
+    }
+
+    // Canonical codes, (len asc, symbol asc)
+    std::sort(lens_.begin(), lens_.end(), [](const LenEntry& a, const LenEntry& b) {
+        if (a.len != b.len) return a.len < b.len;
+        return a.symbol < b.symbol;
+    });
+    code_.resize(distinct_.size());
+    code_len_.resize(distinct_.size());
+    coded_slots_ = distinct_.size();
+    escaped_ = 0;
+    lengths_.clear();
+    payload_bits_ = 0;
+    uint32_t code = 0;
+    uint8_t prev_len = lens_.front().len;
+    for (const LenEntry& le : lens_) {
+        if (le.len != prev_len) {
+            code <<= (le.len - prev_len);
+            prev_len = le.len;
+        }
+        code_[le.slot] = code;
+        code_len_[le.slot] = le.len;
+        lengths_.push_back({le.symbol, le.len});
+        payload_bits_ += static_cast<uint64_t>(freq_[le.slot]) * le.len;
+        ++code;
+    }
+}
+
+void HuffmanEncoder::write_payload(std::vector<uint8_t>& out) const {
+    if (escaped_ != 0) {
+        write_escaped(out);
+        return;
+    }
+    const size_t start = out.size();
+    out.resize(start + payload_bytes());
+    uint8_t* dst = out.data() + start;
+    // MSB-first through a 64-bit accumulator; only its low `n` bits are pending
+    uint64_t acc = 0;
+    unsigned n = 0;
+    for (uint32_t slot : sym_slot_) {
+        acc = (acc << code_len_[slot]) | code_[slot];
+        n += code_len_[slot];
+        while (n >= 8) {
+            n -= 8;
+            *dst++ = static_cast<uint8_t>(acc >> n);
+        }
+    }
+    if (n > 0) *dst = static_cast<uint8_t>(acc << (8 - n));
+}
+
+// write_payload() of a fixed-table build with escaped symbols.
+void HuffmanEncoder::write_escaped(std::vector<uint8_t>& out) const {
+    const size_t start = out.size();
+    out.resize(start + payload_bytes());
+    uint8_t* dst = out.data() + start;
+    uint64_t acc = 0;
+    unsigned n = 0;
+    const auto put = [&](uint32_t bits, unsigned len) {
+        acc = (acc << len) | bits;
+        n += len;
+        while (n >= 8) {
+            n -= 8;
+            *dst++ = static_cast<uint8_t>(acc >> n);
+        }
+    };
+    for (uint32_t slot : sym_slot_) {
+        if (slot < coded_slots_) {
+            put(code_[slot], code_len_[slot]);
+        } else {
+            put(code_[escape_slot_], code_len_[escape_slot_]);
+            put(distinct_[slot] >> 16, 16);
+            put(distinct_[slot] & 0xFFFFu, 16);
+        }
+    }
+    if (n > 0) *dst = static_cast<uint8_t>(acc << (8 - n));
+}
+
+// ---------------- HuffmanDecoder ---------------- //
+
+void HuffmanDecoder::build(const std::vector<std::pair<uint32_t, uint8_t>>& entries) {
+    if (entries.empty()) {
+        throw std::runtime_error("decode: empty Huffman table entries");
+    }
+    for (const auto& e : entries) {
+        if (e.second == 0 || e.second > 32) {
+            throw std::runtime_error("decode: invalid code length");
+        }
+    }
+    sorted_.assign(entries.begin(), entries.end());
+    std::sort(sorted_.begin(), sorted_.end(), [](const auto& a, const auto& b) {
+        if (a.second != b.second) return a.second < b.second;
+        return a.first < b.first;
+    });
+
+    nodes_.clear();
+    nodes_.push_back({-1, -1, -1}); // root
+    lut_.assign(size_t{1} << kLutBits, LutEntry{0u, 0u});
+    uint32_t code = 0;
+    uint8_t prev_len = sorted_.front().second;
+    for (const auto& [sym, len] : sorted_) {
+        if (len != prev_len) {
+            code <<= (len - prev_len);
+            prev_len = len;
+        }
+        insert_code(nodes_, sym, code, len, "decode: duplicate code assignment");
+        if (len <= kLutBits) {
+            // every kLutBits-bit window starting with this code
+            const size_t first = static_cast<size_t>(code) << (kLutBits - len);
+            const size_t count = size_t{1} << (kLutBits - len);
+            for (size_t i = first; i < first + count && i < lut_.size(); ++i) lut_[i] = {sym, len};
+        }
+        ++code;
+    }
+}
+
+void HuffmanDecoder::decode(const uint8_t* bits, size_t size, size_t symbol_count,
+                            std::vector<uint32_t>& out, bool escapes) const {
+    if (escapes) {
+        decode_symbols<true>(bits, size, symbol_count, out);
+    } else {
+        decode_symbols<false>(bits, size, symbol_count, out);
+    }
+}
+
+template <bool Escapes>
+void HuffmanDecoder::decode_symbols(const uint8_t* bits, size_t size, size_t symbol_count,
+                                    std::vector<uint32_t>& out) const {
     out.clear();
     out.reserve(symbol_count);
-    for (size_t n = 0; n < symbol_count; ++n) {
+    // MSB-first bit buffer: the low `n` bits of `acc` are pending
+    uint64_t acc = 0;
+    unsigned n = 0;
+    size_t pos = 0;
+    const uint64_t mask = (uint64_t{1} << kLutBits) - 1;
+    // 16 raw bits of an escaped symbol
+    const auto raw16 = [&]() {
+        while (n < 16) {
+            if (pos >= size) throw std::runtime_error("BitReader: out of data");
+            acc = (acc << 8) | bits[pos++];
+            n += 8;
+        }
+        n -= 16;
+        return static_cast<uint32_t>((acc >> n) & 0xFFFFu);
+    };
+    const auto emit = [&](uint32_t sym) {
+        if (Escapes && sym == kHuffEscapeSymbol) {
+            const uint32_t hi = raw16();
+            sym = (hi << 16) | raw16();
+        }
+        out.push_back(sym);
+    };
+    for (size_t k = 0; k < symbol_count; ++k) {
+        while (n <= 56 && pos < size) {
+            acc = (acc << 8) | bits[pos++];
+            n += 8;
+        }
+        const uint64_t window = n >= static_cast<unsigned>(kLutBits)
+            ? (acc >> (n - kLutBits)) & mask
+            : (acc << (kLutBits - n)) & mask; // zero-padded past the end
+        const LutEntry& e = lut_[static_cast<size_t>(window)];
+        if (e.len != 0 && e.len <= n) {
+            n -= e.len;
+            emit(e.symbol);
+            continue;
+        }
+        // long code (or corrupt / truncated data): one bit at a time through the tree
         int node = 0;
-        while (true) {
-            if (node < 0 || static_cast<size_t>(node) >= t.decode_nodes.size()) {
-                throw std::runtime_error("huffman decode: invalid node");
-            }
-            const auto& nd = t.decode_nodes[node];
-            if (nd.symbol != -1) {
-                out.push_back(static_cast<uint32_t>(nd.symbol));
-                break;
+        while (nodes_[static_cast<size_t>(node)].symbol == -1) {
+            if (n == 0) {
+                if (pos >= size) throw std::runtime_error("BitReader: out of data");
+                acc = (acc << 8) | bits[pos++];
+                n = 8;
             }
-            bool bit = br.read_bit();
+            --n;
+            const bool bit = ((acc >> n) & 1u) != 0;
+            const auto& nd = nodes_[static_cast<size_t>(node)];
             node = bit ? nd.right : nd.left;
             if (node == -1) {
                 throw std::runtime_error("huffman decode: reached null child");
             }
         }
+        emit(static_cast<uint32_t>(nodes_[static_cast<size_t>(node)].symbol));
     }
 }
 
@@ -401,6 +786,44 @@ struct HuffmanSelfTest {
         if (decoded != symbols) {
             throw std::runtime_error("huffman self-test: round-trip mismatch");
         }
+
+        // reusable coder must give the same lengths and bits
+        HuffmanEncoder enc;
+        enc.build(symbols);
+        std::vector<uint8_t> bits;
+        enc.write_payload(bits);
+        if (bits != encoded.second || enc.code_lengths().size() != 4) {
+            throw std::runtime_error("huffman self-test: HuffmanEncoder mismatch");
+        }
+        for (const auto& [sym, len] : enc.code_lengths()) {
+            if (table.enc[sym].len != len) {
+                throw std::runtime_error("huffman self-test: HuffmanEncoder length mismatch");
+            }
+        }
+        HuffmanDecoder dec;
+        dec.build(enc.code_lengths());
+        dec.decode(bits.data(), bits.size(), symbols.size(), decoded);
+        if (decoded != symbols) {
+            throw std::runtime_error("huffman self-test: HuffmanDecoder mismatch");
+        }
+
+        // fixed table with an escape: symbols missing from it still round-trip
+        const std::vector<uint32_t> more = {3, 0x2A0011u, 2, 3, 0x2A0011u, 0xFFFFu};
+        enc.reset_counts();
+        for (uint32_t s : symbols) enc.count(s);
+        enc.count(kHuffEscapeSymbol);
+        enc.build_lengths();
+        const std::vector<std::pair<uint32_t, uint8_t>> fixed = enc.code_lengths();
+        if (!enc.build_from_table(more, fixed) || enc.escaped() != 3 || enc.code_lengths() != fixed) {
+            throw std::runtime_error("huffman self-test: fixed-table build failed");
+        }
+        bits.clear();
+        enc.write_payload(bits);
+        dec.build(fixed);
+        dec.decode(bits.data(), bits.size(), more.size(), decoded, true);
+        if (decoded != more || bits.size() != enc.payload_bytes()) {
+            throw std::runtime_error("huffman self-test: escaped fixed-table round-trip mismatch");
+        }
     }
 };
 static HuffmanSelfTest _huff_self_test{};
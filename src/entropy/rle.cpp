@@ -1,5 +1,6 @@
 #include "entropy/rle.hpp"
 
+#include <algorithm>
 #include <stdexcept>
 #include <limits>
 
@@ -8,6 +9,13 @@ namespace mcodec {
 void rle_encode_zeros(const std::vector<int16_t>& seq_in,
                       int block_size,
                       std::vector<RlePair>& rle_out) {
+    rle_encode_zeros(seq_in, block_size, std::vector<int32_t>{}, rle_out);
+}
+
+void rle_encode_zeros(const std::vector<int16_t>& seq_in,
+                      int block_size,
+                      const std::vector<int32_t>& flat,
+                      std::vector<RlePair>& rle_out) {
     if (block_size != 8 && block_size != 16) {
         throw std::runtime_error("rle_encode_zeros: block_size must be 8 or 16");
     }
@@ -15,11 +23,21 @@ void rle_encode_zeros(const std::vector<int16_t>& seq_in,
     if (seq_in.size() % block_elems != 0) {
         throw std::runtime_error("rle_encode_zeros: input size not multiple of block");
     }
+    if (!flat.empty() && flat.size() != seq_in.size() / block_elems) {
+        throw std::runtime_error("rle_encode_zeros: flat block list does not match the input");
+    }
 
     rle_out.clear();
     rle_out.reserve(seq_in.size());
 
     for (size_t i = 0; i < seq_in.size(); ) {
+        // Skipped block: its sample value only
+        if (!flat.empty() && flat[i / block_elems] != kNotFlat) {
+            rle_out.push_back({static_cast<int16_t>(flat[i / block_elems]), kSkipRun});
+            i += block_elems;
+            continue;
+        }
+
         // DC
         int16_t dc = seq_in[i++];
         rle_out.push_back({dc, 0});
@@ -48,17 +66,36 @@ void rle_encode_zeros(const std::vector<int16_t>& seq_in,
     }
 }
 
-void rle_decode_zeros(const std::vector<RlePair>& rle_in,
-                      int block_size,
-                      size_t total_coeffs,
-                      std::vector<int16_t>& seq_out) {
+namespace {
+
+template <bool Skips>
+void decode_pairs(const std::vector<RlePair>& rle_in,
+                  int block_size,
+                  size_t total_coeffs,
+                  std::vector<int16_t>& seq_out,
+                  std::vector<int32_t>* flat) {
     if (block_size != 8 && block_size != 16) {
         throw std::runtime_error("rle_decode_zeros: block_size must be 8 or 16");
     }
+    const size_t block_elems = static_cast<size_t>(block_size * block_size);
     seq_out.clear();
     seq_out.reserve(total_coeffs);
+    size_t skipped = 0;
+    if (Skips) flat->assign(total_coeffs / block_elems, kNotFlat);
 
     for (const auto& p : rle_in) {
+        if (Skips && p.run == kSkipRun) {
+            if (seq_out.size() % block_elems != 0) {
+                throw std::runtime_error("rle_decode_zeros: skipped block does not start at a block boundary");
+            }
+            if (seq_out.size() + block_elems > total_coeffs) {
+                throw std::runtime_error("rle_decode_zeros: output exceeds expected size");
+            }
+            (*flat)[seq_out.size() / block_elems] = p.value;
+            ++skipped;
+            seq_out.insert(seq_out.end(), block_elems, static_cast<int16_t>(0));
+            continue;
+        }
         // run zeros first, then the value
         if (p.run > 0) {
             seq_out.insert(seq_out.end(), static_cast<size_t>(p.run), static_cast<int16_t>(0));
@@ -71,6 +108,24 @@ void rle_decode_zeros(const std::vector<RlePair>& rle_in,
     if (seq_out.size() != total_coeffs) {
         throw std::runtime_error("rle_decode_zeros: output size mismatch");
     }
+    if (Skips && skipped == 0) flat->clear();
+}
+
+} // namespace
+
+void rle_decode_zeros(const std::vector<RlePair>& rle_in,
+                      int block_size,
+                      size_t total_coeffs,
+                      std::vector<int16_t>& seq_out) {
+    decode_pairs<false>(rle_in, block_size, total_coeffs, seq_out, nullptr);
+}
+
+void rle_decode_zeros(const std::vector<RlePair>& rle_in,
+                      int block_size,
+                      size_t total_coeffs,
+                      std::vector<int16_t>& seq_out,
+                      std::vector<int32_t>& flat) {
+    decode_pairs<true>(rle_in, block_size, total_coeffs, seq_out, &flat);
 }
 
 // Pack RLE pairs into 32-bit symbols: (run << 16) | uint16_t(value)
@@ -123,6 +178,18 @@ struct RleSelfTest {
         if (recon != src) {
             throw std::runtime_error("rle self-test: round-trip mismatch");
         }
+
+        // Skipped middle block of three: one pair, zeros and its value on decode
+        std::vector<int16_t> three(src);
+        three.resize(3 * block_elems, 0);
+        std::copy(src.begin(), src.end(), three.begin() + 2 * block_elems);
+        const std::vector<int32_t> flat = {kNotFlat, -1234, kNotFlat};
+        rle_encode_zeros(three, N, flat, rle);
+        std::vector<int32_t> flat_out;
+        rle_decode_zeros(rle, N, three.size(), recon, flat_out);
+        if (recon != three || flat_out != flat || rle.size() != 9) {
+            throw std::runtime_error("rle self-test: skipped block round-trip mismatch");
+        }
     }
 };
 static RleSelfTest _rle_self_test{};
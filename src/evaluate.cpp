@@ -1,16 +1,30 @@
-// Mode B evaluator: encode -> decode -> metrics (RMSE/PSNR) and figures.
+// Mode B evaluator: encode -> decode -> metrics (RMSE/PSNR/SSIM), timing and figures.
+// --sweep: in-memory RD curve over any number of qualities (+ BD-rate against a reference CSV).
+// --dataset: every image of a folder / list file in parallel, per-image rows + per-quality summary.
+// --near: near-lossless predictive streams, verifying the +-k bound on every pixel.
 #include "io/medical_loader.hpp"
 #include "io/medical_saver.hpp"
+#include "io/stream_io.hpp"
 #include "codec/encoder.hpp"
 #include "codec/decoder.hpp"
+#include "codec/predictive.hpp"
+#include "codec/rd_sweep.hpp"
+#include "entropy/bitstream.hpp"
+#include "metrics/metrics.hpp"
+#include "util/parallel.hpp"
+#include "util/process_stats.hpp"
 
 #include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <mutex>
 #include <numeric>
+#include <sstream>
 #include <stdexcept>
 #include <string>
 #include <utility>
@@ -22,27 +36,46 @@ namespace {
 
 struct Cli {
     std::string ref;
+    std::string dataset;    // folder (recursive) or list file, instead of --ref
+    std::string summary_csv;
     std::vector<int> qualities;
-    std::string tmp_dir;
+    std::vector<int> nears;     // --near: predictive engine bounds instead of qualities
+    std::string tmp_dir;    // optional: keep the .mcodec files
     std::string out_csv;
-    std::string fig_dir;
+    std::string fig_dir;    // optional: reference / recon / error-map PGMs
+    int repeat = 5; // encode/decode timing repetitions
+    bool sweep = false;
+    std::string bd_ref;     // CSV with bpp,psnr columns (e.g. an earlier --sweep or evaluate run)
+    bool ssim = true;
+    unsigned threads = 0;
 };
 
-std::vector<uint8_t> read_all(const std::string& path) {
-    std::ifstream ifs(path, std::ios::binary);
-    if (!ifs.good()) throw std::runtime_error("Cannot open file: " + path);
-    ifs.seekg(0, std::ios::end);
-    auto n = static_cast<std::streamsize>(ifs.tellg());
-    ifs.seekg(0, std::ios::beg);
-    std::vector<uint8_t> buf(static_cast<size_t>(n));
-    ifs.read(reinterpret_cast<char*>(buf.data()), n);
-    return buf;
-}
+constexpr const char* kUsage =
+    "Usage: evaluate --ref <dicom> --quality q1 q2 q3 --out <metrics.csv> [--tmp_dir <dir>] [--fig_dir <dir>] [--repeat N]\n"
+    "       evaluate --ref <dicom> --sweep --quality lo:hi[:step] ... --out <rd.csv> [--bd_ref <csv>] [--no_ssim] [--threads N]\n"
+    "       evaluate --dataset <dir|list.txt> --quality ... --out <images.csv> [--summary <csv>] [--fig_dir <dir>]\n"
+    "                [--no_ssim] [--threads N]\n"
+    "       evaluate --ref <dicom> --near k1 k2 ... --out <metrics.csv> [--tmp_dir <dir>] [--fig_dir <dir>] [--repeat N]";
 
-void write_all(const std::string& path, const std::vector<uint8_t>& bytes) {
-    std::ofstream ofs(path, std::ios::binary);
-    if (!ofs.good()) throw std::runtime_error("Cannot write file: " + path);
-    ofs.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+// "q" or "lo:hi" or "lo:hi:step" -> qualities
+void parse_quality_token(const std::string& tok, std::vector<int>& out) {
+    std::vector<int> v;
+    std::stringstream ss(tok);
+    std::string part;
+    try {
+        while (std::getline(ss, part, ':')) v.push_back(std::stoi(part));
+    } catch (...) {
+        throw std::runtime_error("quality must be integer or lo:hi[:step]");
+    }
+    if (v.size() == 1) {
+        out.push_back(v[0]);
+        return;
+    }
+    if (v.size() > 3 || (v.size() == 3 && v[2] <= 0) || v[0] > v[1]) {
+        throw std::runtime_error("bad quality range: " + tok);
+    }
+    const int step = v.size() == 3 ? v[2] : 1;
+    for (int q = v[0]; q <= v[1]; q += step) out.push_back(q);
 }
 
 Cli parse_cli(int argc, char** argv) {
@@ -51,88 +84,435 @@ Cli parse_cli(int argc, char** argv) {
         std::string a = argv[i] ? argv[i] : "";
         if (a == "--ref" && i + 1 < argc) {
             c.ref = argv[++i];
+        } else if (a == "--dataset" && i + 1 < argc) {
+            c.dataset = argv[++i];
+        } else if (a == "--summary" && i + 1 < argc) {
+            c.summary_csv = argv[++i];
         } else if (a == "--tmp_dir" && i + 1 < argc) {
             c.tmp_dir = argv[++i];
         } else if (a == "--out" && i + 1 < argc) {
             c.out_csv = argv[++i];
         } else if (a == "--fig_dir" && i + 1 < argc) {
             c.fig_dir = argv[++i];
+        } else if (a == "--repeat" && i + 1 < argc) {
+            try {
+                c.repeat = std::stoi(argv[++i]);
+            } catch (...) {
+                throw std::runtime_error("repeat must be integer");
+            }
+            if (c.repeat < 1) throw std::runtime_error("repeat must be >= 1");
+        } else if (a == "--sweep") {
+            c.sweep = true;
+        } else if (a == "--bd_ref" && i + 1 < argc) {
+            c.bd_ref = argv[++i];
+        } else if (a == "--no_ssim") {
+            c.ssim = false;
+        } else if (a == "--threads" && i + 1 < argc) {
+            try {
+                c.threads = static_cast<unsigned>(std::stoi(argv[++i]));
+            } catch (...) {
+                throw std::runtime_error("threads must be integer");
+            }
         } else if (a == "--quality") {
             while (i + 1 < argc) {
                 std::string next = argv[i + 1] ? argv[i + 1] : "";
                 if (next.rfind("--", 0) == 0) break;
-                try {
-                    c.qualities.push_back(std::stoi(next));
-                } catch (...) {
-                    throw std::runtime_error("quality must be integer");
-                }
+                parse_quality_token(next, c.qualities);
+                ++i;
+            }
+        } else if (a == "--near") {
+            while (i + 1 < argc) {
+                std::string next = argv[i + 1] ? argv[i + 1] : "";
+                if (next.rfind("--", 0) == 0) break;
+                parse_quality_token(next, c.nears);
                 ++i;
             }
         }
     }
-    if (c.ref.empty() || c.tmp_dir.empty() || c.out_csv.empty() || c.fig_dir.empty()) {
-        throw std::runtime_error("Usage: evaluate --ref <dicom> --quality q1 q2 q3 --tmp_dir <dir> --out <metrics.csv> --fig_dir <dir>");
+    if (c.ref.empty() == c.dataset.empty() || c.out_csv.empty() || (c.sweep && !c.dataset.empty()) ||
+        (!c.nears.empty() && (c.sweep || !c.dataset.empty() || !c.qualities.empty()))) {
+        throw std::runtime_error(kUsage);
     }
-    if (c.qualities.size() < 3) {
-        throw std::runtime_error("Need at least 3 quality values");
+    if (!c.nears.empty()) {
+        for (int k : c.nears) {
+            if (k < 0) throw std::runtime_error("near must be >= 0");
+        }
+        return c;
+    }
+    if (!c.dataset.empty() && c.summary_csv.empty()) {
+        const fs::path out(c.out_csv);
+        c.summary_csv = (out.parent_path() / (out.stem().string() + "_summary.csv")).string();
+    }
+    if (c.qualities.empty()) {
+        throw std::runtime_error("Need at least 1 quality value");
+    }
+    for (int q : c.qualities) {
+        if (q < 1 || q > 100) throw std::runtime_error("quality out of range 1..100");
     }
-    // take first three
-    c.qualities.resize(3);
     return c;
 }
 
-template <typename T>
-T clamp_val(T v, T lo, T hi) {
-    if (v < lo) return lo;
-    if (v > hi) return hi;
-    return v;
+// Median wall time of fn() over `repeat` runs, in milliseconds.
+template <typename Fn>
+double median_ms(int repeat, Fn&& fn) {
+    std::vector<double> ms;
+    for (int i = 0; i < repeat; ++i) {
+        const auto t0 = std::chrono::steady_clock::now();
+        fn();
+        ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+    }
+    std::sort(ms.begin(), ms.end());
+    const size_t n = ms.size();
+    return (n % 2) ? ms[n / 2] : 0.5 * (ms[n / 2 - 1] + ms[n / 2]);
+}
+
+// CSV field: quoted (RFC 4180, inner quotes doubled) if it holds a comma, quote or line break.
+std::string csv_field(const std::string& s) {
+    if (s.find_first_of(",\"\r\n") == std::string::npos) return s;
+    std::string q = "\"";
+    for (char c : s) {
+        if (c == '"') q += '"';
+        q += c;
+    }
+    return q + "\"";
 }
 
-void map_to_unsigned(const mcodec::Image& im, std::vector<uint32_t>& out_u, uint32_t maxv) {
-    out_u.resize(im.pixels.size());
-    if (im.is_signed) {
-        const uint32_t offset = 1u << (im.bits_stored - 1);
-        for (size_t i = 0; i < im.pixels.size(); ++i) {
-            int32_t s = im.pixels[i];
-            uint32_t u = static_cast<uint32_t>(s + static_cast<int32_t>(offset));
-            out_u[i] = clamp_val<uint32_t>(u, 0u, maxv);
-        }
-    } else {
-        for (size_t i = 0; i < im.pixels.size(); ++i) {
-            int32_t s = im.pixels[i];
-            uint32_t u = s < 0 ? 0u : static_cast<uint32_t>(s);
-            out_u[i] = clamp_val<uint32_t>(u, 0u, maxv);
+// Metric column that --no_ssim leaves uncomputed: empty instead of a misleading 0.
+std::string metric_field(bool computed, double v) {
+    if (!computed) return "";
+    std::ostringstream os;
+    os << v;
+    return os.str();
+}
+
+// Fields of one CSV line, undoing csv_field's quoting.
+std::vector<std::string> split_csv_line(const std::string& line) {
+    std::vector<std::string> cols(1);
+    bool quoted = false;
+    for (size_t i = 0; i < line.size(); ++i) {
+        const char c = line[i];
+        if (quoted) {
+            if (c != '"') cols.back() += c;
+            else if (i + 1 < line.size() && line[i + 1] == '"') cols.back() += line[++i];
+            else quoted = false;
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == ',') {
+            cols.emplace_back();
+        } else if (c != '\r') {
+            cols.back() += c;
         }
     }
+    return cols;
+}
+
+// (bpp, psnr) pairs from a CSV with "bpp" and "psnr" header columns.
+std::vector<std::pair<double, double>> read_rd_csv(const std::string& path) {
+    std::ifstream ifs(path);
+    if (!ifs.good()) throw std::runtime_error("Cannot open csv: " + path);
+    std::string line;
+    std::getline(ifs, line);
+    const auto header = split_csv_line(line);
+    const auto bpp_it = std::find(header.begin(), header.end(), "bpp");
+    const auto psnr_it = std::find(header.begin(), header.end(), "psnr");
+    if (bpp_it == header.end() || psnr_it == header.end()) {
+        throw std::runtime_error("csv needs bpp and psnr columns: " + path);
+    }
+    const size_t bi = static_cast<size_t>(bpp_it - header.begin());
+    const size_t pi = static_cast<size_t>(psnr_it - header.begin());
+    std::vector<std::pair<double, double>> pts;
+    while (std::getline(ifs, line)) {
+        const auto cols = split_csv_line(line);
+        if (cols.size() <= std::max(bi, pi)) continue;
+        pts.push_back({std::stod(cols[bi]), std::stod(cols[pi])}); // "inf" parses to infinity
+    }
+    return pts;
 }
 
-double compute_rmse_psnr(const std::vector<uint32_t>& ref_u,
-                         const std::vector<uint32_t>& rec_u,
-                         uint32_t maxv,
-                         double& out_psnr) {
-    if (ref_u.size() != rec_u.size()) {
-        throw std::runtime_error("compute_rmse_psnr: size mismatch");
+// --sweep: every quality from one shared front end, all in memory, one CSV row per quality.
+int run_sweep(const Cli& cli) {
+    const mcodec::Image ref = mcodec::load_medical(cli.ref);
+    if (ref.bits_stored <= 0 || ref.bits_stored > 16) {
+        throw std::runtime_error("ref bits_stored out of range");
     }
-    double mse = 0.0;
-    for (size_t i = 0; i < ref_u.size(); ++i) {
-        double d = static_cast<double>(rec_u[i]) - static_cast<double>(ref_u[i]);
-        mse += d * d;
+    const double raw_bytes = static_cast<double>(ref.width) * ref.height * ref.channels * (ref.bits_allocated / 8);
+
+    const auto t0 = std::chrono::steady_clock::now();
+    mcodec::RdSweepOptions sopt;
+    sopt.ssim = cli.ssim;
+    sopt.threads = cli.threads;
+    const std::vector<mcodec::RdPoint> pts = mcodec::rd_sweep(ref, cli.qualities, sopt);
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+    std::ofstream ofs(cli.out_csv, std::ios::trunc);
+    if (!ofs.good()) throw std::runtime_error("Cannot write csv: " + cli.out_csv);
+    ofs << "quality,compressed_bytes,bpp,compression_ratio,rmse,psnr,max_abs_err,ssim,ms_ssim\n";
+    std::vector<std::pair<double, double>> curve;
+    for (const auto& p : pts) {
+        ofs << p.quality << ","
+            << p.compressed_bytes << ","
+            << p.bpp << ","
+            << raw_bytes / static_cast<double>(p.compressed_bytes) << ","
+            << p.metrics.rmse << ","
+            << p.metrics.psnr << ","
+            << p.metrics.max_abs_error << ","
+            << metric_field(cli.ssim, p.metrics.ssim) << ","
+            << metric_field(cli.ssim, p.metrics.ms_ssim) << "\n";
+        curve.push_back({p.bpp, p.metrics.psnr});
     }
-    mse /= static_cast<double>(ref_u.size());
-    double rmse = std::sqrt(mse);
-    if (mse == 0.0) {
-        out_psnr = std::numeric_limits<double>::infinity();
+    std::cout << "RD sweep: " << pts.size() << " qualities in " << ms << " ms -> " << cli.out_csv << "\n";
+
+    if (!cli.bd_ref.empty()) {
+        const double bd = mcodec::bd_rate(read_rd_csv(cli.bd_ref), curve);
+        std::cout << "BD-rate vs " << cli.bd_ref << ": " << bd << " %\n";
+    }
+    return 0;
+}
+
+// --dataset inputs: every regular file under a folder (recursive), or the
+// non-empty, non-'#' lines of a list file (relative paths are relative to it).
+std::vector<std::string> list_dataset(const std::string& src) {
+    std::vector<std::string> paths;
+    if (fs::is_directory(src)) {
+        for (auto& ent : fs::recursive_directory_iterator(src)) {
+            if (ent.is_regular_file()) paths.push_back(ent.path().string());
+        }
     } else {
-        out_psnr = 20.0 * std::log10(static_cast<double>(maxv)) - 10.0 * std::log10(mse);
+        std::ifstream ifs(src);
+        if (!ifs.good()) throw std::runtime_error("Cannot open dataset list: " + src);
+        const fs::path base = fs::path(src).parent_path();
+        std::string line;
+        while (std::getline(ifs, line)) {
+            const size_t b = line.find_first_not_of(" \t\r");
+            if (b == std::string::npos || line[b] == '#') continue;
+            const size_t e = line.find_last_not_of(" \t\r");
+            const fs::path p(line.substr(b, e - b + 1));
+            paths.push_back((p.is_absolute() ? p : base / p).string());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+    if (paths.empty()) throw std::runtime_error("No images in dataset: " + src);
+    return paths;
+}
+
+// Nearest-rank percentile of an ascending vector (same rule as error_percentile).
+double sorted_percentile(const std::vector<double>& v, double p) {
+    if (v.empty()) return 0.0;
+    return v[static_cast<size_t>(p * static_cast<double>(v.size() - 1))];
+}
+
+struct DatasetImage {
+    std::string path;
+    bool ok = false;
+    std::string error;
+    uint64_t pixels = 0;
+    uint64_t raw_bytes = 0;
+    std::vector<mcodec::RdPoint> points; // one per quality
+};
+
+// --dataset: one image per worker (each image's qualities run sequentially on it,
+// so the pool is not oversubscribed). Files that do not load are reported and skipped.
+int run_dataset(const Cli& cli) {
+    const std::vector<std::string> paths = list_dataset(cli.dataset);
+    if (!cli.fig_dir.empty()) fs::create_directories(cli.fig_dir);
+
+    mcodec::RdSweepOptions sopt;
+    sopt.ssim = cli.ssim;
+    sopt.histogram = !cli.fig_dir.empty();
+    sopt.keep_recon = !cli.fig_dir.empty();
+    sopt.threads = 1;
+
+    std::vector<DatasetImage> images(paths.size());
+    std::mutex log_mutex;
+    const auto t0 = std::chrono::steady_clock::now();
+    mcodec::parallel_for(paths.size(), [&](size_t i) {
+        DatasetImage& d = images[i];
+        d.path = paths[i];
+        try {
+            const mcodec::Image ref = mcodec::load_medical(d.path);
+            if (ref.bits_stored <= 0 || ref.bits_stored > 16) {
+                throw std::runtime_error("bits_stored out of range");
+            }
+            d.pixels = static_cast<uint64_t>(ref.width) * static_cast<uint64_t>(ref.height);
+            d.raw_bytes = d.pixels * static_cast<uint64_t>(ref.channels) *
+                          static_cast<uint64_t>(ref.bits_allocated / 8);
+            d.points = mcodec::rd_sweep(ref, cli.qualities, sopt);
+
+            if (!cli.fig_dir.empty()) {
+                // flatten the relative path so equal stems in different folders do not collide
+                std::string name = fs::path(d.path).lexically_relative(cli.dataset).replace_extension().string();
+                if (name.empty() || name.rfind("..", 0) == 0) name = fs::path(d.path).stem().string();
+                std::replace_if(name.begin(), name.end(), [](char c) { return c == '/' || c == '\\'; }, '_');
+                mcodec::save_pgm((fs::path(cli.fig_dir) / (name + "_ref.pgm")).string(), ref);
+                for (mcodec::RdPoint& p : d.points) {
+                    const std::string q = "_q" + std::to_string(p.quality);
+                    const uint32_t scale = mcodec::error_percentile(p.metrics.error_histogram, 0.99);
+                    mcodec::save_pgm((fs::path(cli.fig_dir) / (name + q + "_recon.pgm")).string(), p.recon);
+                    mcodec::save_pgm((fs::path(cli.fig_dir) / (name + q + "_err.pgm")).string(),
+                                     mcodec::scaled_error_map(ref, p.recon, scale, 1));
+                    p.recon = mcodec::Image{};
+                }
+            }
+            d.ok = true;
+        } catch (const std::exception& e) {
+            d.error = e.what();
+            std::lock_guard<std::mutex> lock(log_mutex);
+            std::cerr << "[WARN] skipping " << d.path << ": " << e.what() << "\n";
+        }
+    }, cli.threads);
+    const double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    // per-image rows
+    size_t n_ok = 0;
+    uint64_t total_raw = 0;
+    {
+        std::ofstream ofs(cli.out_csv, std::ios::trunc);
+        if (!ofs.good()) throw std::runtime_error("Cannot write csv: " + cli.out_csv);
+        ofs << "image,quality,compressed_bytes,bpp,raw_bytes,compression_ratio,rmse,psnr,"
+               "max_abs_err,ssim,ms_ssim,encode_ms,decode_ms\n";
+        for (const DatasetImage& d : images) {
+            if (!d.ok) continue;
+            ++n_ok;
+            total_raw += d.raw_bytes;
+            for (const mcodec::RdPoint& p : d.points) {
+                ofs << csv_field(d.path) << ","
+                    << p.quality << ","
+                    << p.compressed_bytes << ","
+                    << p.bpp << ","
+                    << d.raw_bytes << ","
+                    << static_cast<double>(d.raw_bytes) / static_cast<double>(p.compressed_bytes) << ","
+                    << p.metrics.rmse << ","
+                    << p.metrics.psnr << ","
+                    << p.metrics.max_abs_error << ","
+                    << metric_field(cli.ssim, p.metrics.ssim) << ","
+                    << metric_field(cli.ssim, p.metrics.ms_ssim) << ","
+                    << p.encode_ms << ","
+                    << p.decode_ms << "\n";
+            }
+        }
     }
-    return rmse;
+    if (n_ok == 0) throw std::runtime_error("No image of the dataset could be evaluated");
+
+    // per-quality summary; PSNR mean is over finite values (lossless images are counted apart),
+    // bpp is total bits over total pixels, MB/s is raw bytes over summed single-core encode/decode time
+    {
+        std::ofstream ofs(cli.summary_csv, std::ios::trunc);
+        if (!ofs.good()) throw std::runtime_error("Cannot write csv: " + cli.summary_csv);
+        ofs << "quality,images,lossless,bpp,compression_ratio,psnr_mean,psnr_median,psnr_p5,"
+               "ssim_mean,max_abs_err,encode_MBps,decode_MBps\n";
+        for (size_t qi = 0; qi < cli.qualities.size(); ++qi) {
+            std::vector<double> psnr;
+            size_t lossless = 0;
+            double finite_sum = 0.0, ssim_sum = 0.0, enc_ms = 0.0, dec_ms = 0.0;
+            uint64_t bytes = 0, pixels = 0;
+            uint32_t max_err = 0;
+            for (const DatasetImage& d : images) {
+                if (!d.ok) continue;
+                const mcodec::RdPoint& p = d.points[qi];
+                psnr.push_back(p.metrics.psnr);
+                if (std::isfinite(p.metrics.psnr)) finite_sum += p.metrics.psnr;
+                else ++lossless;
+                ssim_sum += p.metrics.ssim;
+                enc_ms += p.encode_ms;
+                dec_ms += p.decode_ms;
+                bytes += p.compressed_bytes;
+                pixels += d.pixels;
+                max_err = std::max(max_err, p.metrics.max_abs_error);
+            }
+            std::sort(psnr.begin(), psnr.end());
+            const size_t finite = psnr.size() - lossless;
+            const double mean = finite > 0 ? finite_sum / static_cast<double>(finite)
+                                           : std::numeric_limits<double>::infinity();
+            auto mbps = [&](double ms) { return ms > 0.0 ? (static_cast<double>(total_raw) / 1e6) / (ms / 1e3) : 0.0; };
+            ofs << cli.qualities[qi] << ","
+                << psnr.size() << ","
+                << lossless << ","
+                << 8.0 * static_cast<double>(bytes) / static_cast<double>(pixels) << ","
+                << static_cast<double>(total_raw) / static_cast<double>(bytes) << ","
+                << mean << ","
+                << sorted_percentile(psnr, 0.5) << ","
+                << sorted_percentile(psnr, 0.05) << ","
+                << metric_field(cli.ssim, ssim_sum / static_cast<double>(psnr.size())) << ","
+                << max_err << ","
+                << mbps(enc_ms) << ","
+                << mbps(dec_ms) << "\n";
+        }
+    }
+
+    std::cout << "Dataset: " << n_ok << "/" << images.size() << " images, "
+              << cli.qualities.size() << " qualities in " << wall_s << " s ("
+              << (wall_s > 0.0 ? static_cast<double>(n_ok) / wall_s : 0.0) << " images/s) -> "
+              << cli.out_csv << ", " << cli.summary_csv << "\n";
+    return 0;
 }
 
-uint32_t percentile_p99(std::vector<uint32_t> v) {
-    if (v.empty()) return 0;
-    size_t idx = static_cast<size_t>(std::floor(0.99 * static_cast<double>(v.size() - 1)));
-    std::nth_element(v.begin(), v.begin() + idx, v.end());
-    return v[idx];
+// --near: near-lossless streams at each bound. Every decoded pixel is checked against
+// the bound; the achieved maximum error is reported per level, and any violation fails
+// the run after the CSV is written.
+int run_near(const Cli& cli) {
+    if (!cli.tmp_dir.empty()) fs::create_directories(cli.tmp_dir);
+    if (!cli.fig_dir.empty()) fs::create_directories(cli.fig_dir);
+    const mcodec::Image ref = mcodec::load_medical(cli.ref);
+    if (ref.bits_stored <= 0 || ref.bits_stored > 16) {
+        throw std::runtime_error("ref bits_stored out of range");
+    }
+    const uint64_t raw_bytes = static_cast<uint64_t>(ref.width) * static_cast<uint64_t>(ref.height) *
+                               static_cast<uint64_t>(ref.bits_allocated / 8);
+    const std::string stem = fs::path(cli.ref).stem().string();
+    auto mbps = [&](double ms) { return ms > 0.0 ? (static_cast<double>(raw_bytes) / 1e6) / (ms / 1e3) : 0.0; };
+
+    std::ofstream ofs(cli.out_csv, std::ios::trunc);
+    if (!ofs.good()) throw std::runtime_error("Cannot write csv: " + cli.out_csv);
+    ofs << "near,compressed_bytes,bpp,raw_bytes,compression_ratio,rmse,psnr,max_abs_err,bound_ok,"
+           "ssim,ms_ssim,encode_ms,decode_ms,encode_MBps,decode_MBps\n";
+    size_t violations = 0;
+    for (int k : cli.nears) {
+        std::vector<uint8_t> bytes;
+        const double encode_ms = median_ms(cli.repeat, [&] { bytes = mcodec::encode_near_lossless_mcodec(ref, k); });
+        const std::string tag = stem + "_near" + std::to_string(k);
+        if (!cli.tmp_dir.empty()) mcodec::write_output((fs::path(cli.tmp_dir) / (tag + ".mcodec")).string(), bytes);
+        mcodec::Image rec;
+        const double decode_ms = median_ms(cli.repeat, [&] { rec = mcodec::decode_from_mcodec(bytes); });
+        if (rec.width != ref.width || rec.height != ref.height || rec.bits_stored != ref.bits_stored ||
+            rec.is_signed != ref.is_signed) {
+            throw std::runtime_error("decoded image does not match the reference format");
+        }
+
+        const mcodec::ImageMetrics met = mcodec::compute_metrics(ref, rec);
+        const bool ok = met.max_abs_error <= static_cast<uint32_t>(k);
+        if (!ok) ++violations;
+        if (!cli.fig_dir.empty()) {
+            mcodec::save_pgm((fs::path(cli.fig_dir) / (tag + "_recon.pgm")).string(), rec);
+            mcodec::save_pgm((fs::path(cli.fig_dir) / (tag + "_err.pgm")).string(),
+                             mcodec::scaled_error_map(ref, rec, std::max(1u, met.max_abs_error)));
+        }
+
+        const double bpp = 8.0 * static_cast<double>(bytes.size()) /
+                           (static_cast<double>(ref.width) * static_cast<double>(ref.height));
+        ofs << k << ","
+            << bytes.size() << ","
+            << bpp << ","
+            << raw_bytes << ","
+            << static_cast<double>(raw_bytes) / static_cast<double>(bytes.size()) << ","
+            << met.rmse << ","
+            << met.psnr << ","
+            << met.max_abs_error << ","
+            << (ok ? 1 : 0) << ","
+            << met.ssim << ","
+            << met.ms_ssim << ","
+            << encode_ms << ","
+            << decode_ms << ","
+            << mbps(encode_ms) << ","
+            << mbps(decode_ms) << "\n";
+        std::cout << "near " << k << ": " << bytes.size() << " bytes, " << bpp << " bpp, max |err| = "
+                  << met.max_abs_error << (ok ? " (within bound)" : " (BOUND VIOLATED)") << "\n";
+    }
+    ofs.close();
+    if (violations > 0) {
+        throw std::runtime_error(std::to_string(violations) + " near level(s) exceeded their error bound");
+    }
+    std::cout << "Evaluation completed -> " << cli.out_csv << "\n";
+    return 0;
 }
 
 } // namespace
@@ -140,15 +520,17 @@ uint32_t percentile_p99(std::vector<uint32_t> v) {
 int main(int argc, char** argv) {
     try {
         Cli cli = parse_cli(argc, argv);
+        if (!cli.nears.empty()) return run_near(cli);
+        if (cli.sweep) return run_sweep(cli);
+        if (!cli.dataset.empty()) return run_dataset(cli);
 
-        fs::create_directories(cli.tmp_dir);
-        fs::create_directories(cli.fig_dir);
+        if (!cli.tmp_dir.empty()) fs::create_directories(cli.tmp_dir);
+        if (!cli.fig_dir.empty()) fs::create_directories(cli.fig_dir);
 
         mcodec::Image ref = mcodec::load_medical(cli.ref);
         if (ref.bits_stored <= 0 || ref.bits_stored > 16) {
             throw std::runtime_error("ref bits_stored out of range");
         }
-        const uint32_t MAX = (1u << ref.bits_stored) - 1u;
         const uint64_t raw_bytes = static_cast<uint64_t>(ref.width) *
                                    static_cast<uint64_t>(ref.height) *
                                    static_cast<uint64_t>(ref.channels) *
@@ -156,7 +538,7 @@ int main(int argc, char** argv) {
         const std::string stem = fs::path(cli.ref).stem().string();
 
         // Save reference image (original bit depth)
-        {
+        if (!cli.fig_dir.empty()) {
             std::string ref_path = (fs::path(cli.fig_dir) / (stem + "_ref.pgm")).string();
             mcodec::save_pgm(ref_path, ref);
         }
@@ -165,7 +547,8 @@ int main(int argc, char** argv) {
         {
             std::ofstream ofs(cli.out_csv, std::ios::trunc);
             if (!ofs.good()) throw std::runtime_error("Cannot write csv: " + cli.out_csv);
-            ofs << "quality,block_size,compressed_bytes,bpp,raw_bytes,compression_ratio,rmse,psnr\n";
+            ofs << "quality,block_size,compressed_bytes,bpp,raw_bytes,compression_ratio,rmse,psnr,"
+                   "max_abs_err,ssim,ms_ssim,encode_ms,decode_ms,encode_MBps,decode_MBps,peak_rss_MB\n";
         }
 
         for (int q : cli.qualities) {
@@ -173,12 +556,14 @@ int main(int argc, char** argv) {
                 throw std::runtime_error("quality out of range 1..100");
             }
 
-            std::string mcodec_path = (fs::path(cli.tmp_dir) / (stem + "_q" + std::to_string(q) + ".mcodec")).string();
-
-            // encode
-            auto bytes = mcodec::encode_to_mcodec(ref, q);
-            write_all(mcodec_path, bytes);
-            uint64_t compressed_bytes = fs::file_size(mcodec_path);
+            // encode (timed in memory; the file in tmp_dir is only kept for inspection)
+            std::vector<uint8_t> bytes;
+            const double encode_ms = median_ms(cli.repeat, [&] { bytes = mcodec::encode_to_mcodec(ref, q); });
+            if (!cli.tmp_dir.empty()) {
+                mcodec::write_output((fs::path(cli.tmp_dir) / (stem + "_q" + std::to_string(q) + ".mcodec")).string(), bytes);
+            }
+            const uint64_t compressed_bytes = bytes.size();
+            const int block_size = static_cast<int>(mcodec::read_bitstream_header(bytes).block_size);
 
             // rate metrics
             double bpp = (8.0 * static_cast<double>(compressed_bytes)) /
@@ -186,7 +571,9 @@ int main(int argc, char** argv) {
             double cr = raw_bytes > 0 ? static_cast<double>(raw_bytes) / static_cast<double>(compressed_bytes) : 0.0;
 
             // decode
-            mcodec::Image rec = mcodec::decode_from_mcodec(bytes);
+            mcodec::Image rec;
+            const double decode_ms = median_ms(cli.repeat, [&] { rec = mcodec::decode_from_mcodec(bytes); });
+            auto mbps = [&](double ms) { return ms > 0.0 ? (static_cast<double>(raw_bytes) / 1e6) / (ms / 1e3) : 0.0; };
 
             // metadata checks
             if (rec.width != ref.width || rec.height != ref.height || rec.channels != ref.channels) {
@@ -199,59 +586,40 @@ int main(int argc, char** argv) {
                 throw std::runtime_error("decoded is_signed mismatch");
             }
 
-            // map to unsigned domain
-            std::vector<uint32_t> ref_u, rec_u;
-            map_to_unsigned(ref, ref_u, MAX);
-            map_to_unsigned(rec, rec_u, MAX);
+            // metrics (the |err| histogram comes from the same pass)
+            const mcodec::ImageMetrics met = mcodec::compute_metrics(ref, rec);
 
-            // metrics
-            double psnr = 0.0;
-            double rmse = compute_rmse_psnr(ref_u, rec_u, MAX, psnr);
+            if (!cli.fig_dir.empty()) {
+                // recon (original bit depth)
+                std::string recon_path = (fs::path(cli.fig_dir) / (stem + "_q" + std::to_string(q) + "_recon.pgm")).string();
+                mcodec::save_pgm(recon_path, rec);
 
-            // recon (original bit depth)
-            std::string recon_path = (fs::path(cli.fig_dir) / (stem + "_q" + std::to_string(q) + "_recon.pgm")).string();
-            mcodec::save_pgm(recon_path, rec);
-
-            // error map 8-bit (p99 scaling)
-            std::vector<uint32_t> err(rec_u.size());
-            for (size_t i = 0; i < rec_u.size(); ++i) {
-                uint32_t e = (rec_u[i] > ref_u[i]) ? (rec_u[i] - ref_u[i]) : (ref_u[i] - rec_u[i]);
-                err[i] = e;
-            }
-            uint32_t scale = percentile_p99(err);
-            if (scale == 0) scale = 1;
-            std::vector<uint8_t> err8(err.size());
-            for (size_t i = 0; i < err.size(); ++i) {
-                uint32_t c = std::min(err[i], scale);
-                double v = (255.0 * static_cast<double>(c)) / static_cast<double>(scale);
-                if (v < 0.0) v = 0.0;
-                if (v > 255.0) v = 255.0;
-                err8[i] = static_cast<uint8_t>(std::lround(v));
+                // error map 8-bit (p99 scaling)
+                const uint32_t scale = mcodec::error_percentile(met.error_histogram, 0.99);
+                std::string err_path = (fs::path(cli.fig_dir) / (stem + "_q" + std::to_string(q) + "_err.pgm")).string();
+                mcodec::save_pgm(err_path, mcodec::scaled_error_map(ref, rec, scale));
             }
-            std::string err_path = (fs::path(cli.fig_dir) / (stem + "_q" + std::to_string(q) + "_err.pgm")).string();
-            mcodec::Image err_img;
-            err_img.width = ref.width;
-            err_img.height = ref.height;
-            err_img.channels = 1;
-            err_img.bits_allocated = 8;
-            err_img.bits_stored = 8;
-            err_img.is_signed = false;
-            err_img.type = mcodec::PixelType::U8;
-            err_img.pixels.assign(err8.begin(), err8.end());
-            mcodec::save_pgm(err_path, err_img);
 
             // append CSV
             {
                 std::ofstream ofs(cli.out_csv, std::ios::app);
                 if (!ofs.good()) throw std::runtime_error("Cannot append csv: " + cli.out_csv);
                 ofs << q << ","
-                    << 8 << "," // block_size fixed 8
+                    << block_size << ","
                     << compressed_bytes << ","
                     << bpp << ","
                     << raw_bytes << ","
                     << cr << ","
-                    << rmse << ","
-                    << psnr << "\n";
+                    << met.rmse << ","
+                    << met.psnr << ","
+                    << met.max_abs_error << ","
+                    << met.ssim << ","
+                    << met.ms_ssim << ","
+                    << encode_ms << ","
+                    << decode_ms << ","
+                    << mbps(encode_ms) << ","
+                    << mbps(decode_ms) << ","
+                    << static_cast<double>(mcodec::peak_rss_bytes()) / (1024.0 * 1024.0) << "\n";
             }
         }
 
@@ -259,7 +627,7 @@ int main(int argc, char** argv) {
         return 0;
     } catch (const std::exception& e) {
         std::cerr << "[ERROR] " << e.what() << "\n";
-        std::cerr << "Usage: evaluate --ref <dicom> --quality q1 q2 q3 --tmp_dir <dir> --out <metrics.csv> --fig_dir <dir>\n";
+        std::cerr << kUsage << "\n";
         return 1;
     }
 }
@@ -1,16 +1,21 @@
 #include "io/medical_loader.hpp"
+#include "io/series_index.hpp"
+#include "io/stream_io.hpp"
+#include "util/trace.hpp"
 
 #include <dcmtk/config/osconfig.h>   // MUST be first with DCMTK on some platforms
 #include <dcmtk/dcmdata/dctk.h>
 #include <dcmtk/dcmdata/dcdeftag.h>
 #include <dcmtk/dcmdata/dcxfer.h>
+#include <dcmtk/dcmdata/dcfcache.h>
+#include <dcmtk/dcmdata/dcistrmb.h>
 
 #include <cctype>
 #include <fstream>
 #include <stdexcept>
+#include <streambuf>
 #include <vector>
 #include <filesystem>
-#include <algorithm>
 
 namespace mcodec {
 namespace {
@@ -37,10 +42,18 @@ static std::string lower(std::string s) {
     return s;
 }
 
-static Image load_pgm(const std::string& path) {
-    std::ifstream ifs(path, std::ios::binary);
-    if (!ifs.good()) throw std::runtime_error("Cannot open file: " + path);
+// Read-only istream source over a caller-owned buffer (no copy).
+class MemoryBuf : public std::streambuf {
+public:
+    MemoryBuf(const uint8_t* data, size_t size) {
+        char* p = const_cast<char*>(reinterpret_cast<const char*>(data));
+        setg(p, p, p + size);
+    }
+};
 
+// `path` only names the source in error messages.
+static Image load_pgm(std::istream& ifs, const std::string& path) {
+    MCODEC_TRACE_SCOPE("load.pgm");
     std::string magic;
     ifs >> magic;
     if (magic != "P5") throw std::runtime_error("Only PGM P5 is supported: " + path);
@@ -90,6 +103,12 @@ static Image load_pgm(const std::string& path) {
     return im;
 }
 
+static Image load_pgm(const std::string& path) {
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs.good()) throw std::runtime_error("Cannot open file: " + path);
+    return load_pgm(ifs, path);
+}
+
 static std::runtime_error dcmtk_error(const std::string& where, const OFCondition& cond) {
     return std::runtime_error(where + ": " + cond.text());
 }
@@ -98,57 +117,37 @@ static void require(bool ok, const std::string& msg) {
     if (!ok) throw std::runtime_error(msg);
 }
 
-static int get_instance_number(const std::string& path) {
-    DcmFileFormat file;
-    OFCondition st = file.loadFile(
-        path.c_str(),
-        EXS_Unknown,
-        EGL_noChange,
-        0
-    );
-    if (st.bad()) return 0;
-    DcmDataset* ds = file.getDataset();
-    if (!ds) return 0;
-
-    Sint32 inst = 0;
-    st = ds->findAndGetSint32(DCM_InstanceNumber, inst);
-    if (st.good()) return static_cast<int>(inst);
-    return 0;
-}
-
-static Image load_dicom_file_uncompressed(const std::string& path) {
-    DcmFileFormat file;
-    OFCondition st = file.loadFile(
-        path.c_str(),
-        EXS_Unknown,   // don't force transfer syntax
-        EGL_noChange,  // keep group length encoding
-        DCM_MaxReadLength   // read full value fields (incl. PixelData)
-    );
-    if (st.bad()) throw dcmtk_error("loadFile failed (" + path + ")", st);
+// Pixel-module attributes of an uncompressed grayscale DICOM dataset.
+struct DicomPixelInfo {
+    Uint16 rows = 0, cols = 0;
+    Uint16 bits_stored = 0, bits_allocated = 0;
+    Uint16 pixel_rep = 0; // 0=unsigned, 1=signed
+    Sint32 frames = 1;
 
-    DcmDataset* ds = file.getDataset();
-    require(ds != nullptr, "Dataset is null: " + path);
+    size_t frame_bytes() const {
+        return static_cast<size_t>(rows) * cols * (bits_allocated / 8u);
+    }
+};
 
+static DicomPixelInfo read_pixel_info(DcmDataset* ds, const std::string& path) {
     // Ensure this is not encapsulated/compressed (you said you already converted to uncompressed)
     const DcmXfer xfer(ds->getOriginalXfer());
     require(!xfer.isEncapsulated(),
             "Compressed/encapsulated DICOM detected (TransferSyntax=" + std::string(xfer.getXferName()) +
             "). Please convert to uncompressed first: " + path);
 
-    Uint16 rows = 0, cols = 0;
-    Uint16 bitsStored = 0, bitsAllocated = 0;
-    Uint16 pixelRep = 0; // 0=unsigned, 1=signed
+    DicomPixelInfo info;
     Uint16 spp = 1;
 
-    st = ds->findAndGetUint16(DCM_Rows, rows);
+    OFCondition st = ds->findAndGetUint16(DCM_Rows, info.rows);
     if (st.bad()) throw dcmtk_error("Missing/invalid Rows", st);
-    st = ds->findAndGetUint16(DCM_Columns, cols);
+    st = ds->findAndGetUint16(DCM_Columns, info.cols);
     if (st.bad()) throw dcmtk_error("Missing/invalid Columns", st);
-    st = ds->findAndGetUint16(DCM_BitsStored, bitsStored);
+    st = ds->findAndGetUint16(DCM_BitsStored, info.bits_stored);
     if (st.bad()) throw dcmtk_error("Missing/invalid BitsStored", st);
-    st = ds->findAndGetUint16(DCM_BitsAllocated, bitsAllocated);
+    st = ds->findAndGetUint16(DCM_BitsAllocated, info.bits_allocated);
     if (st.bad()) throw dcmtk_error("Missing/invalid BitsAllocated", st);
-    st = ds->findAndGetUint16(DCM_PixelRepresentation, pixelRep);
+    st = ds->findAndGetUint16(DCM_PixelRepresentation, info.pixel_rep);
     if (st.bad()) throw dcmtk_error("Missing/invalid PixelRepresentation", st);
 
     st = ds->findAndGetUint16(DCM_SamplesPerPixel, spp);
@@ -163,89 +162,242 @@ static Image load_dicom_file_uncompressed(const std::string& path) {
                 "Unsupported PhotometricInterpretation: " + std::string(photo.c_str()) + " (" + path + ")");
     }
 
-    // Multi-frame (optional) - keep it simple for now
-    Sint32 nFrames = 1;
-    st = ds->findAndGetSint32(DCM_NumberOfFrames, nFrames);
-    if (st.good()) require(nFrames >= 1, "Invalid NumberOfFrames (" + path + ")");
-    else nFrames = 1;
-    require(nFrames == 1, "Only single-frame DICOM is supported (NumberOfFrames=1): " + path);
+    st = ds->findAndGetSint32(DCM_NumberOfFrames, info.frames);
+    if (st.good()) require(info.frames >= 1, "Invalid NumberOfFrames (" + path + ")");
+    else info.frames = 1;
 
-    require(bitsAllocated == 16 || bitsAllocated == 8,
+    require(info.bits_allocated == 16 || info.bits_allocated == 8,
             "Only BitsAllocated=8 or 16 is supported: " + path);
-    require(bitsStored >= 1 && bitsStored <= bitsAllocated,
+    require(info.bits_stored >= 1 && info.bits_stored <= info.bits_allocated,
             "Invalid BitsStored: " + path);
+    return info;
+}
 
-    const size_t W = static_cast<size_t>(cols);
-    const size_t H = static_cast<size_t>(rows);
-    const size_t N = W * H;
-
+// Image with geometry filled in and pixels sized (but not set).
+static Image make_image(const DicomPixelInfo& info) {
     Image im;
-    im.width = static_cast<int>(cols);
-    im.height = static_cast<int>(rows);
+    im.width = static_cast<int>(info.cols);
+    im.height = static_cast<int>(info.rows);
     im.channels = 1;
-    im.bits_stored = static_cast<int>(bitsStored);
-    im.bits_allocated = static_cast<int>(bitsAllocated);
-    im.is_signed = (pixelRep == 1);
-    im.type = im.is_signed ? PixelType::S16 : (bitsAllocated <= 8 ? PixelType::U8 : PixelType::U16);
-    im.pixels.resize(N);
+    im.bits_stored = static_cast<int>(info.bits_stored);
+    im.bits_allocated = static_cast<int>(info.bits_allocated);
+    im.is_signed = (info.pixel_rep == 1);
+    im.type = im.is_signed ? PixelType::S16 : (info.bits_allocated <= 8 ? PixelType::U8 : PixelType::U16);
+    im.pixels.resize(static_cast<size_t>(info.cols) * info.rows);
+    return im;
+}
+
+// View of the first frame of an in-memory dataset's PixelData (DCMTK-owned buffer).
+static PixelView pixel_view(DcmDataset* ds, const DicomPixelInfo& info, const std::string& where) {
+    PixelView v;
+    v.width = static_cast<int>(info.cols);
+    v.height = static_cast<int>(info.rows);
+    v.bits_stored = static_cast<int>(info.bits_stored);
+    v.bits_allocated = static_cast<int>(info.bits_allocated);
+    v.is_signed = (info.pixel_rep == 1);
 
-    if (bitsAllocated == 8) {
+    if (info.bits_allocated == 8) {
         const Uint8* u8 = nullptr;
-        st = ds->findAndGetUint8Array(DCM_PixelData, u8);
-        if (st.bad() || !u8) throw dcmtk_error("Failed to read Uint8 PixelData", st);
-        for (size_t i = 0; i < N; ++i) im.pixels[i] = static_cast<int32_t>(u8[i]);
-        return im;
+        OFCondition st = ds->findAndGetUint8Array(DCM_PixelData, u8);
+        if (st.bad() || !u8) throw dcmtk_error("Failed to read Uint8 PixelData (" + where + ")", st);
+        v.type = PixelType::U8;
+        v.data = u8;
+        return v;
     }
 
     // BitsAllocated == 16
     // Some DICOMs (PixelData VR=OW) may fail with findAndGetSint16Array even when signed.
-    // Try Uint16 first, then fallback.
+    // Try Uint16 first (bit pattern is kept, type says how to read it), then fallback.
+    v.type = v.is_signed ? PixelType::S16 : PixelType::U16;
     const Uint16* u16 = nullptr;
     OFCondition st_u16 = ds->findAndGetUint16Array(DCM_PixelData, u16);
     if (st_u16.good() && u16) {
-        for (size_t i = 0; i < N; ++i) {
-            if (im.is_signed) {
-                const int16_t s = static_cast<int16_t>(u16[i]); // preserve bit-pattern
-                im.pixels[i] = static_cast<int32_t>(s);
-            } else {
-                im.pixels[i] = static_cast<int32_t>(u16[i]);
-            }
-        }
-        return im;
+        v.data = u16;
+        return v;
     }
 
     const Sint16* s16 = nullptr;
     OFCondition st_s16 = ds->findAndGetSint16Array(DCM_PixelData, s16);
     if (st_s16.bad() || !s16) {
-        throw dcmtk_error("Failed to read Uint16 PixelData", st_u16);
+        throw dcmtk_error("Failed to read Uint16 PixelData (" + where + ")", st_u16);
+    }
+    v.data = s16;
+    return v;
+}
+
+// Widen a view into Image::pixels (which make_image already sized).
+static void widen_into(const PixelView& v, Image& im) {
+    const size_t N = im.pixels.size();
+    switch (v.type) {
+    case PixelType::U8: {
+        const uint8_t* p = static_cast<const uint8_t*>(v.data);
+        for (size_t i = 0; i < N; ++i) im.pixels[i] = static_cast<int32_t>(p[i]);
+        break;
+    }
+    case PixelType::U16: {
+        const uint16_t* p = static_cast<const uint16_t*>(v.data);
+        for (size_t i = 0; i < N; ++i) im.pixels[i] = static_cast<int32_t>(p[i]);
+        break;
     }
-    for (size_t i = 0; i < N; ++i) im.pixels[i] = static_cast<int32_t>(s16[i]);
+    case PixelType::S16: {
+        const int16_t* p = static_cast<const int16_t*>(v.data); // preserve bit-pattern
+        for (size_t i = 0; i < N; ++i) im.pixels[i] = static_cast<int32_t>(p[i]);
+        break;
+    }
+    }
+}
+
+static Image load_dicom_file_uncompressed(const std::string& path) {
+    MCODEC_TRACE_SCOPE("load.dicom");
+    DcmFileFormat file;
+    OFCondition st = file.loadFile(
+        path.c_str(),
+        EXS_Unknown,   // don't force transfer syntax
+        EGL_noChange,  // keep group length encoding
+        DCM_MaxReadLength   // large values (PixelData) stay on disk until accessed
+    );
+    if (st.bad()) throw dcmtk_error("loadFile failed (" + path + ")", st);
+
+    DcmDataset* ds = file.getDataset();
+    require(ds != nullptr, "Dataset is null: " + path);
+
+    const DicomPixelInfo info = read_pixel_info(ds, path);
+
+    // Multi-frame: stream only the first frame instead of loading all of PixelData
+    if (info.frames > 1) {
+        DicomFrameReader reader(path);
+        return reader.read_frame(0);
+    }
+
+    Image im = make_image(info);
+    widen_into(pixel_view(ds, info, path), im);
     return im;
 }
 
 } // namespace
 
+// ---------------- DicomFrameReader ---------------- //
+struct DicomFrameReader::Impl {
+    std::string path;
+    DcmFileFormat file;
+    DcmElement* pixel_data = nullptr;
+    DcmFileCache cache;            // keeps the file handle open between frames
+    DicomPixelInfo info;
+    std::vector<uint8_t> raw;      // one frame of stored samples
+};
+
+DicomFrameReader::DicomFrameReader(const std::string& path) : impl_(new Impl) {
+    impl_->path = path;
+    // PixelData is larger than DCM_MaxReadLength, so it is not read here;
+    // read_frame() pulls individual frames with partial value access.
+    OFCondition st = impl_->file.loadFile(path.c_str(), EXS_Unknown, EGL_noChange, DCM_MaxReadLength);
+    if (st.bad()) throw dcmtk_error("loadFile failed (" + path + ")", st);
+
+    DcmDataset* ds = impl_->file.getDataset();
+    require(ds != nullptr, "Dataset is null: " + path);
+    impl_->info = read_pixel_info(ds, path);
+
+    st = ds->findAndGetElement(DCM_PixelData, impl_->pixel_data);
+    if (st.bad() || !impl_->pixel_data) throw dcmtk_error("Missing PixelData (" + path + ")", st);
+
+    const uint64_t need = static_cast<uint64_t>(impl_->info.frame_bytes()) *
+                          static_cast<uint64_t>(impl_->info.frames);
+    require(impl_->pixel_data->getLength() >= need,
+            "PixelData shorter than Rows x Columns x NumberOfFrames: " + path);
+    impl_->raw.resize(impl_->info.frame_bytes());
+}
+
+DicomFrameReader::~DicomFrameReader() = default;
+
+int DicomFrameReader::frame_count() const { return static_cast<int>(impl_->info.frames); }
+
+PixelView DicomFrameReader::frame_view(int index) {
+    MCODEC_TRACE_SCOPE("load.frame");
+    const DicomPixelInfo& info = impl_->info;
+    require(index >= 0 && index < info.frames,
+            "Frame index out of range (" + std::to_string(index) + "): " + impl_->path);
+
+    const size_t frame_bytes = info.frame_bytes();
+    const Uint32 offset = static_cast<Uint32>(frame_bytes * static_cast<size_t>(index));
+    OFCondition st = impl_->pixel_data->getPartialValue(impl_->raw.data(), offset,
+                                                         static_cast<Uint32>(frame_bytes),
+                                                         &impl_->cache, gLocalByteOrder);
+    if (st.bad()) throw dcmtk_error("Failed to read frame " + std::to_string(index) + " (" + impl_->path + ")", st);
+
+    PixelView v;
+    v.data = impl_->raw.data();
+    v.width = static_cast<int>(info.cols);
+    v.height = static_cast<int>(info.rows);
+    v.bits_stored = static_cast<int>(info.bits_stored);
+    v.bits_allocated = static_cast<int>(info.bits_allocated);
+    v.is_signed = (info.pixel_rep == 1);
+    v.type = (info.bits_allocated == 8) ? PixelType::U8 : (v.is_signed ? PixelType::S16 : PixelType::U16);
+    return v;
+}
+
+Image DicomFrameReader::read_frame(int index) {
+    const PixelView v = frame_view(index);
+    Image im = make_image(impl_->info); // widen this frame only
+    widen_into(v, im);
+    return im;
+}
+
+int dicom_frame_count(const std::string& path) {
+    DcmFileFormat file;
+    OFCondition st = file.loadFile(path.c_str(), EXS_Unknown, EGL_noChange, DCM_MaxReadLength);
+    if (st.bad()) throw dcmtk_error("loadFile failed (" + path + ")", st);
+    DcmDataset* ds = file.getDataset();
+    require(ds != nullptr, "Dataset is null: " + path);
+    return static_cast<int>(read_pixel_info(ds, path).frames);
+}
+
+PixelView dicom_pixel_view(DcmDataset* ds) {
+    require(ds != nullptr, "dicom_pixel_view: dataset is null");
+    const DicomPixelInfo info = read_pixel_info(ds, "<dataset>");
+    return pixel_view(ds, info, "<dataset>");
+}
+
+Image load_medical_bytes(const std::vector<uint8_t>& bytes, const std::string& name) {
+    if (bytes.size() >= 2 && bytes[0] == 'P' && bytes[1] == '5') {
+        MemoryBuf buf(bytes.data(), bytes.size());
+        std::istream is(&buf);
+        return load_pgm(is, name);
+    }
+
+    MCODEC_TRACE_SCOPE("load.dicom");
+    DcmInputBufferStream is;
+    is.setBuffer(bytes.data(), static_cast<offile_off_t>(bytes.size()));
+    is.setEos();
+    DcmFileFormat file;
+    file.transferInit();
+    OFCondition st = file.read(is, EXS_Unknown, EGL_noChange);
+    file.transferEnd();
+    if (st.bad()) throw dcmtk_error("Load failed (not supported PGM/DICOM) (" + name + ")", st);
+
+    DcmDataset* ds = file.getDataset();
+    require(ds != nullptr, "Dataset is null: " + name);
+    const DicomPixelInfo info = read_pixel_info(ds, name);
+    Image im = make_image(info);
+    widen_into(pixel_view(ds, info, name), im); // first frame of a multi-frame buffer
+    return im;
+}
+
 Image load_medical(const std::string& path) {
     namespace fs = std::filesystem;
 
-    // directory: treat as a DICOM series folder; load the first slice (sorted by InstanceNumber)
+    if (is_stdio_path(path)) return load_medical_bytes(read_input(path), "<stdin>");
+
+    // directory: treat as a DICOM series folder; load the first slice of the series index
     if (fs::exists(path) && fs::is_directory(path)) {
-        struct Item { std::string p; int inst; };
-        std::vector<Item> items;
-        for (auto& ent : fs::directory_iterator(path)) {
-            if (!ent.is_regular_file()) continue;
-            const std::string p = ent.path().string();
-            items.push_back({p, get_instance_number(p)});
-        }
-        require(!items.empty(), "No files in folder: " + path);
-        std::sort(items.begin(), items.end(), [](const Item& a, const Item& b) { return a.inst < b.inst; });
+        const SeriesIndex idx = index_dicom_series(path);
+        require(!idx.entries.empty(), "No readable DICOM found in folder: " + path);
 
         // 找第一個可讀的 DICOM
-        for (const auto& it : items) {
+        for (const auto& e : idx.entries) {
             try {
-                return load_dicom_file_uncompressed(it.p);
+                return load_dicom_file_uncompressed(e.path);
             } catch (...) {
-                // skip non-dicom or broken files
+                // skip broken files
             }
         }
         throw std::runtime_error("No readable DICOM found in folder: " + path);
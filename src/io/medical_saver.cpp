@@ -1,42 +1,79 @@
 #include "io/medical_saver.hpp"
+#include "io/stream_io.hpp"
+#include "util/trace.hpp"
 
 #include <fstream>
+#include <iostream>
 #include <stdexcept>
+#include <vector>
 
 namespace mcodec {
 
-void save_pgm(const std::string& path, const Image& im) {
+void save_pgm(std::ostream& ofs, const Image& im) {
+    MCODEC_TRACE_SCOPE("save.pgm");
     if (im.channels != 1) throw std::runtime_error("Only grayscale is supported for PGM output");
     if (im.width <= 0 || im.height <= 0) throw std::runtime_error("Invalid image size");
     if (static_cast<int>(im.pixels.size()) != im.width * im.height) throw std::runtime_error("pixel buffer size mismatch");
 
     const int maxv = (im.bits_stored <= 8) ? 255 : ((1 << im.bits_stored) - 1);
-    std::ofstream ofs(path, std::ios::binary);
-    if (!ofs.good()) throw std::runtime_error("Cannot write file: " + path);
-
     ofs << "P5\n" << im.width << " " << im.height << "\n" << maxv << "\n";
 
-    if (maxv == 255) {
-        for (int i = 0; i < im.width * im.height; ++i) {
-            int32_t v = im.pixels[static_cast<size_t>(i)];
+    // One row at a time, so a pipe reader sees data while later rows are converted.
+    // PGM 16-bit expects big-endian; maxv may be < 65535 (e.g., 12-bit => 4095)
+    const size_t sample_bytes = (maxv == 255) ? 1 : 2;
+    std::vector<char> row(static_cast<size_t>(im.width) * sample_bytes);
+    for (int y = 0; y < im.height; ++y) {
+        const int32_t* src = im.pixels.data() + static_cast<size_t>(y) * static_cast<size_t>(im.width);
+        for (int x = 0; x < im.width; ++x) {
+            int32_t v = src[x];
             if (v < 0) v = 0;
             if (v > maxv) v = maxv;
-            uint8_t b = static_cast<uint8_t>(v);
-            ofs.put(static_cast<char>(b));
-        }
-    } else {
-        // PGM 16-bit expects big-endian; maxv may be < 65535 (e.g., 12-bit => 4095)
-        for (int i = 0; i < im.width * im.height; ++i) {
-            int32_t v = im.pixels[static_cast<size_t>(i)];
-            if (v < 0) v = 0;
-            if (v > maxv) v = maxv;
-            uint16_t u = static_cast<uint16_t>(v);
-            uint8_t hi = static_cast<uint8_t>((u >> 8) & 0xFF);
-            uint8_t lo = static_cast<uint8_t>(u & 0xFF);
-            ofs.put(static_cast<char>(hi));
-            ofs.put(static_cast<char>(lo));
+            if (sample_bytes == 1) {
+                row[static_cast<size_t>(x)] = static_cast<char>(static_cast<uint8_t>(v));
+            } else {
+                const uint16_t u = static_cast<uint16_t>(v);
+                row[2 * static_cast<size_t>(x)] = static_cast<char>((u >> 8) & 0xFF);
+                row[2 * static_cast<size_t>(x) + 1] = static_cast<char>(u & 0xFF);
+            }
         }
+        ofs.write(row.data(), static_cast<std::streamsize>(row.size()));
+    }
+    ofs.flush();
+    if (!ofs.good()) throw std::runtime_error("PGM write failed");
+}
+
+void save_pgm(const std::string& path, const Image& im) {
+    if (is_stdio_path(path)) {
+        set_stdio_binary();
+        save_pgm(std::cout, im);
+        return;
     }
+    std::ofstream ofs(path, std::ios::binary);
+    if (!ofs.good()) throw std::runtime_error("Cannot write file: " + path);
+    save_pgm(ofs, im);
+}
+
+void save_pgm(std::ostream& ofs, const DisplayImage& im) {
+    MCODEC_TRACE_SCOPE("save.pgm");
+    if (im.width <= 0 || im.height <= 0) throw std::runtime_error("Invalid image size");
+    if (im.pixels.size() != static_cast<size_t>(im.width) * static_cast<size_t>(im.height)) {
+        throw std::runtime_error("pixel buffer size mismatch");
+    }
+    ofs << "P5\n" << im.width << " " << im.height << "\n255\n";
+    ofs.write(reinterpret_cast<const char*>(im.pixels.data()), static_cast<std::streamsize>(im.pixels.size()));
+    ofs.flush();
+    if (!ofs.good()) throw std::runtime_error("PGM write failed");
+}
+
+void save_pgm(const std::string& path, const DisplayImage& im) {
+    if (is_stdio_path(path)) {
+        set_stdio_binary();
+        save_pgm(std::cout, im);
+        return;
+    }
+    std::ofstream ofs(path, std::ios::binary);
+    if (!ofs.good()) throw std::runtime_error("Cannot write file: " + path);
+    save_pgm(ofs, im);
 }
 
 } // namespace mcodec
@@ -0,0 +1,310 @@
+#include "io/series_index.hpp"
+
+#include "util/parallel.hpp"
+#include "util/trace.hpp"
+
+#include <dcmtk/config/osconfig.h>   // MUST be first with DCMTK on some platforms
+#include <dcmtk/dcmdata/dctk.h>
+#include <dcmtk/dcmdata/dcdeftag.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace mcodec {
+namespace {
+
+namespace fs = std::filesystem;
+
+// Identity of a file on disk; a change means the cached header keys are stale.
+struct FileStamp {
+    uintmax_t size = 0;
+    fs::file_time_type mtime{};
+    bool operator==(const FileStamp& o) const { return size == o.size && mtime == o.mtime; }
+};
+
+struct CachedFile {
+    FileStamp stamp;
+    bool is_image = false; // false: not DICOM, or DICOM without an image
+    SeriesEntry entry;
+};
+
+struct FolderCache {
+    std::unordered_map<std::string, CachedFile> files; // key: file name
+    SeriesIndex index;
+    bool indexed = false; // false: files loaded from the index cache, index not built yet
+};
+
+std::mutex g_cache_mutex;
+std::unordered_map<std::string, FolderCache> g_cache; // key: absolute folder path
+
+// Parse the header of one file. Parsing stops at PixelData, so only the
+// (small) attribute section before the pixels is read from disk.
+CachedFile parse_header(const std::string& path, const FileStamp& stamp) {
+    MCODEC_TRACE_SCOPE("index.parse_header");
+    CachedFile cf;
+    cf.stamp = stamp;
+    cf.entry.path = path;
+
+    DcmFileFormat file;
+    OFCondition st = file.loadFileUntilTag(
+        path.c_str(),
+        EXS_Unknown,
+        EGL_noChange,
+        DCM_MaxReadLength,
+        ERM_autoDetect,
+        DCM_PixelData   // stop before the pixel data element
+    );
+    if (st.bad()) return cf;
+    DcmDataset* ds = file.getDataset();
+    if (!ds) return cf;
+
+    // Only image files take part in the series (skips DICOMDIR, SR, ...).
+    Uint16 rows = 0;
+    if (ds->findAndGetUint16(DCM_Rows, rows).bad() || rows == 0) return cf;
+    cf.is_image = true;
+
+    Sint32 inst = 0;
+    if (ds->findAndGetSint32(DCM_InstanceNumber, inst).good()) {
+        cf.entry.instance_number = static_cast<int>(inst);
+    }
+    OFString uid;
+    if (ds->findAndGetOFString(DCM_SeriesInstanceUID, uid).good()) {
+        cf.entry.series_uid = uid.c_str();
+    }
+    bool has_pos = true;
+    for (unsigned long k = 0; k < 3; ++k) {
+        Float64 v = 0.0;
+        if (ds->findAndGetFloat64(DCM_ImagePositionPatient, v, k).bad()) {
+            has_pos = false;
+            break;
+        }
+        cf.entry.position[k] = static_cast<double>(v);
+    }
+    cf.entry.has_position = has_pos;
+    return cf;
+}
+
+// On-disk index cache (opt-in, kSeriesIndexCacheEnv): one file per folder in the
+// user's cache directory, never in the DICOM folder itself. The file holds a magic
+// line, the folder path, then one line per file of the folder
+//   size, mtime ticks, is_image, instance_number, has_position, x, y, z, series_uid, file name
+// tab-separated, the name last (it may contain tabs; names with a newline are not stored).
+constexpr const char* kIndexMagic = "mcodec-series-index 2";
+constexpr int kIndexFields = 9; // before the file name
+
+// Cache directory from kSeriesIndexCacheEnv; empty when the on-disk index is off.
+// "1" picks the platform cache directory, any other value is the directory itself.
+fs::path index_cache_dir() {
+    const char* env = std::getenv(kSeriesIndexCacheEnv);
+    if (!env || !*env || std::string(env) == "0") return {};
+    if (std::string(env) != "1") return fs::path(env);
+#if defined(_WIN32)
+    if (const char* local = std::getenv("LOCALAPPDATA"); local && *local) return fs::path(local) / "mcodec";
+#else
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) return fs::path(xdg) / "mcodec";
+    if (const char* home = std::getenv("HOME"); home && *home) return fs::path(home) / ".cache" / "mcodec";
+#endif
+    return {};
+}
+
+// Index file of a folder: named by a hash of its absolute path (FNV-1a); the path
+// itself is stored inside and checked on load, so a collision only costs a re-parse.
+fs::path index_cache_file(const fs::path& cache_dir, const std::string& key) {
+    uint64_t h = 1469598103934665603ull;
+    for (unsigned char c : key) h = (h ^ c) * 1099511628211ull;
+    char name[40];
+    std::snprintf(name, sizeof(name), "series-%016llx.idx", static_cast<unsigned long long>(h));
+    return cache_dir / name;
+}
+
+int process_id() {
+#if defined(_WIN32)
+    return _getpid();
+#else
+    return static_cast<int>(::getpid());
+#endif
+}
+
+// Cached files of a folder from its index file; empty if there is none, it belongs to
+// another folder or it does not parse.
+std::unordered_map<std::string, CachedFile> load_index(const fs::path& file, const std::string& key) {
+    std::unordered_map<std::string, CachedFile> files;
+    std::ifstream in(file, std::ios::binary);
+    std::string line;
+    if (!in || !std::getline(in, line) || line != kIndexMagic) return files;
+    if (!std::getline(in, line) || line != key) return files;
+    std::string f[kIndexFields];
+    while (std::getline(in, line)) {
+        size_t start = 0;
+        for (std::string& field : f) {
+            const size_t tab = line.find('\t', start);
+            if (tab == std::string::npos) return {};
+            field = line.substr(start, tab - start);
+            start = tab + 1;
+        }
+        CachedFile cf;
+        try {
+            cf.stamp.size = static_cast<uintmax_t>(std::stoull(f[0]));
+            cf.stamp.mtime = fs::file_time_type(fs::file_time_type::duration(std::stoll(f[1])));
+            cf.is_image = (f[2] == "1");
+            cf.entry.instance_number = std::stoi(f[3]);
+            cf.entry.has_position = (f[4] == "1");
+            for (int k = 0; k < 3; ++k) cf.entry.position[k] = std::stod(f[5 + k]);
+        } catch (const std::exception&) {
+            return {}; // damaged index: re-parse the folder
+        }
+        cf.entry.series_uid = f[8];
+        files.emplace(line.substr(start), std::move(cf));
+    }
+    return files;
+}
+
+// Rewrite the index file through a temporary file with a name unique to this process
+// and call, so concurrent writers never share one and a reader never sees half a file.
+// Returns false if the cache directory cannot be written.
+bool save_index(const fs::path& file, const std::string& key, const std::unordered_map<std::string, CachedFile>& files) {
+    static std::atomic<unsigned> seq{0};
+    std::error_code ec;
+    fs::create_directories(file.parent_path(), ec);
+    fs::path tmp = file;
+    tmp += "." + std::to_string(process_id()) + "-" + std::to_string(seq.fetch_add(1)) + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out.precision(17);
+        out << kIndexMagic << '\n' << key << '\n';
+        for (const auto& [name, cf] : files) {
+            if (name.find('\n') != std::string::npos) continue;
+            const SeriesEntry& e = cf.entry;
+            out << cf.stamp.size << '\t' << static_cast<long long>(cf.stamp.mtime.time_since_epoch().count()) << '\t'
+                << (cf.is_image ? 1 : 0) << '\t' << e.instance_number << '\t' << (e.has_position ? 1 : 0) << '\t'
+                << e.position[0] << '\t' << e.position[1] << '\t' << e.position[2] << '\t'
+                << e.series_uid << '\t' << name << '\n';
+        }
+        out.flush();
+        if (!out) {
+            out.close();
+            fs::remove(tmp, ec);
+            return false;
+        }
+    }
+    fs::rename(tmp, file, ec);
+    if (ec) {
+        fs::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
+
+bool entry_less(const SeriesEntry& a, const SeriesEntry& b) {
+    if (a.series_uid != b.series_uid) return a.series_uid < b.series_uid;
+    if (a.instance_number != b.instance_number) return a.instance_number < b.instance_number;
+    if (a.has_position && b.has_position && a.position[2] != b.position[2]) {
+        return a.position[2] < b.position[2];
+    }
+    return a.path < b.path;
+}
+
+} // namespace
+
+SeriesIndex index_dicom_series(const std::string& dir) {
+    if (!fs::is_directory(dir)) throw std::runtime_error("Not a directory: " + dir);
+    MCODEC_TRACE_SCOPE("index.series");
+    const std::string key = fs::absolute(dir).lexically_normal().string();
+    const fs::path cache_dir = index_cache_dir();
+    const fs::path cache_file = cache_dir.empty() ? fs::path() : index_cache_file(cache_dir, key);
+
+    // Stat every file; this is cheap compared to parsing and detects changes.
+    struct Listed { std::string path; std::string name; FileStamp stamp; };
+    std::vector<Listed> listed;
+    for (auto& ent : fs::directory_iterator(dir)) {
+        if (!ent.is_regular_file()) continue;
+        std::string name = ent.path().filename().string();
+        std::error_code ec;
+        FileStamp stamp;
+        stamp.size = ent.file_size(ec);
+        if (!ec) stamp.mtime = ent.last_write_time(ec);
+        if (ec) continue;
+        listed.push_back({ent.path().string(), std::move(name), stamp});
+    }
+
+    // Split into cache hits and files that need (re)parsing. With the on-disk index on,
+    // the first call for a folder in this process starts from the file an earlier process left.
+    std::vector<CachedFile> parsed(listed.size());
+    std::vector<size_t> todo;
+    bool stale = false; // the cached files no longer match the folder
+    {
+        std::lock_guard<std::mutex> lock(g_cache_mutex);
+        auto it = g_cache.find(key);
+        if (it == g_cache.end()) {
+            FolderCache fc;
+            if (!cache_file.empty()) fc.files = load_index(cache_file, key);
+            it = g_cache.emplace(key, std::move(fc)).first;
+        }
+        const auto& files = it->second.files;
+        stale = (files.size() != listed.size());
+        for (size_t i = 0; i < listed.size(); ++i) {
+            auto f = files.find(listed[i].name);
+            if (f != files.end() && f->second.stamp == listed[i].stamp) {
+                parsed[i] = f->second;
+                parsed[i].entry.path = listed[i].path;
+            } else {
+                todo.push_back(i);
+                stale = true;
+            }
+        }
+        if (!stale && it->second.indexed) {
+            SeriesIndex idx = it->second.index;
+            idx.dir = dir;
+            for (SeriesEntry& e : idx.entries) e.path = (fs::path(dir) / fs::path(e.path).filename()).string();
+            return idx;
+        }
+    }
+
+    parallel_for(todo.size(), [&](size_t k) {
+        const size_t i = todo[k];
+        parsed[i] = parse_header(listed[i].path, listed[i].stamp);
+    });
+
+    FolderCache fc;
+    fc.index.dir = dir;
+    fc.indexed = true;
+    for (size_t i = 0; i < parsed.size(); ++i) {
+        if (parsed[i].is_image) fc.index.entries.push_back(parsed[i].entry);
+        fc.files.emplace(listed[i].name, std::move(parsed[i]));
+    }
+    std::sort(fc.index.entries.begin(), fc.index.entries.end(), entry_less);
+    if (stale && !cache_file.empty() && !save_index(cache_file, key, fc.files)) {
+        static std::atomic<bool> warned{false};
+        if (!warned.exchange(true)) {
+            std::cerr << "[WARN] " << kSeriesIndexCacheEnv << ": cannot write " << cache_dir.string()
+                      << ", the series index is kept in memory only\n";
+        }
+    }
+
+    SeriesIndex result = fc.index;
+    {
+        std::lock_guard<std::mutex> lock(g_cache_mutex);
+        g_cache[key] = std::move(fc);
+    }
+    return result;
+}
+
+} // namespace mcodec
@@ -0,0 +1,76 @@
+#include "io/stream_io.hpp"
+#include "util/trace.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace mcodec {
+
+namespace {
+
+constexpr size_t kChunkBytes = 64 * 1024;
+
+struct FileCloser {
+    void operator()(std::FILE* f) const { std::fclose(f); }
+};
+
+} // namespace
+
+void set_stdio_binary() {
+#if defined(_WIN32)
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+}
+
+std::vector<uint8_t> read_input(const std::string& path) {
+    MCODEC_TRACE_SCOPE("read.input");
+    std::unique_ptr<std::FILE, FileCloser> owned;
+    std::FILE* f = stdin;
+    if (is_stdio_path(path)) {
+        set_stdio_binary();
+    } else {
+        owned.reset(std::fopen(path.c_str(), "rb"));
+        if (!owned) throw std::runtime_error("Cannot open file: " + path);
+        f = owned.get();
+    }
+
+    std::vector<uint8_t> buf;
+    size_t used = 0;
+    for (;;) {
+        if (buf.size() - used < kChunkBytes) buf.resize(std::max(buf.size() * 2, used + kChunkBytes));
+        const size_t n = std::fread(buf.data() + used, 1, buf.size() - used, f);
+        used += n;
+        if (n == 0) break;
+    }
+    if (std::ferror(f)) throw std::runtime_error("Read error: " + path);
+    buf.resize(used);
+    return buf;
+}
+
+void write_output(const std::string& path, const uint8_t* data, size_t n) {
+    MCODEC_TRACE_SCOPE("write.output");
+    std::unique_ptr<std::FILE, FileCloser> owned;
+    std::FILE* f = stdout;
+    if (is_stdio_path(path)) {
+        set_stdio_binary();
+    } else {
+        owned.reset(std::fopen(path.c_str(), "wb"));
+        if (!owned) throw std::runtime_error("Cannot write file: " + path);
+        f = owned.get();
+    }
+    for (size_t off = 0; off < n; off += kChunkBytes) {
+        const size_t len = std::min(kChunkBytes, n - off);
+        if (std::fwrite(data + off, 1, len, f) != len) throw std::runtime_error("Write error: " + path);
+    }
+    if (std::fflush(f) != 0) throw std::runtime_error("Write error: " + path);
+}
+
+} // namespace mcodec
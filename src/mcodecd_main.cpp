@@ -0,0 +1,45 @@
+#include "cli/cli_parser.hpp"
+#include "service/codec_service.hpp"
+
+#include <csignal>
+#include <iostream>
+
+static void on_signal(int) {
+    mcodec::stop_codec_service();
+}
+
+int main(int argc, char** argv) {
+    try {
+        mcodec::CliParser cli;
+        cli.parse(argc, argv);
+        const std::string socket_path = cli.get("socket");
+        if (socket_path.empty()) {
+            std::cerr << "Usage: mcodecd --socket <path> [--max_connections N]\n"
+                         "       mcodecd --socket <path> --query_stats\n";
+            return 1;
+        }
+
+        // --query_stats: print the latency histograms of a running daemon
+        if (cli.has("query_stats")) {
+            mcodec::ServiceClient client(socket_path);
+            std::cout << client.stats_json() << "\n";
+            return 0;
+        }
+
+        mcodec::ServiceOptions opt;
+        opt.socket_path = socket_path;
+        opt.max_connections = static_cast<unsigned>(std::stoul(cli.get("max_connections", "64")));
+        std::signal(SIGINT, on_signal);
+        std::signal(SIGTERM, on_signal);
+#ifdef SIGPIPE
+        std::signal(SIGPIPE, SIG_IGN); // a client that goes away must not kill the daemon
+#endif
+        std::cout << "mcodecd: listening on " << socket_path << std::endl;
+        mcodec::run_codec_service(opt);
+        std::cout << "mcodecd: stopped\n" << mcodec::codec_service_stats_json() << "\n";
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "[ERROR] " << e.what() << "\n";
+        return 2;
+    }
+}
@@ -0,0 +1,351 @@
+#include "metrics/metrics.hpp"
+
+#include "util/parallel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace mcodec {
+
+namespace {
+
+constexpr int kWin = 11;       // SSIM window
+constexpr double kSigma = 1.5;
+constexpr double kK1 = 0.01;
+constexpr double kK2 = 0.03;
+constexpr std::array<double, 5> kMsWeights = {0.0448, 0.2856, 0.3001, 0.2363, 0.1333};
+
+// Row ranges [r0, r1) for `chunks` workers.
+struct RowChunks {
+    int rows;
+    size_t chunks;
+    int begin(size_t c) const { return static_cast<int>(static_cast<int64_t>(rows) * c / chunks); }
+    int end(size_t c) const { return begin(c + 1); }
+};
+
+RowChunks row_chunks(int rows, unsigned threads) {
+    const unsigned t = threads == 0 ? default_thread_count() : threads;
+    return RowChunks{rows, std::max<size_t>(1, std::min<size_t>(t, static_cast<size_t>(rows)))};
+}
+
+std::array<double, kWin> gaussian_window() {
+    std::array<double, kWin> g{};
+    double sum = 0.0;
+    for (int i = 0; i < kWin; ++i) {
+        const double d = i - kWin / 2;
+        g[static_cast<size_t>(i)] = std::exp(-(d * d) / (2.0 * kSigma * kSigma));
+        sum += g[static_cast<size_t>(i)];
+    }
+    for (double& v : g) v /= sum;
+    return g;
+}
+
+// evaluate's map_to_unsigned: signed samples are offset, then everything is clipped to [0, maxv].
+inline uint32_t to_unsigned(int32_t s, bool is_signed, int32_t offset, uint32_t maxv) {
+    if (is_signed) return std::min(static_cast<uint32_t>(s + offset), maxv);
+    return s < 0 ? 0u : std::min(static_cast<uint32_t>(s), maxv);
+}
+
+struct SsimMeans {
+    double ssim = 1.0;
+    double cs = 1.0; // contrast-structure term only (MS-SSIM)
+};
+
+// Mean SSIM / CS over the 'valid' window positions. x and y are scaled to [0, 1].
+SsimMeans ssim_means(const std::vector<double>& x, const std::vector<double>& y, int w, int h, unsigned threads) {
+    const int ow = w - kWin + 1;
+    const int oh = h - kWin + 1;
+    if (ow <= 0 || oh <= 0) return SsimMeans{};
+    const auto g = gaussian_window();
+    const size_t ow_s = static_cast<size_t>(ow);
+
+    // Horizontal pass: windowed sums of x, y, x^2, y^2, xy for every row.
+    const size_t hn = ow_s * static_cast<size_t>(h);
+    std::vector<double> mx(hn), my(hn), mxx(hn), myy(hn), mxy(hn);
+    const RowChunks hc = row_chunks(h, threads);
+    parallel_for(hc.chunks, [&](size_t c) {
+        for (int r = hc.begin(c); r < hc.end(c); ++r) {
+            const double* xr = x.data() + static_cast<size_t>(r) * w;
+            const double* yr = y.data() + static_cast<size_t>(r) * w;
+            const size_t o = static_cast<size_t>(r) * ow_s;
+            for (int i = 0; i < ow; ++i) {
+                double sx = 0, sy = 0, sxx = 0, syy = 0, sxy = 0;
+                for (int k = 0; k < kWin; ++k) {
+                    const double a = xr[i + k], b = yr[i + k], gk = g[static_cast<size_t>(k)];
+                    sx += gk * a;
+                    sy += gk * b;
+                    sxx += gk * a * a;
+                    syy += gk * b * b;
+                    sxy += gk * a * b;
+                }
+                mx[o + i] = sx;
+                my[o + i] = sy;
+                mxx[o + i] = sxx;
+                myy[o + i] = syy;
+                mxy[o + i] = sxy;
+            }
+        }
+    }, threads);
+
+    // Vertical pass fused with the SSIM formula; one partial sum per chunk.
+    const double C1 = kK1 * kK1, C2 = kK2 * kK2;
+    const RowChunks vc = row_chunks(oh, threads);
+    std::vector<double> ssim_part(vc.chunks, 0.0), cs_part(vc.chunks, 0.0);
+    parallel_for(vc.chunks, [&](size_t c) {
+        std::vector<double> vx(ow_s), vy(ow_s), vxx(ow_s), vyy(ow_s), vxy(ow_s);
+        double ssim_sum = 0.0, cs_sum = 0.0;
+        for (int r = vc.begin(c); r < vc.end(c); ++r) {
+            std::fill(vx.begin(), vx.end(), 0.0);
+            std::fill(vy.begin(), vy.end(), 0.0);
+            std::fill(vxx.begin(), vxx.end(), 0.0);
+            std::fill(vyy.begin(), vyy.end(), 0.0);
+            std::fill(vxy.begin(), vxy.end(), 0.0);
+            for (int k = 0; k < kWin; ++k) {
+                const double gk = g[static_cast<size_t>(k)];
+                const size_t o = static_cast<size_t>(r + k) * ow_s;
+                for (size_t i = 0; i < ow_s; ++i) {
+                    vx[i] += gk * mx[o + i];
+                    vy[i] += gk * my[o + i];
+                    vxx[i] += gk * mxx[o + i];
+                    vyy[i] += gk * myy[o + i];
+                    vxy[i] += gk * mxy[o + i];
+                }
+            }
+            for (size_t i = 0; i < ow_s; ++i) {
+                const double mu_x2 = vx[i] * vx[i], mu_y2 = vy[i] * vy[i], mu_xy = vx[i] * vy[i];
+                const double sxx = vxx[i] - mu_x2, syy = vyy[i] - mu_y2, sxy = vxy[i] - mu_xy;
+                const double cs = (2.0 * sxy + C2) / (sxx + syy + C2);
+                cs_sum += cs;
+                ssim_sum += cs * (2.0 * mu_xy + C1) / (mu_x2 + mu_y2 + C1);
+            }
+        }
+        ssim_part[c] = ssim_sum;
+        cs_part[c] = cs_sum;
+    }, threads);
+
+    SsimMeans m;
+    double ssim_sum = 0.0, cs_sum = 0.0;
+    for (size_t c = 0; c < vc.chunks; ++c) {
+        ssim_sum += ssim_part[c];
+        cs_sum += cs_part[c];
+    }
+    const double n = static_cast<double>(ow) * static_cast<double>(oh);
+    m.ssim = ssim_sum / n;
+    m.cs = cs_sum / n;
+    return m;
+}
+
+// 2x2 box downsample (odd trailing row/column dropped).
+void downsample2(std::vector<double>& v, int& w, int& h) {
+    const int nw = w / 2, nh = h / 2;
+    std::vector<double> out(static_cast<size_t>(nw) * static_cast<size_t>(nh));
+    for (int r = 0; r < nh; ++r) {
+        const double* a = v.data() + static_cast<size_t>(2 * r) * w;
+        const double* b = a + w;
+        double* o = out.data() + static_cast<size_t>(r) * nw;
+        for (int i = 0; i < nw; ++i) o[i] = 0.25 * (a[2 * i] + a[2 * i + 1] + b[2 * i] + b[2 * i + 1]);
+    }
+    v.swap(out);
+    w = nw;
+    h = nh;
+}
+
+double ms_ssim(std::vector<double> x, std::vector<double> y, int w, int h, unsigned threads) {
+    // Use as many of the 5 scales as keep at least one full window.
+    size_t scales = 0;
+    for (int sw = w, sh = h; scales < kMsWeights.size() && sw >= kWin && sh >= kWin; sw /= 2, sh /= 2) ++scales;
+    if (scales == 0) return 1.0;
+    double wsum = 0.0;
+    for (size_t s = 0; s < scales; ++s) wsum += kMsWeights[s];
+
+    double result = 1.0;
+    for (size_t s = 0; s < scales; ++s) {
+        const SsimMeans m = ssim_means(x, y, w, h, threads);
+        const double term = (s + 1 == scales) ? m.ssim : m.cs;
+        result *= std::pow(std::max(term, 0.0), kMsWeights[s] / wsum);
+        if (s + 1 < scales) {
+            int yw = w, yh = h;
+            downsample2(y, yw, yh);
+            downsample2(x, w, h);
+        }
+    }
+    return result;
+}
+
+} // namespace
+
+ImageMetrics compute_metrics(const Image& ref, const Image& rec, const MetricsOptions& opt) {
+    if (ref.width != rec.width || ref.height != rec.height || ref.channels != rec.channels) {
+        throw std::runtime_error("metrics: image dimensions mismatch");
+    }
+    if (ref.pixels.size() != rec.pixels.size() || ref.pixels.empty()) {
+        throw std::runtime_error("metrics: pixel buffer size mismatch");
+    }
+    if (ref.bits_stored <= 0 || ref.bits_stored > 16) {
+        throw std::runtime_error("metrics: bits_stored out of range");
+    }
+
+    const int w = ref.width * ref.channels;
+    const int h = ref.height;
+    const uint32_t maxv = (1u << ref.bits_stored) - 1u;
+    const int32_t offset = 1 << (ref.bits_stored - 1);
+    const bool want_ssim = opt.ssim || opt.ms_ssim;
+    const double inv_max = 1.0 / static_cast<double>(maxv);
+
+    // Pass 1: map to the unsigned domain; squared error, max error, histogram,
+    // and the [0, 1] planes the SSIM pass filters.
+    std::vector<double> xs, ys;
+    if (want_ssim) {
+        xs.resize(ref.pixels.size());
+        ys.resize(ref.pixels.size());
+    }
+    const RowChunks rc = row_chunks(h, opt.threads);
+    std::vector<uint64_t> sq_part(rc.chunks, 0);
+    std::vector<uint32_t> max_part(rc.chunks, 0);
+    std::vector<std::vector<uint64_t>> hist_part(opt.histogram ? rc.chunks : 0);
+    parallel_for(rc.chunks, [&](size_t c) {
+        uint64_t sq = 0;
+        uint32_t mx = 0;
+        std::vector<uint64_t> hist;
+        if (opt.histogram) hist.assign(static_cast<size_t>(maxv) + 1, 0);
+        const size_t i0 = static_cast<size_t>(rc.begin(c)) * w;
+        const size_t i1 = static_cast<size_t>(rc.end(c)) * w;
+        const int32_t* a = ref.pixels.data();
+        const int32_t* b = rec.pixels.data();
+        for (size_t i = i0; i < i1; ++i) {
+            const uint32_t u = to_unsigned(a[i], ref.is_signed, offset, maxv);
+            const uint32_t v = to_unsigned(b[i], rec.is_signed, offset, maxv);
+            const uint32_t e = u > v ? u - v : v - u;
+            sq += static_cast<uint64_t>(e) * e;
+            mx = std::max(mx, e);
+            if (opt.histogram) ++hist[e];
+            if (want_ssim) {
+                xs[i] = u * inv_max;
+                ys[i] = v * inv_max;
+            }
+        }
+        sq_part[c] = sq;
+        max_part[c] = mx;
+        if (opt.histogram) hist_part[c] = std::move(hist);
+    }, opt.threads);
+
+    ImageMetrics m;
+    uint64_t sq = 0;
+    for (size_t c = 0; c < rc.chunks; ++c) {
+        sq += sq_part[c];
+        m.max_abs_error = std::max(m.max_abs_error, max_part[c]);
+    }
+    // Exact integer sum, so MSE matches a sequential double accumulation bit for bit.
+    m.mse = static_cast<double>(sq) / static_cast<double>(ref.pixels.size());
+    m.rmse = std::sqrt(m.mse);
+    m.psnr = (m.mse == 0.0) ? std::numeric_limits<double>::infinity()
+                            : 20.0 * std::log10(static_cast<double>(maxv)) - 10.0 * std::log10(m.mse);
+    if (opt.histogram) {
+        m.error_histogram.assign(static_cast<size_t>(m.max_abs_error) + 1, 0);
+        for (const auto& hp : hist_part) {
+            for (size_t e = 0; e < m.error_histogram.size(); ++e) m.error_histogram[e] += hp[e];
+        }
+    }
+
+    // Pass 2: SSIM (single scale) and MS-SSIM.
+    if (opt.ssim) m.ssim = ssim_means(xs, ys, w, h, opt.threads).ssim;
+    if (opt.ms_ssim) m.ms_ssim = ms_ssim(std::move(xs), std::move(ys), w, h, opt.threads);
+    return m;
+}
+
+uint32_t error_percentile(const std::vector<uint64_t>& histogram, double p) {
+    uint64_t total = 0;
+    for (uint64_t c : histogram) total += c;
+    if (total == 0) return 0;
+    const double pc = std::min(std::max(p, 0.0), 1.0);
+    const uint64_t rank = static_cast<uint64_t>(std::floor(pc * static_cast<double>(total - 1)));
+    uint64_t seen = 0;
+    for (size_t e = 0; e < histogram.size(); ++e) {
+        seen += histogram[e];
+        if (seen > rank) return static_cast<uint32_t>(e);
+    }
+    return static_cast<uint32_t>(histogram.size() - 1);
+}
+
+Image scaled_error_map(const Image& ref, const Image& rec, uint32_t scale, unsigned threads) {
+    if (ref.width != rec.width || ref.height != rec.height || ref.pixels.size() != rec.pixels.size()) {
+        throw std::runtime_error("error map: image dimensions mismatch");
+    }
+    if (ref.bits_stored <= 0 || ref.bits_stored > 16) {
+        throw std::runtime_error("error map: bits_stored out of range");
+    }
+    if (scale == 0) scale = 1;
+    const uint32_t maxv = (1u << ref.bits_stored) - 1u;
+    const int32_t offset = 1 << (ref.bits_stored - 1);
+
+    // lut[e] for e in [0, scale]; larger errors saturate at lut[scale] = 255.
+    std::vector<uint8_t> lut(static_cast<size_t>(scale) + 1);
+    for (uint32_t e = 0; e <= scale; ++e) {
+        lut[e] = static_cast<uint8_t>(std::lround((255.0 * static_cast<double>(e)) / static_cast<double>(scale)));
+    }
+
+    Image out;
+    out.width = ref.width;
+    out.height = ref.height;
+    out.channels = 1;
+    out.bits_allocated = 8;
+    out.bits_stored = 8;
+    out.is_signed = false;
+    out.type = PixelType::U8;
+    out.pixels.resize(ref.pixels.size());
+
+    const int w = ref.width * ref.channels;
+    const RowChunks rc = row_chunks(ref.height, threads);
+    parallel_for(rc.chunks, [&](size_t c) {
+        const size_t i1 = static_cast<size_t>(rc.end(c)) * w;
+        for (size_t i = static_cast<size_t>(rc.begin(c)) * w; i < i1; ++i) {
+            const uint32_t u = to_unsigned(ref.pixels[i], ref.is_signed, offset, maxv);
+            const uint32_t v = to_unsigned(rec.pixels[i], rec.is_signed, offset, maxv);
+            const uint32_t e = u > v ? u - v : v - u;
+            out.pixels[i] = lut[std::min(e, scale)];
+        }
+    }, threads);
+    return out;
+}
+
+// Debug self-test: identical images score perfectly, a constant offset gives the exact MSE.
+#ifndef NDEBUG
+namespace {
+struct MetricsSelfTest {
+    MetricsSelfTest() {
+        Image a;
+        a.width = 32;
+        a.height = 32;
+        a.bits_stored = 12;
+        a.bits_allocated = 16;
+        a.pixels.resize(32 * 32);
+        for (size_t i = 0; i < a.pixels.size(); ++i) a.pixels[i] = static_cast<int32_t>((i * 37) % 4096);
+
+        ImageMetrics same = compute_metrics(a, a);
+        if (same.mse != 0.0 || same.max_abs_error != 0 || std::fabs(same.ssim - 1.0) > 1e-9 ||
+            std::fabs(same.ms_ssim - 1.0) > 1e-9) {
+            throw std::runtime_error("metrics self-test: identical images");
+        }
+
+        Image b = a;
+        for (auto& p : b.pixels) p = std::min(p + 3, 4095);
+        uint64_t sq = 0;
+        for (size_t i = 0; i < a.pixels.size(); ++i) {
+            const int64_t d = b.pixels[i] - a.pixels[i];
+            sq += static_cast<uint64_t>(d * d);
+        }
+        ImageMetrics off = compute_metrics(a, b, MetricsOptions{true, false, false, 2});
+        if (off.mse != static_cast<double>(sq) / a.pixels.size() || off.max_abs_error != 3 ||
+            error_percentile(off.error_histogram, 1.0) != 3) {
+            throw std::runtime_error("metrics self-test: offset image");
+        }
+    }
+};
+static MetricsSelfTest _metrics_self_test{};
+} // namespace
+#endif
+
+} // namespace mcodec
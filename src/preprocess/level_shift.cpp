@@ -40,7 +40,7 @@ void apply_level_shift(Image& img) {
         return;
     }
 
-    const int32_t offset = 1 << (img.bits_stored - 1);
+    const int32_t offset = level_shift_offset(img.bits_stored, img.is_signed);
 
     for (auto& v : img.pixels) {
         v -= offset;
@@ -50,6 +50,13 @@ void apply_level_shift(Image& img) {
     img.is_signed = true;
 }
 
+int32_t level_shift_offset(int bits_stored, bool is_signed) {
+    if (bits_stored <= 0 || bits_stored > 16) {
+        throw std::runtime_error("level_shift_offset: invalid bits_stored");
+    }
+    return is_signed ? 0 : (1 << (bits_stored - 1));
+}
+
 // ------------------------------------------------------------
 // Decode-side: inverse level shift
 // ------------------------------------------------------------
@@ -0,0 +1,57 @@
+#include "preprocess/window_level.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace mcodec {
+
+void make_window_lut(int bits_stored, bool is_signed, const DisplayWindow& window, std::vector<uint8_t>& lut) {
+    if (bits_stored <= 0 || bits_stored > 16) {
+        throw std::runtime_error("make_window_lut: invalid bits_stored");
+    }
+    if (!(window.width >= 1.0) || !std::isfinite(window.center)) {
+        throw std::runtime_error("make_window_lut: window width must be >= 1");
+    }
+    const int32_t entries = int32_t{1} << bits_stored;
+    const int32_t base = is_signed ? entries / 2 : 0;
+    const double c = window.center - 0.5;
+    const double half = (window.width - 1.0) / 2.0;
+    lut.resize(static_cast<size_t>(entries));
+    for (int32_t i = 0; i < entries; ++i) {
+        const double x = static_cast<double>(i - base);
+        double y;
+        if (x <= c - half) y = 0.0;
+        else if (x > c + half) y = 255.0;
+        else y = ((x - c) / (window.width - 1.0) + 0.5) * 255.0;
+        lut[static_cast<size_t>(i)] = static_cast<uint8_t>(std::lround(std::min(std::max(y, 0.0), 255.0)));
+    }
+}
+
+void apply_window(const Image& im, const std::vector<uint8_t>& lut, DisplayImage& out) {
+    if (im.channels != 1) throw std::runtime_error("apply_window: only grayscale is supported");
+    if (static_cast<int>(im.pixels.size()) != im.width * im.height) {
+        throw std::runtime_error("apply_window: pixel buffer size mismatch");
+    }
+    if (im.bits_stored <= 0 || im.bits_stored > 16 || lut.size() != (size_t{1} << im.bits_stored)) {
+        throw std::runtime_error("apply_window: LUT does not match bits_stored");
+    }
+    const int32_t maxv = static_cast<int32_t>(lut.size()) - 1;
+    const int32_t base = im.is_signed ? static_cast<int32_t>(lut.size() / 2) : 0;
+    out.width = im.width;
+    out.height = im.height;
+    out.pixels.resize(im.pixels.size());
+    for (size_t i = 0; i < im.pixels.size(); ++i) {
+        out.pixels[i] = lut[static_cast<size_t>(std::min(std::max(im.pixels[i] + base, 0), maxv))];
+    }
+}
+
+DisplayImage apply_window(const Image& im, const DisplayWindow& window) {
+    std::vector<uint8_t> lut;
+    make_window_lut(im.bits_stored, im.is_signed, window, lut);
+    DisplayImage out;
+    apply_window(im, lut, out);
+    return out;
+}
+
+} // namespace mcodec
@@ -60,6 +60,19 @@ void dequantize(const std::vector<int16_t>& qcoeff_in,
     }
 }
 
+void requantize(std::vector<int16_t>& qcoeff, int from_quality, int to_quality) {
+    const float from_step = static_cast<float>(quant_step_from_quality(from_quality));
+    const float inv_step = 1.0f / static_cast<float>(quant_step_from_quality(to_quality));
+    for (int16_t& v : qcoeff) {
+        if (v == 0) continue; // zero stays zero, and most coefficients are zero
+        // the float expressions of dequantize and quantize, so both paths agree bit for bit
+        const float c = static_cast<float>(v) * from_step;
+        int q = static_cast<int>(std::round(c * inv_step));
+        q = std::min<int>(std::max<int>(q, std::numeric_limits<int16_t>::min()), std::numeric_limits<int16_t>::max());
+        v = static_cast<int16_t>(q);
+    }
+}
+
 #ifndef NDEBUG
 namespace {
 // Simple self-test: quant/dequant round-trip for a small block.
@@ -89,6 +102,14 @@ struct QuantSelfTest {
                 throw std::runtime_error("quant self-test: dequant mismatch");
             }
         }
+
+        // requantize == dequantize + quantize
+        std::vector<int16_t> via_float;
+        quantize(recon, N, 20, via_float);
+        requantize(q, quality, 20);
+        if (q != via_float) {
+            throw std::runtime_error("quant self-test: requantize mismatch");
+        }
     }
 };
 static QuantSelfTest _quant_self_test{};
@@ -0,0 +1,727 @@
+#include "service/codec_service.hpp"
+
+#include "codec/decoder.hpp"
+#include "codec/encoder.hpp"
+#include "codec/transcode.hpp"
+#include "entropy/bitstream.hpp"
+#include "util/trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define MCODEC_HAS_UNIX_SOCKETS 1
+#endif
+
+namespace mcodec {
+
+namespace {
+
+// Latency histogram with power-of-two microsecond buckets: bucket b counts requests
+// that took less than 2^b us (and at least 2^(b-1) us); the last bucket is open-ended.
+constexpr size_t kLatencyBuckets = 24;
+constexpr size_t kOpCount = 4;
+
+struct LatencyHistogram {
+    std::atomic<uint64_t> bucket[kLatencyBuckets] = {};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum_ns{0};
+    std::atomic<uint64_t> max_ns{0};
+
+    void add(uint64_t ns) {
+        const uint64_t us = ns / 1000u;
+        size_t b = 0;
+        while (b + 1 < kLatencyBuckets && (uint64_t{1} << b) <= us) ++b;
+        bucket[b].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        sum_ns.fetch_add(ns, std::memory_order_relaxed);
+        uint64_t m = max_ns.load(std::memory_order_relaxed);
+        while (ns > m && !max_ns.compare_exchange_weak(m, ns, std::memory_order_relaxed)) {}
+    }
+
+    // Upper bound of the bucket holding quantile p (0..1), microseconds.
+    double quantile_us(double p) const {
+        const uint64_t n = count.load(std::memory_order_relaxed);
+        if (n == 0) return 0.0;
+        const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(p * static_cast<double>(n) + 0.5));
+        uint64_t seen = 0;
+        for (size_t b = 0; b < kLatencyBuckets; ++b) {
+            seen += bucket[b].load(std::memory_order_relaxed);
+            if (seen >= rank) return static_cast<double>(uint64_t{1} << b);
+        }
+        return static_cast<double>(max_ns.load(std::memory_order_relaxed)) / 1000.0;
+    }
+};
+
+LatencyHistogram g_latency[kOpCount];
+const char* const kOpNames[kOpCount] = {"encode", "decode", "transcode", "stats"};
+
+std::string stats_json() {
+    std::ostringstream os;
+    os << "{";
+    for (size_t op = 0; op < kOpCount; ++op) {
+        const LatencyHistogram& h = g_latency[op];
+        const uint64_t n = h.count.load(std::memory_order_relaxed);
+        char buf[256];
+        std::snprintf(buf, sizeof(buf),
+                      "\"%s\":{\"count\":%llu,\"mean_us\":%.1f,\"p50_us\":%.0f,\"p90_us\":%.0f,\"p99_us\":%.0f,\"max_us\":%.1f,\"buckets_us\":{",
+                      kOpNames[op], static_cast<unsigned long long>(n),
+                      n ? static_cast<double>(h.sum_ns.load(std::memory_order_relaxed)) / 1000.0 / static_cast<double>(n) : 0.0,
+                      h.quantile_us(0.50), h.quantile_us(0.90), h.quantile_us(0.99),
+                      static_cast<double>(h.max_ns.load(std::memory_order_relaxed)) / 1000.0);
+        os << (op ? "," : "") << buf;
+        bool first = true;
+        for (size_t b = 0; b < kLatencyBuckets; ++b) {
+            const uint64_t c = h.bucket[b].load(std::memory_order_relaxed);
+            if (c == 0) continue;
+            os << (first ? "" : ",") << "\"<" << (uint64_t{1} << b) << "\":" << c;
+            first = false;
+        }
+        os << "}}";
+    }
+    os << "}";
+    return os.str();
+}
+
+// Wire headers. Request: magic "MCRQ", op, mode, quality, then the sample layout of
+// an encode payload (or of a decode result in the reply) and the payload size.
+// Reply: magic "MCRS", status, mode, the same layout fields, size, server time.
+constexpr size_t kRequestHeaderBytes = 32;
+constexpr size_t kReplyHeaderBytes = 40;
+constexpr uint8_t kModeInline = 0;
+constexpr uint8_t kModeFd = 1;
+constexpr uint8_t kStatusOk = 0;
+constexpr uint8_t kStatusError = 1;
+constexpr uint64_t kMaxInlineBytes = uint64_t{1} << 30;
+
+struct WireHeader {
+    uint8_t op_or_status = 0;
+    uint8_t mode = kModeInline;
+    uint16_t quality = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint16_t bits_stored = 0;
+    uint16_t bits_allocated = 0;
+    uint8_t is_signed = 0;
+    uint8_t type = 0;
+    uint64_t bytes = 0;
+    uint64_t server_ns = 0; // reply only
+};
+
+void write_u64_le(ByteWriter& w, uint64_t v) {
+    w.write_u32_le(static_cast<uint32_t>(v & 0xFFFFFFFFu));
+    w.write_u32_le(static_cast<uint32_t>(v >> 32));
+}
+
+uint64_t read_u64_le(ByteReader& r) {
+    const uint64_t lo = r.read_u32_le();
+    const uint64_t hi = r.read_u32_le();
+    return lo | (hi << 32);
+}
+
+std::vector<uint8_t> pack_header(const char* magic, const WireHeader& h, bool reply) {
+    ByteWriter w;
+    w.write_bytes(magic, 4);
+    w.write_u8(h.op_or_status);
+    w.write_u8(h.mode);
+    w.write_u16_le(h.quality);
+    w.write_u32_le(h.width);
+    w.write_u32_le(h.height);
+    w.write_u16_le(h.bits_stored);
+    w.write_u16_le(h.bits_allocated);
+    w.write_u8(h.is_signed);
+    w.write_u8(h.type);
+    w.write_u16_le(0);
+    write_u64_le(w, h.bytes);
+    if (reply) write_u64_le(w, h.server_ns);
+    return w.release();
+}
+
+WireHeader unpack_header(const uint8_t* p, const char* magic, bool reply) {
+    if (std::memcmp(p, magic, 4) != 0) throw std::runtime_error("codec service: bad message magic");
+    ByteReader r(p + 4, (reply ? kReplyHeaderBytes : kRequestHeaderBytes) - 4);
+    WireHeader h;
+    h.op_or_status = r.read_u8();
+    h.mode = r.read_u8();
+    h.quality = r.read_u16_le();
+    h.width = r.read_u32_le();
+    h.height = r.read_u32_le();
+    h.bits_stored = r.read_u16_le();
+    h.bits_allocated = r.read_u16_le();
+    h.is_signed = r.read_u8();
+    h.type = r.read_u8();
+    r.read_u16_le();
+    h.bytes = read_u64_le(r);
+    if (reply) h.server_ns = read_u64_le(r);
+    return h;
+}
+
+// Decoded samples packed for the wire: 1 byte for U8, 2 bytes little-endian otherwise.
+void pack_samples(const Image& im, std::vector<uint8_t>& out) {
+    const size_t n = im.pixels.size();
+    if (im.type == PixelType::U8) {
+        out.resize(n);
+        for (size_t i = 0; i < n; ++i) out[i] = static_cast<uint8_t>(im.pixels[i]);
+        return;
+    }
+    out.resize(n * 2);
+    for (size_t i = 0; i < n; ++i) {
+        const uint16_t v = static_cast<uint16_t>(im.pixels[i]);
+        out[2 * i] = static_cast<uint8_t>(v & 0xFF);
+        out[2 * i + 1] = static_cast<uint8_t>(v >> 8);
+    }
+}
+
+void unpack_samples(const uint8_t* p, size_t n, Image& im) {
+    const size_t count = static_cast<size_t>(im.width) * static_cast<size_t>(im.height);
+    const size_t sample = (im.type == PixelType::U8) ? 1 : 2;
+    if (n != count * sample) throw std::runtime_error("codec service: decoded size does not match the image");
+    im.pixels.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        if (sample == 1) {
+            im.pixels[i] = p[i];
+        } else {
+            const uint16_t v = static_cast<uint16_t>(p[2 * i] | (p[2 * i + 1] << 8));
+            im.pixels[i] = (im.type == PixelType::S16) ? static_cast<int16_t>(v) : v;
+        }
+    }
+}
+
+} // namespace
+
+#if defined(MCODEC_HAS_UNIX_SOCKETS)
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // macOS: the daemon ignores SIGPIPE instead
+#endif
+
+namespace {
+
+[[noreturn]] void throw_errno(const char* what) {
+    throw std::runtime_error(std::string("codec service: ") + what + ": " + std::strerror(errno));
+}
+
+class FdGuard {
+public:
+    explicit FdGuard(int fd = -1) : fd_(fd) {}
+    ~FdGuard() { if (fd_ >= 0) ::close(fd_); }
+    FdGuard(const FdGuard&) = delete;
+    FdGuard& operator=(const FdGuard&) = delete;
+    int get() const { return fd_; }
+private:
+    int fd_;
+};
+
+void send_all(int sock, const uint8_t* p, size_t n) {
+    while (n > 0) {
+        const ssize_t k = ::send(sock, p, n, MSG_NOSIGNAL);
+        if (k < 0) {
+            if (errno == EINTR) continue;
+            throw_errno("send");
+        }
+        p += k;
+        n -= static_cast<size_t>(k);
+    }
+}
+
+// false on a clean EOF before the first byte
+bool recv_all(int sock, uint8_t* p, size_t n) {
+    size_t got = 0;
+    while (got < n) {
+        const ssize_t k = ::recv(sock, p + got, n - got, 0);
+        if (k < 0) {
+            if (errno == EINTR) continue;
+            throw_errno("recv");
+        }
+        if (k == 0) {
+            if (got == 0) return false;
+            throw std::runtime_error("codec service: connection closed mid-message");
+        }
+        got += static_cast<size_t>(k);
+    }
+    return true;
+}
+
+// Header (with `pass_fd` attached when >= 0), then the inline body.
+void send_message(int sock, const std::vector<uint8_t>& header, int pass_fd, const uint8_t* body, size_t body_n) {
+    size_t sent = 0;
+    if (pass_fd >= 0) {
+        iovec iov{const_cast<uint8_t*>(header.data()), header.size()};
+        alignas(cmsghdr) char ctrl[CMSG_SPACE(sizeof(int))] = {};
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = ctrl;
+        msg.msg_controllen = sizeof(ctrl);
+        cmsghdr* c = CMSG_FIRSTHDR(&msg);
+        c->cmsg_level = SOL_SOCKET;
+        c->cmsg_type = SCM_RIGHTS;
+        c->cmsg_len = CMSG_LEN(sizeof(int));
+        std::memcpy(CMSG_DATA(c), &pass_fd, sizeof(int));
+        ssize_t k;
+        do {
+            k = ::sendmsg(sock, &msg, MSG_NOSIGNAL);
+        } while (k < 0 && errno == EINTR);
+        if (k < 0) throw_errno("sendmsg");
+        sent = static_cast<size_t>(k);
+    }
+    send_all(sock, header.data() + sent, header.size() - sent);
+    send_all(sock, body, body_n);
+}
+
+// Fixed-size header plus a passed fd if one came with it; false on clean EOF.
+bool recv_header(int sock, uint8_t* p, size_t n, int& passed_fd) {
+    passed_fd = -1;
+    iovec iov{p, n};
+    alignas(cmsghdr) char ctrl[CMSG_SPACE(sizeof(int))] = {};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl;
+    msg.msg_controllen = sizeof(ctrl);
+    ssize_t k;
+    do {
+        k = ::recvmsg(sock, &msg, 0);
+    } while (k < 0 && errno == EINTR);
+    if (k < 0) throw_errno("recvmsg");
+    if (k == 0) return false;
+    for (cmsghdr* c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS) {
+            std::memcpy(&passed_fd, CMSG_DATA(c), sizeof(int));
+        }
+    }
+    if (msg.msg_flags & MSG_CTRUNC) throw std::runtime_error("codec service: control message truncated");
+    if (static_cast<size_t>(k) < n && !recv_all(sock, p + k, n - static_cast<size_t>(k))) {
+        throw std::runtime_error("codec service: connection closed mid-header");
+    }
+    return true;
+}
+
+#if defined(__linux__)
+// Seals that make a passed memfd safe to map: no shrinking (SIGBUS on access past the
+// end), no growing, and no writes while the peer reads it.
+constexpr int kPayloadSeals = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE;
+#endif
+
+// Anonymous shared-memory file holding a copy of `data`, sealed where the platform can.
+int make_shared_buffer(const uint8_t* data, size_t n) {
+#if defined(__linux__)
+    const int fd = ::memfd_create("mcodec", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) throw_errno("memfd_create");
+#else
+    static std::atomic<unsigned> seq{0};
+    char name[64];
+    std::snprintf(name, sizeof(name), "/mcodec-%d-%u", static_cast<int>(::getpid()), seq.fetch_add(1));
+    const int fd = ::shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) throw_errno("shm_open");
+    ::shm_unlink(name);
+#endif
+    FdGuard guard(fd);
+    if (::ftruncate(fd, static_cast<off_t>(n)) != 0) throw_errno("ftruncate");
+    if (n > 0) {
+        void* p = ::mmap(nullptr, n, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) throw_errno("mmap");
+        std::memcpy(p, data, n);
+        ::munmap(p, n);
+    }
+#if defined(__linux__)
+    if (::fcntl(fd, F_ADD_SEALS, kPayloadSeals | F_SEAL_SEAL) != 0) throw_errno("fcntl(F_ADD_SEALS)");
+#endif
+    return ::dup(fd);
+}
+
+// Read-only view of the first `n` bytes of a passed fd. Only a memfd sealed against
+// resizing and writes is mapped: the sender could otherwise truncate it (SIGBUS here)
+// or change it while it is being decoded. Anything else is copied out with pread.
+class FdPayload {
+public:
+    FdPayload(int fd, size_t n) : n_(n) {
+        struct stat st{};
+        if (::fstat(fd, &st) != 0) throw_errno("fstat");
+        if (static_cast<uint64_t>(st.st_size) < n) throw std::runtime_error("codec service: shared buffer smaller than declared");
+        if (n == 0) return;
+#if defined(__linux__)
+        const int seals = ::fcntl(fd, F_GET_SEALS);
+        if (seals >= 0 && (seals & kPayloadSeals) == kPayloadSeals) {
+            p_ = ::mmap(nullptr, n, PROT_READ, MAP_SHARED, fd, 0);
+            if (p_ == MAP_FAILED) throw_errno("mmap");
+            return;
+        }
+#endif
+        copy_.resize(n);
+        for (size_t got = 0; got < n;) {
+            const ssize_t k = ::pread(fd, copy_.data() + got, n - got, static_cast<off_t>(got));
+            if (k < 0 && errno == EINTR) continue;
+            if (k < 0) throw_errno("pread");
+            if (k == 0) throw std::runtime_error("codec service: shared buffer smaller than declared");
+            got += static_cast<size_t>(k);
+        }
+    }
+    ~FdPayload() { if (p_ && p_ != MAP_FAILED) ::munmap(p_, n_); }
+    FdPayload(const FdPayload&) = delete;
+    FdPayload& operator=(const FdPayload&) = delete;
+    const uint8_t* data() const { return p_ ? static_cast<const uint8_t*>(p_) : copy_.data(); }
+private:
+    void* p_ = nullptr;
+    size_t n_;
+    std::vector<uint8_t> copy_;
+};
+
+// Warm per-request state: sessions and buffers keep their capacity between requests.
+struct Worker {
+    EncoderSession enc;
+    DecoderSession dec;
+    TranscodeSession tc;
+    std::vector<uint8_t> in;
+    std::vector<uint8_t> out;
+    Image im;
+};
+
+class WorkerPool {
+public:
+    std::unique_ptr<Worker> acquire() {
+        std::lock_guard<std::mutex> lock(m_);
+        if (free_.empty()) return std::make_unique<Worker>();
+        std::unique_ptr<Worker> w = std::move(free_.back());
+        free_.pop_back();
+        return w;
+    }
+    void release(std::unique_ptr<Worker> w) {
+        std::lock_guard<std::mutex> lock(m_);
+        free_.push_back(std::move(w));
+    }
+private:
+    std::mutex m_;
+    std::vector<std::unique_ptr<Worker>> free_;
+};
+
+std::atomic<bool> g_stop{false};
+
+struct ServiceState {
+    WorkerPool pool;
+    std::mutex m;
+    std::condition_variable idle;
+    std::set<int> connections;
+};
+
+// Runs one request on a warm worker; the result is left in w.out and `reply`.
+void handle_request(const WireHeader& rq, const uint8_t* in, size_t in_n, Worker& w, WireHeader& reply) {
+    switch (static_cast<ServiceOp>(rq.op_or_status)) {
+        case ServiceOp::Encode: {
+            PixelView v;
+            v.data = in;
+            v.type = static_cast<PixelType>(rq.type);
+            v.width = static_cast<int>(rq.width);
+            v.height = static_cast<int>(rq.height);
+            v.bits_stored = rq.bits_stored;
+            v.bits_allocated = rq.bits_allocated;
+            v.is_signed = rq.is_signed != 0;
+            if (v.type != PixelType::U8 && v.type != PixelType::U16 && v.type != PixelType::S16) {
+                throw std::runtime_error("encode: unknown pixel type");
+            }
+            if (rq.quality < 1 || rq.quality > 100) throw std::runtime_error("encode: quality out of range 1..100");
+            const size_t sample = (v.type == PixelType::U8) ? 1 : 2;
+            if (in_n != static_cast<size_t>(rq.width) * rq.height * sample) {
+                throw std::runtime_error("encode: payload size does not match width x height");
+            }
+            w.enc.encode(v, rq.quality, w.out);
+            return;
+        }
+        case ServiceOp::Decode:
+            w.in.assign(in, in + in_n); // the decoder reads from a vector
+            w.dec.decode(w.in, w.im);
+            pack_samples(w.im, w.out);
+            reply.width = static_cast<uint32_t>(w.im.width);
+            reply.height = static_cast<uint32_t>(w.im.height);
+            reply.bits_stored = static_cast<uint16_t>(w.im.bits_stored);
+            reply.bits_allocated = static_cast<uint16_t>(w.im.bits_allocated);
+            reply.is_signed = w.im.is_signed ? 1 : 0;
+            reply.type = static_cast<uint8_t>(w.im.type);
+            return;
+        case ServiceOp::Transcode:
+            if (rq.quality < 1 || rq.quality > 100) throw std::runtime_error("transcode: quality out of range 1..100");
+            w.in.assign(in, in + in_n);
+            w.tc.transcode(w.in, rq.quality, w.out);
+            return;
+        case ServiceOp::Stats: {
+            const std::string json = stats_json();
+            w.out.assign(json.begin(), json.end());
+            return;
+        }
+    }
+    throw std::runtime_error("codec service: unknown op");
+}
+
+void serve_connection(int conn, ServiceState& st) {
+    std::vector<uint8_t> inline_in;
+    try {
+        for (;;) {
+            uint8_t raw[kRequestHeaderBytes];
+            int passed = -1;
+            if (!recv_header(conn, raw, sizeof(raw), passed)) break;
+            const auto t0 = std::chrono::steady_clock::now();
+            FdGuard passed_guard(passed);
+            const WireHeader rq = unpack_header(raw, "MCRQ", false);
+            const bool via_fd = (rq.mode == kModeFd);
+            if (via_fd && passed < 0) throw std::runtime_error("codec service: fd mode without a passed fd");
+            if (!via_fd) {
+                if (rq.bytes > kMaxInlineBytes) throw std::runtime_error("codec service: inline payload too large");
+                inline_in.resize(static_cast<size_t>(rq.bytes));
+                if (!recv_all(conn, inline_in.data(), inline_in.size()) && !inline_in.empty()) break;
+            }
+
+            WireHeader reply;
+            std::string error;
+            std::unique_ptr<Worker> w = st.pool.acquire();
+            try {
+                MCODEC_TRACE_SCOPE("service.request");
+                std::unique_ptr<FdPayload> mapped;
+                const uint8_t* in = inline_in.data();
+                if (via_fd) {
+                    mapped = std::make_unique<FdPayload>(passed, static_cast<size_t>(rq.bytes));
+                    in = mapped->data();
+                }
+                handle_request(rq, in, static_cast<size_t>(rq.bytes), *w, reply);
+            } catch (const std::exception& e) {
+                error = e.what();
+            }
+
+            const uint8_t* body = reinterpret_cast<const uint8_t*>(error.data());
+            size_t body_n = error.size();
+            reply.op_or_status = error.empty() ? kStatusOk : kStatusError;
+            reply.mode = kModeInline;
+            std::unique_ptr<FdGuard> out_fd;
+            if (error.empty()) {
+                body = w->out.data();
+                body_n = w->out.size();
+                if (via_fd) {
+                    out_fd = std::make_unique<FdGuard>(make_shared_buffer(body, body_n));
+                    reply.mode = kModeFd;
+                }
+            }
+            reply.bytes = body_n;
+            reply.server_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - t0).count());
+            if (out_fd) {
+                send_message(conn, pack_header("MCRS", reply, true), out_fd->get(), nullptr, 0);
+            } else {
+                send_message(conn, pack_header("MCRS", reply, true), -1, body, body_n);
+            }
+            st.pool.release(std::move(w));
+
+            const size_t op = static_cast<size_t>(rq.op_or_status) - 1;
+            if (op < kOpCount) {
+                g_latency[op].add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - t0).count()));
+            }
+        }
+    } catch (const std::exception& e) {
+        if (!g_stop.load()) std::fprintf(stderr, "[WARN] mcodecd: dropping connection: %s\n", e.what());
+    }
+    ::close(conn);
+    std::lock_guard<std::mutex> lock(st.m);
+    st.connections.erase(conn);
+    st.idle.notify_all();
+}
+
+// Client side of one request/reply exchange; the result body lands in `out`.
+WireHeader client_call(int sock, WireHeader rq, const uint8_t* data, size_t n, std::vector<uint8_t>& out) {
+    rq.bytes = n;
+    if (n >= ServiceClient::kFdPassBytes) {
+        rq.mode = kModeFd;
+        FdGuard fd(make_shared_buffer(data, n));
+        send_message(sock, pack_header("MCRQ", rq, false), fd.get(), nullptr, 0);
+    } else {
+        rq.mode = kModeInline;
+        send_message(sock, pack_header("MCRQ", rq, false), -1, data, n);
+    }
+
+    uint8_t raw[kReplyHeaderBytes];
+    int passed = -1;
+    if (!recv_header(sock, raw, sizeof(raw), passed)) throw std::runtime_error("codec service: server closed the connection");
+    FdGuard passed_guard(passed);
+    const WireHeader reply = unpack_header(raw, "MCRS", true);
+    if (reply.mode == kModeFd) {
+        if (passed < 0) throw std::runtime_error("codec service: reply without its fd");
+        FdPayload mapped(passed, static_cast<size_t>(reply.bytes));
+        out.assign(mapped.data(), mapped.data() + reply.bytes);
+    } else {
+        out.resize(static_cast<size_t>(reply.bytes));
+        if (!recv_all(sock, out.data(), out.size()) && !out.empty()) {
+            throw std::runtime_error("codec service: server closed the connection");
+        }
+    }
+    if (reply.op_or_status != kStatusOk) {
+        throw std::runtime_error("codec service: " + std::string(out.begin(), out.end()));
+    }
+    return reply;
+}
+
+} // namespace
+
+void run_codec_service(const ServiceOptions& opt) {
+    sockaddr_un addr{};
+    if (opt.socket_path.empty() || opt.socket_path.size() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error("codec service: socket path empty or too long");
+    }
+    struct stat st_path{};
+    if (::lstat(opt.socket_path.c_str(), &st_path) == 0) {
+        if (!S_ISSOCK(st_path.st_mode)) throw std::runtime_error("codec service: " + opt.socket_path + " exists and is not a socket");
+        ::unlink(opt.socket_path.c_str());
+    }
+
+    FdGuard listener(::socket(AF_UNIX, SOCK_STREAM, 0));
+    if (listener.get() < 0) throw_errno("socket");
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, opt.socket_path.c_str(), opt.socket_path.size() + 1);
+    if (::bind(listener.get(), reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) throw_errno("bind");
+    const unsigned max_conn = std::max(1u, opt.max_connections);
+    if (::listen(listener.get(), static_cast<int>(max_conn)) != 0) throw_errno("listen");
+
+    ServiceState st;
+    g_stop.store(false);
+    while (!g_stop.load()) {
+        {
+            // at the connection limit, leave new clients in the backlog
+            std::unique_lock<std::mutex> lock(st.m);
+            if (st.connections.size() >= max_conn) {
+                st.idle.wait_for(lock, std::chrono::milliseconds(100));
+                continue;
+            }
+        }
+        pollfd pfd{listener.get(), POLLIN, 0};
+        const int ready = ::poll(&pfd, 1, 100); // wake up regularly to see stop requests
+        if (ready <= 0) continue;
+        const int conn = ::accept(listener.get(), nullptr, nullptr);
+        if (conn < 0) continue;
+        std::lock_guard<std::mutex> lock(st.m);
+        st.connections.insert(conn);
+        std::thread(serve_connection, conn, std::ref(st)).detach();
+    }
+
+    // Wake connection threads blocked in recv and wait for them to finish
+    std::unique_lock<std::mutex> lock(st.m);
+    for (int conn : st.connections) ::shutdown(conn, SHUT_RDWR);
+    st.idle.wait(lock, [&] { return st.connections.empty(); });
+    ::unlink(opt.socket_path.c_str());
+}
+
+void stop_codec_service() {
+    g_stop.store(true);
+}
+
+ServiceClient::ServiceClient(const std::string& socket_path) {
+    sockaddr_un addr{};
+    if (socket_path.empty() || socket_path.size() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error("codec service: socket path empty or too long");
+    }
+    fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd_ < 0) throw_errno("socket");
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, socket_path.c_str(), socket_path.size() + 1);
+    if (::connect(fd_, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) {
+        const int err = errno;
+        ::close(fd_);
+        fd_ = -1;
+        errno = err;
+        throw_errno(("connect " + socket_path).c_str());
+    }
+}
+
+ServiceClient::~ServiceClient() {
+    if (fd_ >= 0) ::close(fd_);
+}
+
+std::vector<uint8_t> ServiceClient::encode(const PixelView& src, int quality) {
+    if (!src.data) throw std::runtime_error("encode: null pixel buffer");
+    WireHeader rq;
+    rq.op_or_status = static_cast<uint8_t>(ServiceOp::Encode);
+    rq.quality = static_cast<uint16_t>(quality);
+    rq.width = static_cast<uint32_t>(src.width);
+    rq.height = static_cast<uint32_t>(src.height);
+    rq.bits_stored = static_cast<uint16_t>(src.bits_stored);
+    rq.bits_allocated = static_cast<uint16_t>(src.bits_allocated);
+    rq.is_signed = src.is_signed ? 1 : 0;
+    rq.type = static_cast<uint8_t>(src.type);
+    const size_t n = static_cast<size_t>(src.width) * static_cast<size_t>(src.height) * (src.type == PixelType::U8 ? 1 : 2);
+    std::vector<uint8_t> out;
+    last_server_us_ = static_cast<double>(client_call(fd_, rq, static_cast<const uint8_t*>(src.data), n, out).server_ns) / 1000.0;
+    return out;
+}
+
+Image ServiceClient::decode(const std::vector<uint8_t>& bytes) {
+    WireHeader rq;
+    rq.op_or_status = static_cast<uint8_t>(ServiceOp::Decode);
+    std::vector<uint8_t> packed;
+    const WireHeader reply = client_call(fd_, rq, bytes.data(), bytes.size(), packed);
+    last_server_us_ = static_cast<double>(reply.server_ns) / 1000.0;
+    Image im;
+    im.width = static_cast<int>(reply.width);
+    im.height = static_cast<int>(reply.height);
+    im.bits_stored = reply.bits_stored;
+    im.bits_allocated = reply.bits_allocated;
+    im.is_signed = reply.is_signed != 0;
+    im.type = static_cast<PixelType>(reply.type);
+    unpack_samples(packed.data(), packed.size(), im);
+    return im;
+}
+
+std::vector<uint8_t> ServiceClient::transcode(const std::vector<uint8_t>& bytes, int quality) {
+    WireHeader rq;
+    rq.op_or_status = static_cast<uint8_t>(ServiceOp::Transcode);
+    rq.quality = static_cast<uint16_t>(quality);
+    std::vector<uint8_t> out;
+    last_server_us_ = static_cast<double>(client_call(fd_, rq, bytes.data(), bytes.size(), out).server_ns) / 1000.0;
+    return out;
+}
+
+std::string ServiceClient::stats_json() {
+    WireHeader rq;
+    rq.op_or_status = static_cast<uint8_t>(ServiceOp::Stats);
+    std::vector<uint8_t> out;
+    last_server_us_ = static_cast<double>(client_call(fd_, rq, nullptr, 0, out).server_ns) / 1000.0;
+    return std::string(out.begin(), out.end());
+}
+
+#else // !MCODEC_HAS_UNIX_SOCKETS
+
+namespace {
+[[noreturn]] void unsupported() {
+    throw std::runtime_error("codec service: UNIX domain sockets are not available on this platform");
+}
+} // namespace
+
+void run_codec_service(const ServiceOptions&) { unsupported(); }
+void stop_codec_service() {}
+ServiceClient::ServiceClient(const std::string&) { unsupported(); }
+ServiceClient::~ServiceClient() = default;
+std::vector<uint8_t> ServiceClient::encode(const PixelView&, int) { unsupported(); }
+Image ServiceClient::decode(const std::vector<uint8_t>&) { unsupported(); }
+std::vector<uint8_t> ServiceClient::transcode(const std::vector<uint8_t>&, int) { unsupported(); }
+std::string ServiceClient::stats_json() { unsupported(); }
+
+#endif
+
+std::string codec_service_stats_json() {
+    return stats_json();
+}
+
+} // namespace mcodec
@@ -0,0 +1,56 @@
+#include "cli/cli_output.hpp"
+#include "cli/cli_parser.hpp"
+#include "codec/transcode.hpp"
+#include "entropy/bitstream.hpp"
+#include "io/stream_io.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv) {
+    const char* usage = "Usage: transcode --in <input.mcodec|-> --out <output.mcodec|-> --quality <1..100>\n";
+    try {
+        mcodec::CliParser cli;
+        cli.parse(argc, argv);
+        const std::string in = cli.get("in");
+        const std::string out = cli.get("out");
+        mcodec::set_status_to_stderr(mcodec::is_stdio_path(out));
+        const std::string quality_str = cli.get("quality");
+        if (in.empty() || out.empty() || quality_str.empty()) {
+            std::cout << usage;
+            return 1;
+        }
+        int quality = 0;
+        try {
+            quality = std::stoi(quality_str);
+        } catch (...) {
+            std::cout << usage;
+            return 1;
+        }
+        if (quality < 1 || quality > 100) {
+            std::cout << usage;
+            return 1;
+        }
+
+        const auto bytes = mcodec::read_input(in);
+        const int src_quality = mcodec::read_bitstream_header(bytes).quality;
+        if (quality > src_quality) {
+            std::cerr << "[WARN] quality " << quality << " > source quality " << src_quality
+                      << ": the output grows but cannot gain detail\n";
+        }
+        const auto t0 = std::chrono::steady_clock::now();
+        const auto result = mcodec::transcode_mcodec(bytes, quality);
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        mcodec::write_output(out, result);
+        mcodec::status_out() << "Transcoded q" << src_quality << " -> q" << quality << ": " << bytes.size() << " -> "
+                  << result.size() << " bytes in " << ms << " ms\n";
+        mcodec::status_out() << "Wrote: " << out << "\n";
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "[ERROR] " << e.what() << "\n";
+        return 2;
+    }
+}
@@ -1,5 +1,6 @@
 #include "transform/dct2d.hpp"
 
+#include <algorithm>
 #include <vector>
 #include <cmath>
 #include <stdexcept>
@@ -33,6 +34,41 @@ static const DctCache& get_cache(int N) {
     }
     return *cache;
 }
+
+// Row pass into tmp[y,u], then column pass into dst[v,u].
+void dct_block(const DctCache& cache, const int32_t* src, float* dst) {
+    const int N = cache.N;
+    const double* cos_tbl = cache.cos_table.data();
+    const double* a = cache.alpha.data();
+
+    // Temporary buffer for row-pass (largest block is 16x16)
+    double tmp[16 * 16];
+
+    // Row DCT: tmp[y,u]
+    for (int y = 0; y < N; ++y) {
+        for (int u = 0; u < N; ++u) {
+            double sum = 0.0;
+            for (int x = 0; x < N; ++x) {
+                const double cx = cos_tbl[static_cast<size_t>(u) * N + x];
+                sum += static_cast<double>(src[y * N + x]) * cx;
+            }
+            tmp[static_cast<size_t>(y) * N + u] = sum * a[u];
+        }
+    }
+
+    // Column DCT: dst[v,u]
+    for (int v = 0; v < N; ++v) {
+        for (int u = 0; u < N; ++u) {
+            double sum = 0.0;
+            for (int y = 0; y < N; ++y) {
+                const double cy = cos_tbl[static_cast<size_t>(v) * N + y];
+                sum += tmp[static_cast<size_t>(y) * N + u] * cy;
+            }
+            sum *= a[v];
+            dst[v * N + u] = static_cast<float>(sum);
+        }
+    }
+}
 } // namespace
 
 void dct2d_blocks(const std::vector<int32_t>& blocks_in,
@@ -48,43 +84,68 @@ void dct2d_blocks(const std::vector<int32_t>& blocks_in,
     coeff_out.resize(blocks_in.size());
 
     const auto& cache = get_cache(N);
+    for (size_t b = 0; b < blocks; ++b) {
+        dct_block(cache, blocks_in.data() + b * block_elems, coeff_out.data() + b * block_elems);
+    }
+}
+
+void dct2d_block(const int32_t* block_in, int block_size, float* coeff_out) {
+    if (block_size != 8 && block_size != 16) throw std::runtime_error("dct2d_block: block_size must be 8 or 16");
+    dct_block(get_cache(block_size), block_in, coeff_out);
+}
+
+namespace {
+void idct_block(const DctCache& cache, const float* src, int32_t* dst) {
+    const int N = cache.N;
     const double* cos_tbl = cache.cos_table.data();
     const double* a = cache.alpha.data();
 
-    // Temporary buffer for row-pass
-    std::vector<double> tmp(block_elems);
-
-    for (size_t b = 0; b < blocks; ++b) {
-        const int32_t* src = blocks_in.data() + b * block_elems;
-        float* dst = coeff_out.data() + b * block_elems;
+    // DC-only block (flat areas): every output is a0 * (a0 * DC), exactly what the passes
+    // below compute since the other terms add zeros.
+    bool dc_only = true;
+    for (int i = 1; i < N * N && dc_only; ++i) dc_only = (src[i] == 0.0f);
+    if (dc_only) {
+        double v = std::round(a[0] * (a[0] * static_cast<double>(src[0])));
+        v = std::min(std::max(v, static_cast<double>(std::numeric_limits<int32_t>::min())),
+                     static_cast<double>(std::numeric_limits<int32_t>::max()));
+        std::fill(dst, dst + N * N, static_cast<int32_t>(v));
+        return;
+    }
 
-        // Row DCT: tmp[y,u]
+    // Temporary buffer for column-pass (largest block is 16x16)
+    double tmp[16 * 16];
+    // Column iDCT: tmp[y,u] = sum_v alpha(v)*C[v,y]*src[v,u]
+    for (int u = 0; u < N; ++u) {
         for (int y = 0; y < N; ++y) {
-            for (int u = 0; u < N; ++u) {
-                double sum = 0.0;
-                const double cu = cos_tbl[static_cast<size_t>(u) * N]; // base pointer for u
-                for (int x = 0; x < N; ++x) {
-                    const double cx = cos_tbl[static_cast<size_t>(u) * N + x];
-                    sum += static_cast<double>(src[y * N + x]) * cx;
-                }
-                tmp[static_cast<size_t>(y) * N + u] = sum * a[u];
+            double sum = 0.0;
+            for (int v = 0; v < N; ++v) {
+                const double cy = cos_tbl[static_cast<size_t>(v) * N + y];
+                sum += a[v] * static_cast<double>(src[v * N + u]) * cy;
             }
+            tmp[static_cast<size_t>(y) * N + u] = sum;
         }
+    }
 
-        // Column DCT: dst[v,u]
-        for (int v = 0; v < N; ++v) {
+    // Row iDCT: dst[y,x] = sum_u alpha(u)*C[u,x]*tmp[y,u]
+    for (int y = 0; y < N; ++y) {
+        for (int x = 0; x < N; ++x) {
+            double sum = 0.0;
             for (int u = 0; u < N; ++u) {
-                double sum = 0.0;
-                for (int y = 0; y < N; ++y) {
-                    const double cy = cos_tbl[static_cast<size_t>(v) * N + y];
-                    sum += tmp[static_cast<size_t>(y) * N + u] * cy;
-                }
-                sum *= a[v];
-                dst[v * N + u] = static_cast<float>(sum);
+                const double cx = cos_tbl[static_cast<size_t>(u) * N + x];
+                sum += a[u] * tmp[static_cast<size_t>(y) * N + u] * cx;
+            }
+            sum = std::round(sum);
+            if (sum > static_cast<double>(std::numeric_limits<int32_t>::max())) {
+                sum = static_cast<double>(std::numeric_limits<int32_t>::max());
             }
+            if (sum < static_cast<double>(std::numeric_limits<int32_t>::min())) {
+                sum = static_cast<double>(std::numeric_limits<int32_t>::min());
+            }
+            dst[y * N + x] = static_cast<int32_t>(sum);
         }
     }
 }
+} // namespace
 
 void idct2d_blocks(const std::vector<float>& coeff_in,
                    int block_size,
@@ -99,47 +160,14 @@ void idct2d_blocks(const std::vector<float>& coeff_in,
     blocks_out.resize(coeff_in.size());
 
     const auto& cache = get_cache(N);
-    const double* cos_tbl = cache.cos_table.data();
-    const double* a = cache.alpha.data();
-
-    // Temporary buffer for column-pass
-    std::vector<double> tmp(block_elems);
-
     for (size_t b = 0; b < blocks; ++b) {
-        const float* src = coeff_in.data() + b * block_elems;
-        int32_t* dst = blocks_out.data() + b * block_elems;
-
-        // Column iDCT: tmp[y,u] = sum_v alpha(v)*C[v,y]*src[v,u]
-        for (int u = 0; u < N; ++u) {
-            for (int y = 0; y < N; ++y) {
-                double sum = 0.0;
-                for (int v = 0; v < N; ++v) {
-                    const double cy = cos_tbl[static_cast<size_t>(v) * N + y];
-                    sum += a[v] * static_cast<double>(src[v * N + u]) * cy;
-                }
-                tmp[static_cast<size_t>(y) * N + u] = sum;
-            }
-        }
-
-        // Row iDCT: dst[y,x] = sum_u alpha(u)*C[u,x]*tmp[y,u]
-        for (int y = 0; y < N; ++y) {
-            for (int x = 0; x < N; ++x) {
-                double sum = 0.0;
-                for (int u = 0; u < N; ++u) {
-                    const double cx = cos_tbl[static_cast<size_t>(u) * N + x];
-                    sum += a[u] * tmp[static_cast<size_t>(y) * N + u] * cx;
-                }
-                sum = std::round(sum);
-                if (sum > static_cast<double>(std::numeric_limits<int32_t>::max())) {
-                    sum = static_cast<double>(std::numeric_limits<int32_t>::max());
-                }
-                if (sum < static_cast<double>(std::numeric_limits<int32_t>::min())) {
-                    sum = static_cast<double>(std::numeric_limits<int32_t>::min());
-                }
-                dst[y * N + x] = static_cast<int32_t>(sum);
-            }
-        }
+        idct_block(cache, coeff_in.data() + b * block_elems, blocks_out.data() + b * block_elems);
     }
 }
 
+void idct2d_block(const float* coeff_in, int block_size, int32_t* block_out) {
+    if (block_size != 8 && block_size != 16) throw std::runtime_error("idct2d_block: block_size must be 8 or 16");
+    idct_block(get_cache(block_size), coeff_in, block_out);
+}
+
 } // namespace mcodec
\ No newline at end of file
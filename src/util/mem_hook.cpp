@@ -0,0 +1,49 @@
+// Global operator new/delete replacement feeding util/mem_track.
+// Linked into the CLI tools only; the library itself never replaces operator new.
+//
+// Each block carries a small header with its size and tag, so a release is
+// credited to the tag that made the allocation.
+#include "util/mem_track.hpp"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+struct alignas(alignof(std::max_align_t)) BlockHeader {
+    size_t size;
+    uint8_t tag;
+};
+
+void* tracked_alloc(std::size_t n) {
+    void* raw = std::malloc(sizeof(BlockHeader) + n);
+    if (!raw) return nullptr;
+    auto* h = static_cast<BlockHeader*>(raw);
+    h->size = n;
+    h->tag = mcodec::mem_detail::current_tag();
+    mcodec::mem_detail::on_alloc(n, h->tag);
+    return h + 1;
+}
+
+void tracked_free(void* p) noexcept {
+    if (!p) return;
+    auto* h = static_cast<BlockHeader*>(p) - 1;
+    mcodec::mem_detail::on_free(h->size, h->tag);
+    std::free(h);
+}
+
+} // namespace
+
+void* operator new(std::size_t n) {
+    if (void* p = tracked_alloc(n)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t n) { return operator new(n); }
+void* operator new(std::size_t n, const std::nothrow_t&) noexcept { return tracked_alloc(n); }
+void* operator new[](std::size_t n, const std::nothrow_t&) noexcept { return tracked_alloc(n); }
+void operator delete(void* p) noexcept { tracked_free(p); }
+void operator delete[](void* p) noexcept { tracked_free(p); }
+void operator delete(void* p, std::size_t) noexcept { tracked_free(p); }
+void operator delete[](void* p, std::size_t) noexcept { tracked_free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { tracked_free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { tracked_free(p); }
@@ -0,0 +1,89 @@
+#include "util/mem_track.hpp"
+
+#include <atomic>
+
+namespace mcodec {
+namespace {
+
+// Plain arrays only: this is touched from inside operator new, so it must be
+// constant-initialized and have no destructor.
+struct ThreadCounters {
+    uint8_t tag;
+    uint64_t alloc_bytes[kMemTagCount];
+    uint64_t allocs[kMemTagCount];
+    int64_t live[kMemTagCount];   // may dip below zero for cross-thread frees
+    int64_t peak[kMemTagCount];
+    int64_t total_live;
+    int64_t total_peak;
+};
+
+thread_local ThreadCounters t_counters{};
+std::atomic<bool> g_active{false};
+
+} // namespace
+
+bool mem_tracking_active() {
+    return g_active.load(std::memory_order_relaxed);
+}
+
+MemScope::MemScope(MemTag tag) : prev_(t_counters.tag) {
+    t_counters.tag = static_cast<uint8_t>(tag);
+}
+
+MemScope::~MemScope() {
+    t_counters.tag = prev_;
+}
+
+MemWindow::MemWindow() {
+    ThreadCounters& c = t_counters;
+    for (size_t i = 0; i < kMemTagCount; ++i) {
+        alloc_bytes_[i] = c.alloc_bytes[i];
+        allocs_[i] = c.allocs[i];
+        live_[i] = c.live[i];
+        c.peak[i] = c.live[i];
+    }
+    total_live_ = c.total_live;
+    c.total_peak = c.total_live;
+}
+
+MemUsage MemWindow::usage(MemTag tag) const {
+    const ThreadCounters& c = t_counters;
+    const size_t i = static_cast<size_t>(tag);
+    MemUsage u;
+    u.alloc_bytes = c.alloc_bytes[i] - alloc_bytes_[i];
+    u.allocs = c.allocs[i] - allocs_[i];
+    u.peak_live_bytes = c.peak[i] > live_[i] ? static_cast<uint64_t>(c.peak[i] - live_[i]) : 0;
+    return u;
+}
+
+uint64_t MemWindow::peak_live_bytes() const {
+    const ThreadCounters& c = t_counters;
+    return c.total_peak > total_live_ ? static_cast<uint64_t>(c.total_peak - total_live_) : 0;
+}
+
+namespace mem_detail {
+
+uint8_t current_tag() {
+    return t_counters.tag;
+}
+
+void on_alloc(size_t bytes, uint8_t tag) {
+    if (!g_active.load(std::memory_order_relaxed)) g_active.store(true, std::memory_order_relaxed);
+    ThreadCounters& c = t_counters;
+    const int64_t n = static_cast<int64_t>(bytes);
+    c.alloc_bytes[tag] += bytes;
+    c.allocs[tag] += 1;
+    c.live[tag] += n;
+    if (c.live[tag] > c.peak[tag]) c.peak[tag] = c.live[tag];
+    c.total_live += n;
+    if (c.total_live > c.total_peak) c.total_peak = c.total_live;
+}
+
+void on_free(size_t bytes, uint8_t tag) {
+    ThreadCounters& c = t_counters;
+    c.live[tag] -= static_cast<int64_t>(bytes);
+    c.total_live -= static_cast<int64_t>(bytes);
+}
+
+} // namespace mem_detail
+} // namespace mcodec
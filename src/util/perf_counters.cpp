@@ -0,0 +1,135 @@
+#include "util/perf_counters.hpp"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace mcodec {
+
+const char* perf_event_name(PerfEvent e) {
+    switch (e) {
+        case PerfEvent::Cycles: return "cycles";
+        case PerfEvent::Instructions: return "instructions";
+        case PerfEvent::BranchMisses: return "branch-misses";
+        case PerfEvent::L1dMisses: return "L1d-misses";
+        case PerfEvent::LlcMisses: return "LLC-misses";
+        default: return "?";
+    }
+}
+
+#if defined(__linux__)
+
+namespace {
+
+int open_event(PerfEvent e) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    switch (e) {
+        case PerfEvent::Cycles:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case PerfEvent::Instructions:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case PerfEvent::BranchMisses:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        case PerfEvent::L1dMisses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_L1D |
+                          (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case PerfEvent::LlcMisses:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+        default:
+            return -1;
+    }
+    // pid 0 / cpu -1: this thread, on whichever CPU it runs.
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+} // namespace
+
+PerfCounters::PerfCounters() {
+    int first_errno = 0;
+    for (size_t i = 0; i < kPerfEventCount; ++i) {
+        fd_[i] = open_event(static_cast<PerfEvent>(i));
+        if (fd_[i] < 0 && first_errno == 0) first_errno = errno;
+    }
+    if (!available()) {
+        error_ = std::string("perf_event_open: ") + std::strerror(first_errno);
+        if (first_errno == EACCES || first_errno == EPERM) {
+            error_ += " (see /proc/sys/kernel/perf_event_paranoid)";
+        }
+    }
+}
+
+PerfCounters::~PerfCounters() {
+    for (int fd : fd_) {
+        if (fd >= 0) close(fd);
+    }
+}
+
+bool PerfCounters::available() const {
+    for (int fd : fd_) {
+        if (fd >= 0) return true;
+    }
+    return false;
+}
+
+void PerfCounters::start() {
+    for (int fd : fd_) {
+        if (fd < 0) continue;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+PerfSample PerfCounters::stop() {
+    PerfSample s;
+    for (int fd : fd_) {
+        if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+    for (size_t i = 0; i < kPerfEventCount; ++i) {
+        if (fd_[i] < 0) continue;
+        uint64_t buf[3] = {}; // value, time_enabled, time_running
+        if (read(fd_[i], buf, sizeof(buf)) != static_cast<ssize_t>(sizeof(buf))) continue;
+        if (buf[2] == 0) continue; // never scheduled on the PMU
+        s.value[i] = (buf[2] < buf[1])
+            ? static_cast<uint64_t>(static_cast<double>(buf[0]) * buf[1] / buf[2])
+            : buf[0];
+        s.valid[i] = true;
+    }
+    return s;
+}
+
+#else // !__linux__
+
+PerfCounters::PerfCounters() : error_("hardware counters are only supported on Linux") {
+    for (int& fd : fd_) fd = -1;
+}
+PerfCounters::~PerfCounters() = default;
+bool PerfCounters::available() const { return false; }
+void PerfCounters::start() {}
+PerfSample PerfCounters::stop() { return PerfSample{}; }
+
+#endif
+
+} // namespace mcodec
@@ -0,0 +1,133 @@
+#include "util/trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace mcodec {
+
+namespace trace_detail {
+std::atomic<bool> g_enabled{false};
+} // namespace trace_detail
+
+namespace {
+
+struct Event {
+    const char* name;
+    int64_t begin_ns;
+    int64_t end_ns;
+    int tid;
+};
+
+// Fixed-size ring owned by one thread at a time; when it wraps, the oldest
+// events are overwritten, so a long run keeps its most recent history.
+struct Ring {
+    static constexpr size_t kCapacity = size_t(1) << 14;
+    std::vector<Event> events = std::vector<Event>(kCapacity);
+    uint64_t written = 0; // events ever written since trace_start()
+};
+
+std::mutex g_mutex;                         // guards the ring lists and g_next_tid
+std::vector<std::unique_ptr<Ring>> g_rings; // every ring ever created
+std::vector<Ring*> g_free;                  // rings released by exited threads
+int g_next_tid = 1;
+const std::chrono::steady_clock::time_point g_epoch = std::chrono::steady_clock::now();
+
+// Per-thread handle: borrows a ring on the first span and hands it back on
+// thread exit (parallel_for workers come and go; their events stay behind).
+struct ThreadSlot {
+    Ring* ring = nullptr;
+    int tid = 0;
+    void acquire() {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        if (!g_free.empty()) {
+            ring = g_free.back();
+            g_free.pop_back();
+        } else {
+            g_rings.push_back(std::make_unique<Ring>());
+            ring = g_rings.back().get();
+        }
+        tid = g_next_tid++;
+    }
+    ~ThreadSlot() {
+        if (!ring) return;
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_free.push_back(ring);
+    }
+};
+
+thread_local ThreadSlot t_slot;
+
+} // namespace
+
+namespace trace_detail {
+
+int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - g_epoch).count();
+}
+
+void record(const char* name, int64_t begin_ns, int64_t end_ns) {
+    ThreadSlot& slot = t_slot;
+    if (!slot.ring) slot.acquire();
+    Ring& r = *slot.ring;
+    r.events[r.written % Ring::kCapacity] = Event{name, begin_ns, end_ns, slot.tid};
+    ++r.written;
+}
+
+} // namespace trace_detail
+
+bool trace_compiled_in() {
+#if defined(MCODEC_ENABLE_TRACE)
+    return true;
+#else
+    return false;
+#endif
+}
+
+void trace_start() {
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        for (auto& r : g_rings) r->written = 0;
+    }
+    trace_detail::g_enabled.store(true);
+}
+
+void trace_stop() {
+    trace_detail::g_enabled.store(false);
+}
+
+bool trace_enabled() {
+    return trace_detail::g_enabled.load(std::memory_order_relaxed);
+}
+
+void write_chrome_trace(const std::string& path) {
+    std::ofstream ofs(path, std::ios::trunc);
+    if (!ofs.good()) throw std::runtime_error("Cannot write trace: " + path);
+
+    ofs << "{\"traceEvents\":[";
+    bool first = true;
+    char times[64];
+    std::lock_guard<std::mutex> lock(g_mutex);
+    for (const auto& r : g_rings) {
+        const uint64_t n = std::min<uint64_t>(r->written, Ring::kCapacity);
+        for (uint64_t i = r->written - n; i < r->written; ++i) {
+            const Event& e = r->events[i % Ring::kCapacity];
+            // Complete events ("ph":"X"); ts/dur are in microseconds.
+            std::snprintf(times, sizeof(times), "\"ts\":%.3f,\"dur\":%.3f",
+                          e.begin_ns / 1e3, (e.end_ns - e.begin_ns) / 1e3);
+            ofs << (first ? "\n" : ",\n") << "{\"name\":\"" << e.name
+                << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.tid << "," << times << "}";
+            first = false;
+        }
+    }
+    ofs << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    if (!ofs.good()) throw std::runtime_error("Failed writing trace: " + path);
+}
+
+} // namespace mcodec
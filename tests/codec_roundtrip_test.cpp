@@ -0,0 +1,335 @@
+// End-to-end codec round trips: encode -> decode through every stream kind (DCT, layered,
+// series, skip blocks, predictive), the session and view entry points, transcode and the
+// size estimate. The small per-module checks (DCT, RLE, Huffman, ...) stay as debug
+// self-tests next to their code; these build full streams and run once here instead of
+// at the start of every tool. Linked with the mem hook, so the steady-state session
+// checks see every heap allocation.
+#include "codec/decoder.hpp"
+#include "codec/encoder.hpp"
+#include "codec/predictive.hpp"
+#include "codec/size_estimate.hpp"
+#include "codec/transcode.hpp"
+#include "entropy/bitstream.hpp"
+#include "format/mcodec_format.hpp"
+#include "preprocess/window_level.hpp"
+#include "util/mem_track.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using namespace mcodec;
+
+namespace {
+
+// Takes a plain string: building a std::string message would show up in the allocation checks.
+void check(bool ok, const char* what) {
+    if (!ok) throw std::runtime_error(what);
+}
+
+int32_t sample_min(int bits, bool is_signed) { return is_signed ? -(1 << (bits - 1)) : 0; }
+int32_t sample_max(int bits, bool is_signed) { return sample_min(bits, is_signed) + (1 << bits) - 1; }
+
+// Synthetic image shared by every test: `bits`-bit samples (signed ones centred on 0)
+// from fill(x, y), clamped to the sample range.
+Image synthetic_image(int width, int height, int bits, bool is_signed, const std::function<int32_t(int, int)>& fill) {
+    Image im;
+    im.width = width;
+    im.height = height;
+    im.bits_stored = bits;
+    im.bits_allocated = bits > 8 ? 16 : 8;
+    im.is_signed = is_signed;
+    im.type = is_signed ? PixelType::S16 : (bits > 8 ? PixelType::U16 : PixelType::U8);
+    const int32_t lo = sample_min(bits, is_signed);
+    const int32_t hi = sample_max(bits, is_signed);
+    im.pixels.resize(static_cast<size_t>(width) * height);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            im.pixels[static_cast<size_t>(y) * width + x] = std::min(std::max(fill(x, y), lo), hi);
+        }
+    }
+    return im;
+}
+
+uint64_t allocs_in(const MemWindow& win) {
+    uint64_t allocs = 0;
+    for (size_t t = 0; t < kMemTagCount; ++t) allocs += win.usage(static_cast<MemTag>(t)).allocs;
+    return allocs;
+}
+
+// Same bytes as encode_to_mcodec, a second frame of the same size encodes without
+// touching the heap, a PixelView encodes like the Image, and bad views are rejected.
+void test_encoder_session() {
+    const Image im = synthetic_image(37, 21, 12, false, [](int x, int y) { return ((y * 37 + x) * 37 + y * 11) % 4096; });
+    EncoderSession session;
+    std::vector<uint8_t> out;
+    session.encode(im, 60, out);
+    check(out == encode_to_mcodec(im, 60), "session output differs from encode_to_mcodec");
+    const MemWindow win;
+    session.encode(im, 60, out);
+    check(!mem_tracking_active() || allocs_in(win) == 0, "steady-state encode allocated");
+
+    std::vector<uint16_t> samples(im.pixels.begin(), im.pixels.end());
+    PixelView v;
+    v.data = samples.data();
+    v.type = PixelType::U16;
+    v.width = im.width;
+    v.height = im.height;
+    v.bits_stored = 12;
+    v.bits_allocated = 16;
+    check(encode_to_mcodec(v, 60) == out, "view output differs from the image output");
+    PixelView bad[3] = {v, v, v};
+    bad[0].bits_stored = 0;
+    bad[1].bits_stored = 17;
+    bad[2].is_signed = true;
+    for (const PixelView& b : bad) {
+        bool rejected = false;
+        try {
+            encode_to_mcodec(b, 60);
+        } catch (const std::runtime_error&) {
+            rejected = true;
+        }
+        check(rejected, "invalid view accepted");
+    }
+}
+
+// Same image as decode_from_mcodec, and a second frame of the same size decodes
+// without touching the heap.
+void test_decoder_session() {
+    const Image im = synthetic_image(29, 19, 8, false, [](int x, int y) { return ((y * 29 + x) * 13) % 251; });
+    const std::vector<uint8_t> bytes = encode_to_mcodec(im, 70);
+    DecoderSession session;
+    Image out;
+    session.decode(bytes, out);
+    check(out.pixels == decode_from_mcodec(bytes).pixels, "session output differs from decode_from_mcodec");
+    const MemWindow win;
+    session.decode(bytes, out);
+    check(!mem_tracking_active() || allocs_in(win) == 0, "steady-state decode allocated");
+}
+
+// The first k layers (by max_layers, truncate_layers or a cut stream) decode to the
+// image of a single-layer stream at layer k's quality.
+void test_layered() {
+    const Image im = synthetic_image(27, 18, 12, false, [](int x, int y) { return ((y * 27 + x) * 53 + x * y * 7) % 4096; });
+    const std::vector<int> qualities = {20, 65, 97};
+    const std::vector<uint8_t> bytes = encode_layered_mcodec(im, qualities);
+    const std::vector<LayerInfo> layers = mcodec_layers(bytes);
+    check(layers.size() == qualities.size() && layers.back().end == bytes.size(), "bad layer index");
+    for (size_t k = 0; k < qualities.size(); ++k) {
+        const std::vector<int32_t> want = decode_from_mcodec(encode_to_mcodec(im, qualities[k])).pixels;
+        const int n = static_cast<int>(k + 1);
+        const std::vector<uint8_t> cut(bytes.begin(), bytes.begin() + static_cast<std::ptrdiff_t>(layers[k].end));
+        check(decode_from_mcodec(bytes, n).pixels == want && decode_from_mcodec(truncate_layers(bytes, n)).pixels == want &&
+                  decode_from_mcodec(cut).pixels == want,
+              "layer prefix does not match single-layer decode");
+    }
+}
+
+// The fused window decode equals windowing the decoded image, for unsigned
+// (level-shifted) and signed DCT streams and for a predictive stream, and a session
+// reuses its LUT across windows and formats correctly.
+void test_display_decode() {
+    struct Case { int bits; bool is_signed; bool lossless; };
+    DecoderSession session;
+    DisplayImage got;
+    for (const Case c : {Case{12, false, false}, Case{16, true, false}, Case{8, false, false}, Case{12, false, true}}) {
+        const int32_t lo = sample_min(c.bits, c.is_signed);
+        const int32_t span = sample_max(c.bits, c.is_signed) - lo;
+        const Image im = synthetic_image(21, 11, c.bits, c.is_signed, [&](int x, int y) {
+            return lo + static_cast<int32_t>((static_cast<uint32_t>(y * 21 + x) * 2654435761u) % static_cast<uint32_t>(span + 1));
+        });
+        const std::vector<uint8_t> bytes = c.lossless ? encode_lossless_mcodec(im) : encode_to_mcodec(im, 60);
+        const Image dec = decode_from_mcodec(bytes);
+        for (const DisplayWindow w : {DisplayWindow{lo + span / 2.0, span / 3.0}, DisplayWindow{static_cast<double>(lo), 1.0}}) {
+            const DisplayImage want = apply_window(dec, w);
+            session.decode_display(bytes, w, got);
+            check(got.pixels == want.pixels && got.width == want.width && got.height == want.height &&
+                      decode_display_from_mcodec(bytes, w).pixels == want.pixels,
+                  "fused output differs from windowed decode");
+        }
+    }
+}
+
+// Slices coded with shared tables decode to the same images as their standalone
+// streams (only the entropy code differs), later slices reuse a table, and a table
+// file that does not match is rejected.
+void test_series() {
+    SeriesEncoder enc(55);
+    std::vector<std::vector<uint8_t>> slices(6);
+    std::vector<Image> images;
+    for (size_t s = 0; s < slices.size(); ++s) {
+        const int si = static_cast<int>(s);
+        images.push_back(synthetic_image(40, 33, 12, false, [si](int x, int y) {
+            const int d = (x - 20) * (x - 20) + (y - 16) * (y - 16);
+            const int noise = static_cast<int>(((x * 7919 + y * 104729 + si * 31) * 2654435761u) >> 28);
+            return 3000 - 3 * d + si * 5 + noise;
+        }));
+        enc.encode(images.back(), slices[s]);
+    }
+    check(enc.slices() == slices.size() && enc.reused() != 0 && enc.tables().tables.size() + enc.reused() == slices.size(),
+          "no table was reused");
+    const SeriesTables tables = read_series_tables(write_series_tables(enc.tables()));
+    DecoderSession session;
+    session.set_series_tables(tables);
+    Image out;
+    for (size_t s = 0; s < slices.size(); ++s) {
+        session.decode(slices[s], out);
+        check((read_bitstream_header(slices[s]).flags & kFlagTableRef) != 0 &&
+                  out.pixels == decode_from_mcodec(encode_to_mcodec(images[s], 55)).pixels &&
+                  decode_from_mcodec(slices[s], tables).pixels == out.pixels,
+              "slice differs from its standalone decode");
+    }
+    SeriesTables wrong = tables;
+    wrong.tables.back().back().second = static_cast<uint8_t>(wrong.tables.back().back().second + 1);
+    bool rejected = false;
+    try {
+        decode_from_mcodec(slices.back(), wrong);
+    } catch (const std::runtime_error&) {
+        rejected = true;
+    }
+    check(rejected, "mismatched table file accepted");
+}
+
+// On an image whose top rows are uniform, those blocks are skipped and decode exactly;
+// the scan round trip, front end, layered prefix and display decode keep their
+// invariants with skip blocks.
+void test_skip_blocks() {
+    const Image im = synthetic_image(40, 33, 12, false, [](int x, int y) {
+        return y < 12 ? 700 : static_cast<int32_t>((static_cast<uint32_t>(y * 40 + x) * 2654435761u) >> 22) % 4096;
+    });
+    EncodeStats es;
+    const std::vector<uint8_t> bytes = encode_to_mcodec(im, 40, es);
+    DecodeStats ds;
+    const Image dec = decode_from_mcodec(bytes, ds);
+    // 64-sample blocks 0..6 lie in the 12 uniform rows; the bottom padding rows are uniform too
+    check((read_bitstream_header(bytes).flags & kFlagSkipBlocks) != 0 && es.skipped_blocks >= 7 &&
+              ds.skipped_blocks == es.skipped_blocks &&
+              std::all_of(dec.pixels.begin(), dec.pixels.begin() + 7 * 64, [](int32_t v) { return v == 700; }),
+          "uniform blocks not skipped or not exact");
+    check(encode_quantized_scan(decode_quantized_scan(bytes)) == bytes && encode_from_front_end(encode_front_end(im), 40) == bytes,
+          "scan or front-end round trip changed the stream");
+    const std::vector<uint8_t> layered = encode_layered_mcodec(im, {40, 85});
+    check(decode_from_mcodec(layered, 1).pixels == dec.pixels &&
+              decode_from_mcodec(layered).pixels == decode_from_mcodec(encode_to_mcodec(im, 85)).pixels,
+          "layer prefix does not match single-layer decode");
+    const DisplayWindow w{1500.0, 2000.0};
+    check(decode_display_from_mcodec(bytes, w).pixels == apply_window(dec, w).pixels, "fused display decode differs");
+}
+
+// An entropy decode / encode round trip reproduces the stream, a q90 -> q40 transcode
+// decodes to an image of the same size (requantize itself is checked against
+// dequantize + quantize in quantizer.cpp), and a TranscodeSession gives the same bytes
+// and stops allocating once it has seen the frame size.
+void test_transcode() {
+    const Image im = synthetic_image(24, 17, 10, false, [](int x, int y) { return ((y * 24 + x) * 29 + y * 7) % 1024; });
+    const std::vector<uint8_t> q90 = encode_to_mcodec(im, 90);
+    check(encode_quantized_scan(decode_quantized_scan(q90)) == q90, "scan round trip changed the stream");
+    const Image low = decode_from_mcodec(transcode_mcodec(q90, 40));
+    check(low.width == im.width && low.height == im.height && low.pixels.size() == im.pixels.size(), "decoded size mismatch");
+
+    TranscodeSession session;
+    std::vector<uint8_t> out;
+    session.transcode(q90, 40, out);
+    check(out == transcode_mcodec(q90, 40), "session output differs from transcode_mcodec");
+    const MemWindow win;
+    session.transcode(q90, 40, out);
+    check(!mem_tracking_active() || allocs_in(win) == 0, "steady-state transcode allocated");
+    session.transcode(q90, 90, out);
+    check(out == q90, "same-quality transcode changed the stream");
+}
+
+// On a padded, noisy 12-bit image (also with uniform top rows, which are skip blocks)
+// the front-end estimate equals the encoded size, and the pixel estimate is within 1%.
+void test_size_estimate() {
+    for (bool flat_rows : {false, true}) {
+        uint32_t seed = 12345u;
+        const Image im = synthetic_image(45, 37, 12, false, [&](int x, int y) {
+            seed = seed * 1664525u + 1013904223u;
+            return (flat_rows && y < 8) ? 900 : 1000 + 20 * x + 15 * y + static_cast<int32_t>(seed >> 26);
+        });
+        const EncoderFrontEnd fe = encode_front_end(im);
+        for (int q : {10, 50, 90}) {
+            const uint64_t real = encode_from_front_end(fe, q).size();
+            check(estimate_mcodec_size(fe, q) == real, "front-end estimate differs from the stream");
+            const uint64_t est = estimate_mcodec_size(im, q);
+            check(std::llabs(static_cast<long long>(est) - static_cast<long long>(real)) * 100 <= static_cast<long long>(real),
+                  "pixel estimate off by more than 1%");
+        }
+    }
+}
+
+// 8-, 12-bit and signed 16-bit images with flat areas (run mode, including runs that end
+// a line), edges and noise round-trip exactly, a cut stream is rejected, and
+// near-lossless streams stay within +-near and are smaller than the lossless one.
+void test_predictive() {
+    uint32_t seed = 99u;
+    const auto noise = [&seed](int bits) {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<int32_t>(seed >> (32 - bits));
+    };
+    struct Case { int w, h, bits; bool is_signed; };
+    for (const Case c : {Case{37, 21, 8, false}, Case{1, 9, 12, false}, Case{64, 13, 12, false}, Case{23, 17, 16, true}}) {
+        const int32_t lo = sample_min(c.bits, c.is_signed);
+        const int32_t hi = sample_max(c.bits, c.is_signed);
+        const Image im = synthetic_image(c.w, c.h, c.bits, c.is_signed, [&](int x, int y) {
+            if (x < c.w / 3) return lo;  // flat: run mode
+            if (y % 5 == 0) return hi;   // extremes
+            return lo + ((x * 37 + y * 11) % (hi - lo + 1)) + noise(3);
+        });
+        const std::vector<uint8_t> bytes = encode_lossless_mcodec(im);
+        Image out;
+        decode_predictive_payload(read_bitstream_header(bytes), bytes.data() + kMCodecHeaderBytes,
+                                  bytes.size() - kMCodecHeaderBytes, out);
+        check(out.pixels == im.pixels && out.type == im.type, "lossless round-trip mismatch");
+        bool rejected = false;
+        try {
+            decode_predictive_payload(read_bitstream_header(bytes), bytes.data() + kMCodecHeaderBytes,
+                                      (bytes.size() - kMCodecHeaderBytes) / 2, out);
+        } catch (const std::runtime_error&) {
+            rejected = true;
+        }
+        check(rejected, "truncated payload decoded");
+        for (int near : {1, 3, 7}) { // within the T.87 NEAR limit for 8+ bits
+            const std::vector<uint8_t> nb = encode_near_lossless_mcodec(im, near);
+            decode_predictive_payload(read_bitstream_header(nb), nb.data() + kMCodecHeaderBytes,
+                                      nb.size() - kMCodecHeaderBytes, out);
+            for (size_t i = 0; i < im.pixels.size(); ++i) {
+                check(std::abs(out.pixels[i] - im.pixels[i]) <= near, "near-lossless error bound exceeded");
+            }
+            check(nb.size() < bytes.size(), "near-lossless stream not smaller than lossless");
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    const std::pair<const char*, void (*)()> tests[] = {
+        {"encoder_session", test_encoder_session},
+        {"decoder_session", test_decoder_session},
+        {"layered", test_layered},
+        {"display_decode", test_display_decode},
+        {"series", test_series},
+        {"skip_blocks", test_skip_blocks},
+        {"transcode", test_transcode},
+        {"size_estimate", test_size_estimate},
+        {"predictive", test_predictive},
+    };
+    int failed = 0;
+    for (const auto& [name, run] : tests) {
+        try {
+            run();
+            std::cout << "[PASS] " << name << "\n";
+        } catch (const std::exception& e) {
+            std::cout << "[FAIL] " << name << ": " << e.what() << "\n";
+            ++failed;
+        }
+    }
+    return failed == 0 ? 0 : 1;
+}
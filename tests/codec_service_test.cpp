@@ -0,0 +1,150 @@
+// Loopback test of mcodecd: a service on a temporary socket, and encode / decode /
+// transcode requests through ServiceClient, compared with the direct API. One image is
+// small enough to travel inline over the socket, the other goes through a shared-memory
+// fd in both directions. Ends with the latency histograms of the Stats op.
+#include "codec/decoder.hpp"
+#include "codec/encoder.hpp"
+#include "codec/transcode.hpp"
+#include "service/codec_service.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+using namespace mcodec;
+
+#if defined(__unix__) || defined(__APPLE__)
+namespace {
+
+void check(bool ok, const std::string& what) {
+    if (!ok) throw std::runtime_error(what);
+}
+
+// 12-bit samples: a smooth ramp, plus noise that keeps the stream large at high quality.
+std::vector<uint16_t> test_samples(int width, int height, int noise_bits) {
+    std::vector<uint16_t> px(static_cast<size_t>(width) * height);
+    uint32_t seed = 7u;
+    for (size_t i = 0; i < px.size(); ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        const uint32_t ramp = static_cast<uint32_t>((i % width) * 9 + (i / width) * 5);
+        px[i] = static_cast<uint16_t>((ramp + (noise_bits ? seed >> (32 - noise_bits) : 0)) % 4096);
+    }
+    return px;
+}
+
+PixelView view_of(const std::vector<uint16_t>& px, int width, int height) {
+    PixelView v;
+    v.data = px.data();
+    v.type = PixelType::U16;
+    v.width = width;
+    v.height = height;
+    v.bits_stored = 12;
+    v.bits_allocated = 16;
+    return v;
+}
+
+// Every op on one image over `c`, against the direct API; `fd_path` also checks the
+// encoded stream is large enough to go through a shared-memory fd.
+void check_round_trip(ServiceClient& c, int width, int height, int noise_bits, bool fd_path) {
+    const std::vector<uint16_t> px = test_samples(width, height, noise_bits);
+    const PixelView v = view_of(px, width, height);
+    const std::string size = std::to_string(width) + "x" + std::to_string(height) + ": ";
+
+    const std::vector<uint8_t> bytes = c.encode(v, 95);
+    check(bytes == encode_to_mcodec(v, 95), size + "encode differs from encode_to_mcodec");
+    check(!fd_path || bytes.size() >= ServiceClient::kFdPassBytes, size + "stream too small for the fd path");
+
+    const Image want = decode_from_mcodec(bytes);
+    const Image got = c.decode(bytes);
+    check(got.pixels == want.pixels && got.width == want.width && got.height == want.height &&
+              got.bits_stored == want.bits_stored && got.type == want.type,
+          size + "decode differs from decode_from_mcodec");
+
+    // twice: the second request runs on the worker's warm transcode buffers
+    for (int q : {40, 40, 70}) {
+        check(c.transcode(bytes, q) == transcode_mcodec(bytes, q), size + "transcode differs from transcode_mcodec");
+    }
+    for (int q : {0, 101}) {
+        bool rejected = false;
+        try {
+            c.transcode(bytes, q);
+        } catch (const std::runtime_error&) {
+            rejected = true;
+        }
+        check(rejected, size + "transcode quality out of range accepted");
+    }
+}
+
+int run() {
+    const std::string sock =
+        (std::filesystem::temp_directory_path() / ("mcodecd-test-" + std::to_string(::getpid()) + ".sock")).string();
+    std::exception_ptr service_error;
+    std::thread service([&] {
+        try {
+            ServiceOptions opt;
+            opt.socket_path = sock;
+            run_codec_service(opt);
+        } catch (...) {
+            service_error = std::current_exception();
+        }
+    });
+
+    int failed = 0;
+    try {
+        // the service binds on its own thread; retry until it accepts
+        std::unique_ptr<ServiceClient> c;
+        for (int attempt = 0; !c; ++attempt) {
+            try {
+                c = std::make_unique<ServiceClient>(sock);
+            } catch (const std::runtime_error&) {
+                if (attempt == 100) throw;
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            }
+        }
+        check_round_trip(*c, 40, 33, 0, false);
+        check_round_trip(*c, 256, 256, 10, true);
+        const std::string json = c->stats_json();
+        for (const char* op : {"\"encode\":{\"count\":2,", "\"decode\":{\"count\":2,", "\"transcode\":{\"count\":10,"}) {
+            check(json.find(op) != std::string::npos, std::string("stats: expected ") + op + " in " + json);
+        }
+        std::cout << "[PASS] service loopback\n";
+    } catch (const std::exception& e) {
+        std::cout << "[FAIL] service loopback: " << e.what() << "\n";
+        failed = 1;
+    }
+    stop_codec_service();
+    service.join();
+    if (service_error) {
+        try {
+            std::rethrow_exception(service_error);
+        } catch (const std::exception& e) {
+            std::cout << "[FAIL] service: " << e.what() << "\n";
+            failed = 1;
+        }
+    }
+    return failed;
+}
+
+} // namespace
+#endif
+
+int main() {
+#if defined(__unix__) || defined(__APPLE__)
+    return run();
+#else
+    std::cout << "[SKIP] service loopback: UNIX domain sockets only\n";
+    return 0;
+#endif
+}